@@ -0,0 +1,135 @@
+#include "manipulator/compiled_rule_set.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+
+namespace {
+// Collect complex_modifications rules from `examples/*.json` and `files/complex_modifications_rules_example.json`.
+void find_rules(const nlohmann::json& json, nlohmann::json& rules) {
+  if (json.is_object()) {
+    if (auto v = krbn::json_utility::find_array(json, "manipulators")) {
+      rules.push_back(json);
+      return;
+    }
+  }
+  if (json.is_object() || json.is_array()) {
+    for (const auto& j : json) {
+      find_rules(j, rules);
+    }
+  }
+}
+
+nlohmann::json load_rules(void) {
+  std::vector<std::string> file_paths{
+      "../../files/complex_modifications_rules_example.json",
+  };
+  if (auto dir = opendir("../../examples")) {
+    while (auto entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.size() > 5 && name.substr(name.size() - 5) == ".json") {
+        file_paths.push_back("../../examples/" + name);
+      }
+    }
+    closedir(dir);
+  }
+
+  auto rules = nlohmann::json::array();
+  for (const auto& file_path : file_paths) {
+    std::ifstream ifs(file_path);
+    try {
+      find_rules(nlohmann::json::parse(ifs), rules);
+    } catch (std::exception& e) {
+      // Some examples are not json.
+    }
+  }
+  return rules;
+}
+
+template <typename T>
+double measure(T function) {
+  auto begin = std::chrono::high_resolution_clock::now();
+  function();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - begin).count();
+}
+
+void benchmark(const nlohmann::json& rules, size_t copy_count) {
+  // Make profiles which contain `copy_count` copies of rules.
+  // The second profile differs from the first profile in one rule.
+
+  auto json1 = nlohmann::json::object();
+  json1["rules"] = nlohmann::json::array();
+  for (size_t i = 0; i < copy_count; ++i) {
+    for (const auto& r : rules) {
+      json1["rules"].push_back(r);
+    }
+  }
+  auto json2 = json1;
+  json2["rules"].erase(0);
+
+  krbn::core_configuration::profile::complex_modifications complex_modifications1(json1);
+  krbn::core_configuration::profile::complex_modifications complex_modifications2(json2);
+
+  size_t manipulator_count = 0;
+  for (const auto& rule : complex_modifications1.get_rules()) {
+    manipulator_count += rule.get_manipulators().size();
+  }
+
+  // Parse all manipulators every time. (The previous behavior of device_grabber.)
+  auto parse_all = [](const krbn::core_configuration::profile::complex_modifications& complex_modifications) {
+    krbn::manipulator::manipulator_manager manipulator_manager;
+    for (const auto& rule : complex_modifications.get_rules()) {
+      for (const auto& manipulator : rule.get_manipulators()) {
+        auto m = krbn::manipulator::manipulator_factory::make_manipulator(manipulator.get_json(), manipulator.get_parameters());
+        for (const auto& c : manipulator.get_conditions()) {
+          m->push_back_condition(krbn::manipulator::manipulator_factory::make_condition(c.get_json()));
+        }
+        manipulator_manager.push_back_manipulator(m);
+      }
+    }
+  };
+
+  krbn::manipulator::compiled_rule_set compiled_rule_set;
+  auto update = [&](const krbn::core_configuration::profile::complex_modifications& complex_modifications) {
+    krbn::manipulator::manipulator_manager manipulator_manager;
+    compiled_rule_set.update(complex_modifications);
+    compiled_rule_set.push_back_manipulators(manipulator_manager);
+  };
+
+  std::cout << "manipulators:" << manipulator_count << std::endl;
+  std::cout << "  parse all:                 " << measure([&] { parse_all(complex_modifications1); }) << "ms" << std::endl;
+  std::cout << "  compiled_rule_set (first): " << measure([&] { update(complex_modifications1); }) << "ms" << std::endl;
+  std::cout << "  compiled_rule_set (switch):" << measure([&] { update(complex_modifications2); }) << "ms" << std::endl;
+  std::cout << "  compiled_rule_set (back):  " << measure([&] { update(complex_modifications1); }) << "ms" << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  auto rules = load_rules();
+
+  std::cout << "examples" << std::endl;
+  for (size_t copy_count : {1, 10, 50}) {
+    benchmark(rules, copy_count);
+  }
+
+  // Application specific rules. (e.g., Disable emacs key bindings in terminal applications.)
+  for (auto&& r : rules) {
+    for (auto&& m : r["manipulators"]) {
+      m["conditions"].push_back({
+          {"type", "frontmost_application_unless"},
+          {"bundle_identifiers", {"^com\\.apple\\.Terminal$", "^com\\.googlecode\\.iterm2$", "^org\\.gnu\\.Emacs$"}},
+      });
+    }
+  }
+
+  std::cout << "examples with frontmost_application conditions" << std::endl;
+  for (size_t copy_count : {1, 10, 50}) {
+    benchmark(rules, copy_count);
+  }
+
+  return 0;
+}
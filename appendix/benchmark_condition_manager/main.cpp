@@ -0,0 +1,167 @@
+#include "manipulator/condition_manager.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include "manipulator/manipulator_factory.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+// Make `rule_count` app-specific manipulators such as
+// `a -> b` with `frontmost_application_if com.example.app{i}` (and `variable_if mode{i} == 1`).
+void push_back_manipulators(krbn::manipulator::manipulator_manager& manipulator_manager,
+                            size_t rule_count,
+                            bool with_variable) {
+  krbn::core_configuration::profile::complex_modifications::parameters parameters;
+
+  for (size_t i = 0; i < rule_count; ++i) {
+    auto conditions = nlohmann::json::array();
+    conditions.push_back({
+        {"type", "frontmost_application_if"},
+        {"bundle_identifiers", {"^com\\.example\\.app" + std::to_string(i) + "$"}},
+    });
+    if (with_variable) {
+      conditions.push_back({
+          {"type", "variable_if"},
+          {"name", "mode" + std::to_string(i)},
+          {"value", 1},
+      });
+    }
+
+    nlohmann::json json({
+        {"type", "basic"},
+        {"from", {
+                     {"key_code", "a"},
+                     {"modifiers", {{"optional", {"any"}}}},
+                 }},
+        {"to", {
+                   {{"key_code", "b"}},
+               }},
+        {"conditions", conditions},
+    });
+
+    manipulator_manager.push_back_manipulator(json, parameters);
+  }
+}
+
+// `app_switch_interval`: The frontmost application is changed every `app_switch_interval` keystrokes. (0: never)
+void benchmark(size_t rule_count, bool with_variable, size_t app_switch_interval) {
+  const size_t total_count = 100000;
+
+  krbn::manipulator::manipulator_manager manipulator_manager;
+  push_back_manipulators(manipulator_manager, rule_count, with_variable);
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+  krbn::event_queue::queued_event::event a(krbn::key_code::a);
+
+  size_t count = 0;
+  size_t app_switch_count = 0;
+  uint64_t time_stamp = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  while (count < total_count) {
+    if (app_switch_interval > 0 && count % app_switch_interval == 0) {
+      auto e = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event(
+          "com.example.other" + std::to_string(app_switch_count % 2),
+          "/Applications/Other.app");
+      input_event_queue->emplace_back_event(krbn::device_id(1), ++time_stamp, e, krbn::event_type::single, e);
+      manipulator_manager.manipulate(input_event_queue, output_event_queue);
+      ++app_switch_count;
+    }
+
+    for (const auto& event_type : {krbn::event_type::key_down, krbn::event_type::key_up}) {
+      input_event_queue->emplace_back_event(krbn::device_id(1), ++time_stamp, a, event_type, a);
+      manipulator_manager.manipulate(input_event_queue, output_event_queue);
+      ++count;
+    }
+
+    while (!output_event_queue->empty()) {
+      output_event_queue->erase_front_event();
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "rules:" << rule_count
+            << " conditions:" << (with_variable ? "frontmost_application_if+variable_if" : "frontmost_application_if")
+            << " app_switch_interval:" << app_switch_interval
+            << " events:" << count
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / count)
+            << std::endl;
+}
+
+// Evaluate condition_managers directly in order to measure conditions without the event_queue overhead.
+// Conditions are pushed in the order `frontmost_application_if, variable_if` and the variables are not set.
+void benchmark_condition_manager(size_t rule_count, bool with_variable, size_t app_switch_interval) {
+  const size_t total_count = 100000;
+
+  std::vector<krbn::manipulator::condition_manager> condition_managers(rule_count);
+  for (size_t i = 0; i < rule_count; ++i) {
+    condition_managers[i].push_back_condition(krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+        {"type", "frontmost_application_if"},
+        {"bundle_identifiers", {"^com\\.example\\.app" + std::to_string(i) + "$"}},
+    })));
+    if (with_variable) {
+      condition_managers[i].push_back_condition(krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+          {"type", "variable_if"},
+          {"name", "mode" + std::to_string(i)},
+          {"value", 1},
+      })));
+    }
+  }
+
+  krbn::manipulator_environment manipulator_environment;
+  krbn::event_queue::queued_event::event a(krbn::key_code::a);
+  krbn::event_queue::queued_event queued_event(krbn::device_id(1), 0, a, krbn::event_type::key_down, a);
+
+  size_t fulfilled_count = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (size_t count = 0; count < total_count; ++count) {
+    if (app_switch_interval > 0 && count % app_switch_interval == 0) {
+      manipulator_environment.set_frontmost_application({"com.example.app" + std::to_string(count % rule_count),
+                                                         "/Applications/Example.app"});
+    }
+
+    for (const auto& c : condition_managers) {
+      if (c.is_fulfilled(queued_event, manipulator_environment)) {
+        ++fulfilled_count;
+      }
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "condition_manager only:"
+            << " rules:" << rule_count
+            << " conditions:" << (with_variable ? "frontmost_application_if+variable_if" : "frontmost_application_if")
+            << " app_switch_interval:" << app_switch_interval
+            << " events:" << total_count
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / total_count)
+            << " (fulfilled:" << fulfilled_count << ")"
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (bool with_variable : {false, true}) {
+    for (size_t app_switch_interval : {0, 100}) {
+      benchmark(200, with_variable, app_switch_interval);
+    }
+  }
+
+  for (bool with_variable : {false, true}) {
+    for (size_t app_switch_interval : {0, 1, 100}) {
+      benchmark_condition_manager(300, with_variable, app_switch_interval);
+    }
+  }
+
+  return 0;
+}
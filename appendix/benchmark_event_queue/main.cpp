@@ -0,0 +1,62 @@
+#include "event_queue.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+// Enqueue `queue_size` events (keys and modifiers which have the same time_stamp as a single HID report),
+// then drain the queue in the same way as `manipulator_manager::manipulate`.
+void benchmark(size_t queue_size) {
+  const size_t total_count = 100000;
+
+  krbn::event_queue event_queue;
+
+  krbn::event_queue::queued_event::event left_shift_event(krbn::key_code::left_shift);
+  std::vector<krbn::event_queue::queued_event::event> key_events;
+  for (auto k : {krbn::key_code::a, krbn::key_code::s, krbn::key_code::d, krbn::key_code::f,
+                 krbn::key_code::j, krbn::key_code::k, krbn::key_code::l, krbn::key_code::spacebar}) {
+    key_events.emplace_back(k);
+  }
+
+  size_t count = 0;
+  uint64_t time_stamp = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  while (count < total_count) {
+    for (size_t i = 0; i < queue_size; i += key_events.size() + 1) {
+      auto event_type = (time_stamp % 2 == 0 ? krbn::event_type::key_down : krbn::event_type::key_up);
+      ++time_stamp;
+
+      for (const auto& e : key_events) {
+        event_queue.emplace_back_event(krbn::device_id(1), time_stamp, e, event_type, e);
+      }
+      event_queue.emplace_back_event(krbn::device_id(1), time_stamp, left_shift_event, event_type, left_shift_event);
+    }
+
+    while (!event_queue.empty()) {
+      event_queue.erase_front_event();
+      ++count;
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "queue_size:" << queue_size
+            << " events:" << count
+            << " elapsed:" << seconds << "s"
+            << " events/sec:" << static_cast<uint64_t>(count / seconds)
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t queue_size : {9, 90, 900, 9000}) {
+    benchmark(queue_size);
+  }
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "modifier_flag_manager.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+typedef krbn::manipulator::details::post_event_to_virtual_devices post_event_to_virtual_devices;
+
+krbn::hid_usage make_usage(size_t i) {
+  // Usages from keyboard_a (0x04) to keyboard_f24 (0x73).
+  return krbn::hid_usage(0x04 + i % 112);
+}
+
+// Simulate an N-key-rollover gaming keyboard which holds `held_count` keys while keys are rolling.
+// Modifier keys are dispatched for each event as same as post_event_to_virtual_devices::manipulate.
+void benchmark_rollover(size_t held_count) {
+  const size_t event_count = 1000000;
+
+  post_event_to_virtual_devices::key_event_dispatcher key_event_dispatcher;
+  post_event_to_virtual_devices::queue queue;
+  krbn::modifier_flag_manager modifier_flag_manager;
+  auto device_id = krbn::device_id(1);
+  auto usage_page = krbn::hid_usage_page::keyboard_or_keypad;
+
+  uint64_t time_stamp = 0;
+
+  for (size_t i = 0; i < held_count; ++i) {
+    key_event_dispatcher.dispatch_key_down_event(device_id, usage_page, make_usage(i), queue, time_stamp);
+  }
+  queue.clear();
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (size_t i = 0; i < event_count / 2; ++i) {
+    // Toggle left_shift sometimes.
+    if (i % 16 == 0) {
+      auto type = (i % 32 == 0) ? krbn::modifier_flag_manager::active_modifier_flag::type::increase
+                                : krbn::modifier_flag_manager::active_modifier_flag::type::decrease;
+      modifier_flag_manager.push_back_active_modifier_flag(krbn::modifier_flag_manager::active_modifier_flag(type,
+                                                                                                              krbn::modifier_flag::left_shift,
+                                                                                                              device_id));
+    }
+
+    key_event_dispatcher.dispatch_modifier_key_event(modifier_flag_manager, queue, time_stamp);
+    key_event_dispatcher.dispatch_key_down_event(device_id, usage_page, make_usage(held_count + i), queue, time_stamp);
+
+    key_event_dispatcher.dispatch_modifier_key_event(modifier_flag_manager, queue, time_stamp);
+    key_event_dispatcher.dispatch_key_up_event(usage_page, make_usage(i), queue, time_stamp);
+
+    if (i % 64 == 0) {
+      queue.clear();
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "rollover held_keys:" << held_count
+            << " events:" << event_count
+            << " elapsed:" << seconds << "s"
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / event_count)
+            << std::endl;
+}
+
+// Ungrab a device while `held_count` keys are pressed.
+void benchmark_ungrab(size_t held_count) {
+  const size_t repeat_count = 10000;
+
+  post_event_to_virtual_devices::key_event_dispatcher key_event_dispatcher;
+  post_event_to_virtual_devices::queue queue;
+  auto usage_page = krbn::hid_usage_page::keyboard_or_keypad;
+
+  // Keys of another device are also pressed.
+  for (size_t i = 0; i < held_count; ++i) {
+    key_event_dispatcher.dispatch_key_down_event(krbn::device_id(2), usage_page, make_usage(i * 2 + 1), queue, 0);
+  }
+
+  std::chrono::duration<double> elapsed(0);
+
+  for (size_t r = 0; r < repeat_count; ++r) {
+    for (size_t i = 0; i < held_count; ++i) {
+      key_event_dispatcher.dispatch_key_down_event(krbn::device_id(1), usage_page, make_usage(i * 2), queue, 0);
+    }
+    queue.clear();
+
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    key_event_dispatcher.dispatch_key_up_events_by_device_id(krbn::device_id(1), queue, 0);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    elapsed += end - begin;
+
+    queue.clear();
+  }
+
+  std::cout << "ungrab held_keys:" << held_count
+            << " repeat:" << repeat_count
+            << " elapsed:" << elapsed.count() << "s"
+            << " ns/ungrab:" << static_cast<uint64_t>(elapsed.count() * 1000 * 1000 * 1000 / repeat_count)
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t held_count : {1, 6, 16, 32}) {
+    benchmark_rollover(held_count);
+  }
+
+  for (size_t held_count : {6, 16, 56}) {
+    benchmark_ungrab(held_count);
+  }
+
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "log_monitor.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace {
+const std::string log_file_path("tmp/benchmark_log_monitor.log");
+
+// Make `target.1` and `target` which have `file_size / 2` bytes.
+void make_log_files(size_t file_size) {
+  krbn::filesystem::create_directory_with_intermediate_directories(krbn::filesystem::dirname(log_file_path), 0755);
+
+  uint64_t i = 0;
+  for (const auto& path : {log_file_path + ".1", log_file_path}) {
+    std::ofstream stream(path);
+    size_t written = 0;
+    for (; written < file_size / 2; ++i) {
+      char buffer[256];
+      auto length = snprintf(buffer,
+                             sizeof(buffer),
+                             "[2017-01-%02d %02d:%02d:%02d.%03d] [info] [grabber] event %llu: key_code:%llu\n",
+                             static_cast<int>(1 + i / 86400000 % 28),
+                             static_cast<int>(i / 3600000 % 24),
+                             static_cast<int>(i / 60000 % 60),
+                             static_cast<int>(i / 1000 % 60),
+                             static_cast<int>(i % 1000),
+                             static_cast<unsigned long long>(i),
+                             static_cast<unsigned long long>(i % 256));
+      stream.write(buffer, length);
+      written += length;
+    }
+  }
+}
+
+void benchmark(size_t file_size) {
+  const int repeat_count = 10;
+
+  make_log_files(file_size);
+
+  size_t initial_lines = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (int i = 0; i < repeat_count; ++i) {
+    krbn::log_monitor log_monitor({log_file_path}, nullptr);
+    initial_lines += log_monitor.get_initial_lines().size();
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "log size:" << file_size / 1024 / 1024 << "MB"
+            << " initial lines:" << initial_lines / repeat_count
+            << " us/load:" << static_cast<uint64_t>(seconds * 1000 * 1000 / repeat_count)
+            << std::endl;
+
+  unlink((log_file_path + ".1").c_str());
+  unlink(log_file_path.c_str());
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t file_size : {10 * 1024 * 1024, 100 * 1024 * 1024}) {
+    benchmark(file_size);
+  }
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "manipulator/manipulator_manager.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+// Make `rule_count` basic manipulators such as `left_command+left_shift+a -> b`.
+void push_back_manipulators(krbn::manipulator::manipulator_manager& manipulator_manager,
+                            size_t rule_count) {
+  std::vector<std::string> key_codes;
+  for (char c = 'a'; c <= 'z'; ++c) {
+    key_codes.push_back(std::string(1, c));
+  }
+  for (int i = 1; i <= 12; ++i) {
+    key_codes.push_back("f" + std::to_string(i));
+  }
+
+  std::vector<std::string> modifiers{
+      "left_command",
+      "left_control",
+      "left_option",
+      "left_shift",
+      "right_command",
+      "right_control",
+      "right_option",
+      "right_shift",
+  };
+
+  krbn::core_configuration::profile::complex_modifications::parameters parameters;
+
+  for (size_t i = 0; i < rule_count; ++i) {
+    auto mandatory = nlohmann::json::array();
+    auto m = i / key_codes.size() + 1;
+    for (size_t j = 0; j < modifiers.size(); ++j) {
+      if (m & (1 << j)) {
+        mandatory.push_back(modifiers[j]);
+      }
+    }
+
+    nlohmann::json json({
+        {"type", "basic"},
+        {"from", {
+                     {"key_code", key_codes[i % key_codes.size()]},
+                     {"modifiers", {{"mandatory", mandatory}}},
+                 }},
+        {"to", {
+                   {{"key_code", key_codes[(i + 1) % key_codes.size()]}},
+               }},
+    });
+
+    manipulator_manager.push_back_manipulator(json, parameters);
+  }
+}
+
+void benchmark(size_t rule_count) {
+  const size_t total_count = 100000;
+
+  krbn::manipulator::manipulator_manager manipulator_manager;
+  push_back_manipulators(manipulator_manager, rule_count);
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+  std::vector<krbn::event_queue::queued_event::event> events;
+  for (const auto& k : {krbn::key_code::h, krbn::key_code::e, krbn::key_code::l, krbn::key_code::o, krbn::key_code::spacebar}) {
+    events.emplace_back(k);
+  }
+
+  size_t count = 0;
+  uint64_t time_stamp = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  while (count < total_count) {
+    for (const auto& e : events) {
+      for (const auto& event_type : {krbn::event_type::key_down, krbn::event_type::key_up}) {
+        input_event_queue->emplace_back_event(krbn::device_id(1), ++time_stamp, e, event_type, e);
+        manipulator_manager.manipulate(input_event_queue, output_event_queue);
+        ++count;
+      }
+    }
+
+    while (!output_event_queue->empty()) {
+      output_event_queue->erase_front_event();
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "rules:" << rule_count
+            << " events:" << count
+            << " elapsed:" << seconds << "s"
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / count)
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t rule_count : {10, 100, 1000}) {
+    benchmark(rule_count);
+  }
+
+  return 0;
+}
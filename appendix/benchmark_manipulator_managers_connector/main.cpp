@@ -0,0 +1,273 @@
+#include "krbn_notification_center.hpp"
+#include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "manipulator/manipulator_managers_connector.hpp"
+#include "manipulator/manipulator_timer.hpp"
+#include "scheduler.hpp"
+#include "thread_utility.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Replay keystrokes through `complex_modifications -> post_event_to_virtual_devices` with virtual time.
+// The simulated time is advanced instantly, so we can measure the throughput of the whole chain and
+// the latency which is added by the manipulators (delays between keys, to_delayed_action, etc.) reproducibly.
+
+namespace {
+nlohmann::json make_manipulators(void) {
+  auto manipulators = nlohmann::json::array();
+
+  // caps_lock -> left_control (escape if alone)
+  manipulators.push_back({
+      {"type", "basic"},
+      {"from", {{"key_code", "caps_lock"}, {"modifiers", {{"optional", {"any"}}}}}},
+      {"to", {{{"key_code", "left_control"}}}},
+      {"to_if_alone", {{{"key_code", "escape"}}}},
+  });
+
+  // right_command -> right_command (japanese_eisuu after delay)
+  manipulators.push_back({
+      {"type", "basic"},
+      {"from", {{"key_code", "right_command"}, {"modifiers", {{"optional", {"any"}}}}}},
+      {"to", {{{"key_code", "right_command"}}}},
+      {"to_delayed_action", {{"to_if_invoked", {{{"key_code", "japanese_eisuu"}}}}}},
+  });
+
+  // control+h -> delete_or_backspace, etc.
+  for (const auto& pair : std::vector<std::pair<std::string, std::string>>{
+           {"h", "delete_or_backspace"},
+           {"i", "tab"},
+           {"m", "return_or_enter"},
+           {"open_bracket", "escape"},
+       }) {
+    manipulators.push_back({
+        {"type", "basic"},
+        {"from", {{"key_code", pair.first}, {"modifiers", {{"mandatory", {"control"}}, {"optional", {"any"}}}}}},
+        {"to", {{{"key_code", pair.second}}}},
+    });
+  }
+
+  return manipulators;
+}
+
+struct keystroke final {
+  krbn::key_code key_code;
+  uint64_t hold_milliseconds;
+};
+
+std::vector<keystroke> make_keystrokes(void) {
+  return {
+      {krbn::key_code::h, 40},
+      {krbn::key_code::e, 40},
+      {krbn::key_code::l, 40},
+      {krbn::key_code::l, 40},
+      {krbn::key_code::o, 40},
+      {krbn::key_code::caps_lock, 60},
+      {krbn::key_code::right_command, 800},
+      {krbn::key_code::spacebar, 40},
+  };
+}
+
+void benchmark(size_t keystroke_count, uint64_t interval_milliseconds) {
+  auto scheduler = std::make_shared<krbn::virtual_scheduler>();
+  krbn::scheduler::set_instance(scheduler);
+  krbn::manipulator::manipulator_timer::get_instance().enable();
+
+  krbn::core_configuration::profile::complex_modifications::parameters parameters;
+
+  krbn::manipulator::manipulator_managers_connector connector;
+
+  krbn::manipulator::manipulator_manager complex_modifications_manipulator_manager;
+  for (const auto& j : make_manipulators()) {
+    complex_modifications_manipulator_manager.push_back_manipulator(j, parameters);
+  }
+
+  krbn::manipulator::manipulator_manager post_event_to_virtual_devices_manipulator_manager;
+  auto post_event_to_virtual_devices_manipulator = std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>();
+  post_event_to_virtual_devices_manipulator_manager.push_back_manipulator(post_event_to_virtual_devices_manipulator);
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto complex_modifications_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto posted_event_queue = std::make_shared<krbn::event_queue>();
+  connector.emplace_back_connection(complex_modifications_manipulator_manager,
+                                    input_event_queue,
+                                    complex_modifications_applied_event_queue);
+  connector.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager,
+                                    posted_event_queue);
+
+  auto input_event_arrived_connection = krbn::krbn_notification_center::get_instance().input_event_arrived.connect([&]() {
+    connector.manipulate();
+  });
+
+  // Measure the latency of output events.
+
+  size_t output_count = 0;
+  uint64_t total_latency = 0;
+  uint64_t max_latency = 0;
+  uint64_t last_input_time_stamp = 0;
+
+  // Same as `device_grabber::manipulate`.
+  auto drain = [&] {
+    posted_event_queue->clear_events();
+
+    for (const auto& e : post_event_to_virtual_devices_manipulator->get_queue().get_events()) {
+      if (e.get_time_stamp() >= last_input_time_stamp) {
+        auto latency = e.get_time_stamp() - last_input_time_stamp;
+        total_latency += latency;
+        max_latency = std::max(max_latency, latency);
+      }
+      ++output_count;
+    }
+    post_event_to_virtual_devices_manipulator->clear_queue();
+  };
+
+  auto push_back_event = [&](krbn::key_code key_code, krbn::event_type event_type, uint64_t time_stamp) {
+    scheduler->advance_to(time_stamp);
+    drain();
+
+    last_input_time_stamp = time_stamp;
+    krbn::event_queue::queued_event::event e(key_code);
+    input_event_queue->emplace_back_event(krbn::device_id(1), time_stamp, e, event_type, e);
+    connector.manipulate();
+    drain();
+  };
+
+  auto keystrokes = make_keystrokes();
+  auto ms = krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC);
+  uint64_t time_stamp = ms;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (size_t i = 0; i < keystroke_count; ++i) {
+    const auto& k = keystrokes[i % keystrokes.size()];
+    push_back_event(k.key_code, krbn::event_type::key_down, time_stamp);
+    push_back_event(k.key_code, krbn::event_type::key_up, time_stamp + k.hold_milliseconds * ms);
+    time_stamp += std::max(interval_milliseconds, k.hold_milliseconds + 1) * ms;
+  }
+
+  scheduler->run_until_idle();
+  drain();
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "keystrokes:" << keystroke_count
+            << " simulated:" << krbn::time_utility::absolute_to_nano(scheduler->now()) / NSEC_PER_SEC << "s"
+            << " elapsed:" << seconds << "s"
+            << " keystrokes/sec:" << static_cast<uint64_t>(keystroke_count / seconds)
+            << " outputs:" << output_count
+            << " latency(avg):" << (output_count ? krbn::time_utility::absolute_to_nano(total_latency / output_count) / NSEC_PER_USEC : 0) << "us"
+            << " latency(max):" << krbn::time_utility::absolute_to_nano(max_latency) / NSEC_PER_USEC << "us"
+            << std::endl;
+
+  input_event_arrived_connection.disconnect();
+  krbn::manipulator::manipulator_timer::get_instance().disable();
+  krbn::scheduler::set_instance(nullptr);
+}
+
+// Replay a high-rate mouse stream (1000Hz motion and wheel) through the same stages as device_grabber,
+// calling `manipulate` for each `batch_size` events.
+// (Empty stages are passed through by the connector.)
+void benchmark_batch(size_t batch_size, bool empty_complex_modifications) {
+  const size_t total_count = 300000;
+
+  krbn::core_configuration::profile::complex_modifications::parameters parameters;
+
+  krbn::manipulator::manipulator_managers_connector connector;
+
+  krbn::manipulator::manipulator_manager simple_modifications_manipulator_manager;
+  for (const auto& pair : std::vector<std::pair<std::string, std::string>>{
+           {"caps_lock", "left_control"},
+           {"right_option", "right_control"},
+           {"application", "right_command"},
+       }) {
+    simple_modifications_manipulator_manager.push_back_manipulator(nlohmann::json({
+                                                                       {"type", "basic"},
+                                                                       {"from", {{"key_code", pair.first}, {"modifiers", {{"optional", {"any"}}}}}},
+                                                                       {"to", {{{"key_code", pair.second}}}},
+                                                                   }),
+                                                                   parameters);
+  }
+
+  krbn::manipulator::manipulator_manager complex_modifications_manipulator_manager;
+  if (!empty_complex_modifications) {
+    for (const auto& j : make_manipulators()) {
+      complex_modifications_manipulator_manager.push_back_manipulator(j, parameters);
+    }
+  }
+
+  krbn::manipulator::manipulator_manager fn_function_keys_manipulator_manager;
+
+  krbn::manipulator::manipulator_manager post_event_to_virtual_devices_manipulator_manager;
+  auto post_event_to_virtual_devices_manipulator = std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>();
+  post_event_to_virtual_devices_manipulator_manager.push_back_manipulator(post_event_to_virtual_devices_manipulator);
+
+  auto merged_input_event_queue = std::make_shared<krbn::event_queue>();
+  auto simple_modifications_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto complex_modifications_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto fn_function_keys_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto posted_event_queue = std::make_shared<krbn::event_queue>();
+
+  connector.emplace_back_connection(simple_modifications_manipulator_manager,
+                                    merged_input_event_queue,
+                                    simple_modifications_applied_event_queue);
+  connector.emplace_back_connection(complex_modifications_manipulator_manager,
+                                    complex_modifications_applied_event_queue);
+  connector.emplace_back_connection(fn_function_keys_manipulator_manager,
+                                    fn_function_keys_applied_event_queue);
+  connector.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager,
+                                    posted_event_queue);
+
+  std::vector<krbn::event_queue::queued_event::event> events;
+  for (int i = 0; i < 10; ++i) {
+    events.emplace_back(krbn::event_queue::queued_event::event::type::pointing_x, i % 3 - 1);
+    events.emplace_back(krbn::event_queue::queued_event::event::type::pointing_y, i % 5 - 2);
+  }
+  events.emplace_back(krbn::event_queue::queued_event::event::type::pointing_vertical_wheel, -1);
+
+  auto ms = krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC);
+  uint64_t time_stamp = 0;
+  size_t count = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  while (count < total_count) {
+    for (size_t i = 0; i < batch_size; ++i) {
+      const auto& e = events[count % events.size()];
+      time_stamp += ms;
+      merged_input_event_queue->emplace_back_event(krbn::device_id(1), time_stamp, e, krbn::event_type::single, e);
+      ++count;
+    }
+
+    // Same as `device_grabber::manipulate`. (Posting to virtual devices is skipped.)
+    connector.manipulate();
+    posted_event_queue->clear_events();
+    post_event_to_virtual_devices_manipulator->clear_queue();
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "batch_size:" << batch_size
+            << " complex_modifications:" << (empty_complex_modifications ? "empty" : "6")
+            << " events:" << count
+            << " elapsed:" << seconds << "s"
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / count)
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t keystroke_count : {1000, 10000, 100000}) {
+    benchmark(keystroke_count, 100);
+  }
+
+  for (bool empty_complex_modifications : {false, true}) {
+    for (size_t batch_size : {1, 4, 16, 64}) {
+      benchmark_batch(batch_size, empty_complex_modifications);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include "manipulator/manipulator_timer.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+// Simulate mouse keys (20ms repeat) while `pending_count` to_delayed_action timers are waiting.
+void benchmark(size_t pending_count) {
+  const size_t tick_count = 100000;
+
+  auto& manipulator_timer = krbn::manipulator::manipulator_timer::get_instance();
+
+  size_t invoked_count = 0;
+  auto function = [&] {
+    ++invoked_count;
+  };
+
+  uint64_t now = 0;
+  const uint64_t far = 1000ULL * 1000 * 1000 * 1000;
+
+  for (size_t i = 0; i < pending_count; ++i) {
+    manipulator_timer.add_entry(far + i, function);
+  }
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (size_t i = 0; i < tick_count; ++i) {
+    manipulator_timer.add_entry(now + 20, function);
+    now += 20;
+    manipulator_timer.signal(now);
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "pending:" << pending_count
+            << " ticks:" << tick_count
+            << " invoked:" << invoked_count
+            << " elapsed:" << seconds << "s"
+            << " ns/tick:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / tick_count)
+            << std::endl;
+
+  // Flush pending entries.
+  manipulator_timer.signal(far * 2);
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t pending_count : {0, 10, 100, 1000}) {
+    benchmark(pending_count);
+  }
+
+  return 0;
+}
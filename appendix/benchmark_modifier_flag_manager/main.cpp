@@ -0,0 +1,65 @@
+#include "modifier_flag_manager.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+// Press and release modifiers on `device_count` devices concurrently
+// and call `is_pressed` for all modifier_flags at each event in the same way as `from_event_definition::test_modifiers`.
+void benchmark(size_t device_count) {
+  const size_t total_count = 1000000;
+
+  krbn::modifier_flag_manager modifier_flag_manager;
+
+  std::vector<krbn::modifier_flag> modifier_flags;
+  for (auto i = static_cast<uint32_t>(krbn::modifier_flag::left_control); i < static_cast<uint32_t>(krbn::modifier_flag::end_); ++i) {
+    modifier_flags.push_back(krbn::modifier_flag(i));
+  }
+
+  size_t count = 0;
+  size_t pressed_count = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  while (count < total_count) {
+    // Each device holds some modifiers.
+    for (const auto& type : {krbn::modifier_flag_manager::active_modifier_flag::type::increase,
+                             krbn::modifier_flag_manager::active_modifier_flag::type::decrease}) {
+      for (size_t d = 0; d < device_count; ++d) {
+        for (size_t m = 0; m < 3; ++m) {
+          auto flag = modifier_flags[(d + m) % modifier_flags.size()];
+          krbn::modifier_flag_manager::active_modifier_flag f(type, flag, krbn::device_id(d + 1));
+          modifier_flag_manager.push_back_active_modifier_flag(f);
+          ++count;
+
+          for (const auto& flag : modifier_flags) {
+            if (modifier_flag_manager.is_pressed(flag)) {
+              ++pressed_count;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "devices:" << device_count
+            << " events:" << count
+            << " elapsed:" << seconds << "s"
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / count)
+            << " (pressed_count:" << pressed_count << ")"
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t device_count : {1, 4, 12, 32}) {
+    benchmark(device_count);
+  }
+
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "async_local_datagram_server.hpp"
+#include "filesystem.hpp"
+#include "operation_message.hpp"
+#include "thread_utility.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+namespace {
+std::vector<uint8_t> make_datagram(size_t message_count) {
+  krbn::operation_message::writer writer;
+  for (size_t i = 0; i < message_count; ++i) {
+    writer.begin_message(krbn::operation_type::frontmost_application_changed);
+    writer.write_string("com.apple.Terminal");
+    writer.write_string("/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal");
+    writer.end_message();
+  }
+  return writer.get_buffer();
+}
+
+size_t parse(const uint8_t* p, size_t length) {
+  size_t total_length = 0;
+  krbn::operation_message::parse(p,
+                                 length,
+                                 [&](krbn::operation_type operation_type, krbn::operation_message::reader& reader) {
+                                   if (operation_type == krbn::operation_type::frontmost_application_changed) {
+                                     auto bundle_identifier = reader.read_string();
+                                     auto file_path = reader.read_string();
+                                     if (bundle_identifier && file_path) {
+                                       total_length += bundle_identifier->length() + file_path->length();
+                                     }
+                                   }
+                                 });
+  return total_length;
+}
+
+// Parse cost without socket.
+void benchmark_parse(size_t messages_per_datagram) {
+  const size_t message_count = 1000000;
+
+  auto datagram = make_datagram(messages_per_datagram);
+  size_t total_length = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (size_t i = 0; i < message_count / messages_per_datagram; ++i) {
+    total_length += parse(&(datagram[0]), datagram.size());
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "parse"
+            << " messages/datagram:" << messages_per_datagram
+            << " bytes/message:" << (datagram.size() - krbn::operation_message::get_header_size()) / messages_per_datagram
+            << " ns/message:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / message_count)
+            << " (" << total_length << ")"
+            << std::endl;
+}
+
+// Throughput over boost::asio::local::datagram_protocol.
+void benchmark_socket(size_t messages_per_datagram) {
+  const size_t datagram_count = 100000;
+  const std::string socket_file_path("tmp/benchmark_operation_message");
+
+  krbn::filesystem::create_directory_with_intermediate_directories(krbn::filesystem::dirname(socket_file_path), 0700);
+  unlink(socket_file_path.c_str());
+
+  auto datagram = make_datagram(messages_per_datagram);
+  std::atomic<size_t> received_datagram_count(0);
+  std::atomic<size_t> total_length(0);
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  {
+    krbn::async_local_datagram_server server(socket_file_path.c_str(),
+                                             32 * 1024,
+                                             [&](const uint8_t* p, size_t length) {
+                                               total_length += parse(p, length);
+                                               ++received_datagram_count;
+                                             });
+
+    boost::asio::io_service io_service;
+    boost::asio::local::datagram_protocol::socket socket(io_service);
+    socket.open();
+    boost::asio::local::datagram_protocol::endpoint endpoint(socket_file_path);
+
+    // The blocking send waits while the receive buffer is full.
+    for (size_t i = 0; i < datagram_count; ++i) {
+      socket.send_to(boost::asio::buffer(datagram), endpoint);
+    }
+
+    while (received_datagram_count < datagram_count) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+  auto message_count = datagram_count * messages_per_datagram;
+
+  std::cout << "socket"
+            << " messages/datagram:" << messages_per_datagram
+            << " messages:" << message_count
+            << " elapsed:" << seconds << "s"
+            << " messages/sec:" << static_cast<uint64_t>(message_count / seconds)
+            << " (" << total_length << ")"
+            << std::endl;
+
+  unlink(socket_file_path.c_str());
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  for (size_t messages_per_datagram : {1, 16}) {
+    benchmark_parse(messages_per_datagram);
+  }
+
+  for (size_t messages_per_datagram : {1, 16}) {
+    benchmark_socket(messages_per_datagram);
+  }
+
+  return 0;
+}
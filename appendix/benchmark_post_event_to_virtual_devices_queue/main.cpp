@@ -0,0 +1,80 @@
+#include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "scheduler.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+// Emit a macro which has `keystroke_count` keystrokes (e.g., a long `to` array) and drain it.
+// Events are posted by the queue's timer with virtual time, so the queue is drained one event at a time
+// as same as the actual virtual device posting.
+void benchmark(size_t keystroke_count) {
+  const size_t repeat_count = 10;
+
+  auto scheduler = std::make_shared<krbn::virtual_scheduler>();
+  krbn::scheduler::set_instance(scheduler);
+
+  // The client is not connected, so events are not sent to the actual device.
+  krbn::virtual_hid_device_client virtual_hid_device_client;
+  krbn::console_user_server_client console_user_server_client;
+
+  std::vector<krbn::key_code> key_codes{
+      krbn::key_code::h,
+      krbn::key_code::e,
+      krbn::key_code::l,
+      krbn::key_code::l,
+      krbn::key_code::o,
+      krbn::key_code::spacebar,
+  };
+
+  size_t event_count = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  for (size_t r = 0; r < repeat_count; ++r) {
+    krbn::manipulator::details::post_event_to_virtual_devices::queue queue;
+
+    auto time_stamp = scheduler->now();
+    for (size_t i = 0; i < keystroke_count; ++i) {
+      auto key_code = key_codes[i % key_codes.size()];
+      auto usage_page = *krbn::types::make_hid_usage_page(key_code);
+      auto usage = *krbn::types::make_hid_usage(key_code);
+
+      queue.emplace_back_key_event(usage_page, usage, krbn::event_type::key_down, time_stamp);
+      queue.emplace_back_key_event(usage_page, usage, krbn::event_type::key_up, time_stamp);
+      event_count += 2;
+    }
+
+    queue.post_events(virtual_hid_device_client, console_user_server_client);
+    scheduler->run_until_idle();
+
+    if (!queue.empty()) {
+      std::cerr << "queue is not drained" << std::endl;
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << "keystrokes:" << keystroke_count
+            << " events:" << event_count
+            << " elapsed:" << seconds << "s"
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / event_count)
+            << std::endl;
+
+  krbn::scheduler::set_instance(nullptr);
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  // Suppress "connect_ is null" errors.
+  krbn::logger::get_logger().set_level(spdlog::level::off);
+
+  for (size_t keystroke_count : {500, 2000, 10000}) {
+    benchmark(keystroke_count);
+  }
+
+  return 0;
+}
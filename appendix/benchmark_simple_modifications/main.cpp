@@ -0,0 +1,131 @@
+#include "manipulator/details/basic.hpp"
+#include "manipulator/details/simple_modifications.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace {
+const size_t device_count = 5;
+const size_t pair_count_per_device = 20;
+
+std::shared_ptr<krbn::manipulator::details::conditions::device> make_device_if_condition(size_t device_index) {
+  return std::make_shared<krbn::manipulator::details::conditions::device>(nlohmann::json({
+      {"type", "device_if"},
+      {"identifiers", {
+                          {
+                              {"vendor_id", 1000 + device_index},
+                              {"product_id", 2000},
+                              {"is_keyboard", true},
+                              {"is_pointing_device", false},
+                          },
+                      }},
+  }));
+}
+
+krbn::key_code make_from_key_code(size_t i) {
+  return krbn::key_code(static_cast<uint32_t>(krbn::key_code::a) + i);
+}
+
+// `device_count` * `pair_count_per_device` pairs (e.g., device1: a -> b, device2: a -> c, ...)
+template <typename T>
+void push_back_pairs(T push_back_pair) {
+  for (size_t d = 0; d < device_count; ++d) {
+    auto c = make_device_if_condition(d);
+    for (size_t i = 0; i < pair_count_per_device; ++i) {
+      krbn::manipulator::details::from_event_definition from(make_from_key_code(i),
+                                                             {},
+                                                             {krbn::manipulator::details::event_definition::modifier::any});
+      krbn::manipulator::details::to_event_definition to(make_from_key_code((i + d + 1) % pair_count_per_device),
+                                                         {});
+      push_back_pair(from, to, c);
+    }
+  }
+}
+
+void benchmark(const std::string& name,
+               krbn::manipulator::manipulator_manager& manipulator_manager,
+               const std::vector<krbn::device_id>& device_ids) {
+  const size_t total_count = 200000;
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+  size_t count = 0;
+  uint64_t time_stamp = 0;
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  while (count < total_count) {
+    auto device_id = device_ids[count % device_ids.size()];
+    // Include keys which are not modified.
+    krbn::event_queue::queued_event::event e(make_from_key_code(count % (pair_count_per_device + 5)));
+
+    for (const auto& event_type : {krbn::event_type::key_down, krbn::event_type::key_up}) {
+      input_event_queue->emplace_back_event(device_id, ++time_stamp, e, event_type, e);
+      manipulator_manager.manipulate(input_event_queue, output_event_queue);
+      ++count;
+    }
+
+    while (!output_event_queue->empty()) {
+      output_event_queue->erase_front_event();
+    }
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+
+  std::cout << name
+            << " pairs:" << device_count * pair_count_per_device
+            << " devices:" << device_count
+            << " events:" << count
+            << " ns/event:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / count)
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  std::vector<krbn::device_id> device_ids;
+  for (size_t d = 0; d < device_count; ++d) {
+    device_ids.push_back(krbn::types::make_new_device_id(std::make_shared<krbn::device_detail>(nlohmann::json({
+        {"vendor_id", 1000 + d},
+        {"product_id", 2000},
+        {"is_keyboard", true},
+        {"is_pointing_device", false},
+    }))));
+  }
+
+  // One basic manipulator for each pair
+
+  {
+    krbn::manipulator::manipulator_manager manipulator_manager;
+    push_back_pairs([&](const krbn::manipulator::details::from_event_definition& from,
+                        const krbn::manipulator::details::to_event_definition& to,
+                        const std::shared_ptr<krbn::manipulator::details::conditions::device>& c) {
+      auto m = std::make_shared<krbn::manipulator::details::basic>(from, to);
+      m->push_back_condition(c);
+      manipulator_manager.push_back_manipulator(m);
+    });
+
+    benchmark("basic", manipulator_manager, device_ids);
+  }
+
+  // simple_modifications
+
+  {
+    krbn::manipulator::manipulator_manager manipulator_manager;
+    auto m = std::make_shared<krbn::manipulator::details::simple_modifications>();
+    push_back_pairs([&](const krbn::manipulator::details::from_event_definition& from,
+                        const krbn::manipulator::details::to_event_definition& to,
+                        const std::shared_ptr<krbn::manipulator::details::conditions::device>& c) {
+      m->push_back_pair(from, to, c);
+    });
+    manipulator_manager.push_back_manipulator(m);
+
+    benchmark("simple_modifications", manipulator_manager, device_ids);
+  }
+
+  return 0;
+}
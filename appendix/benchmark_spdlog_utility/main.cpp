@@ -0,0 +1,99 @@
+#include "filesystem.hpp"
+#include "spdlog_utility.hpp"
+#include "thread_utility.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace {
+const std::string log_file_path("tmp/benchmark_spdlog_utility.log");
+
+// Make a 50 MB synthetic log.
+void make_log_file(void) {
+  const size_t file_size = 50 * 1024 * 1024;
+
+  krbn::filesystem::create_directory_with_intermediate_directories(krbn::filesystem::dirname(log_file_path), 0755);
+
+  std::ofstream stream(log_file_path);
+  size_t written = 0;
+  for (uint64_t i = 0; written < file_size; ++i) {
+    char buffer[256];
+    auto length = snprintf(buffer,
+                           sizeof(buffer),
+                           "[2017-01-%02d %02d:%02d:%02d.%03d] [info] [grabber] event %llu: key_code:%llu\n",
+                           static_cast<int>(1 + i / 86400000 % 28),
+                           static_cast<int>(i / 3600000 % 24),
+                           static_cast<int>(i / 60000 % 60),
+                           static_cast<int>(i / 1000 % 60),
+                           static_cast<int>(i % 1000),
+                           static_cast<unsigned long long>(i),
+                           static_cast<unsigned long long>(i % 256));
+    stream.write(buffer, length);
+    written += length;
+  }
+}
+
+void report(const std::string& name, size_t line_count, uint64_t checksum, std::chrono::high_resolution_clock::time_point begin) {
+  auto end = std::chrono::high_resolution_clock::now();
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+  auto file_size = *krbn::filesystem::file_size(log_file_path);
+
+  std::cout << name
+            << " lines:" << line_count
+            << " elapsed:" << seconds << "s"
+            << " ns/line:" << static_cast<uint64_t>(seconds * 1000 * 1000 * 1000 / line_count)
+            << " MB/s:" << static_cast<uint64_t>(file_size / seconds / 1024 / 1024)
+            << " (" << checksum << ")"
+            << std::endl;
+}
+
+// std::getline + get_sort_key(std::string)
+void benchmark_getline(void) {
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  size_t line_count = 0;
+  uint64_t checksum = 0;
+
+  std::ifstream stream(log_file_path);
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (auto sort_key = krbn::spdlog_utility::get_sort_key(line)) {
+      checksum += *sort_key;
+      ++line_count;
+    }
+  }
+
+  report("getline", line_count, checksum, begin);
+}
+
+// scan_sort_keys with mapped_file
+void benchmark_scan_sort_keys(void) {
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  size_t line_count = 0;
+  uint64_t checksum = 0;
+
+  krbn::spdlog_utility::scan_sort_keys(log_file_path,
+                                       [&](const char* data, size_t offset, size_t length, uint64_t sort_key) {
+                                         checksum += sort_key;
+                                         ++line_count;
+                                       });
+
+  report("scan_sort_keys", line_count, checksum, begin);
+}
+} // namespace
+
+int main(int argc, const char* argv[]) {
+  krbn::thread_utility::register_main_thread();
+
+  make_log_file();
+
+  for (int i = 0; i < 2; ++i) {
+    benchmark_getline();
+    benchmark_scan_sort_keys();
+  }
+
+  unlink(log_file_path.c_str());
+
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include "console_user_server_client.hpp"
 #include "logger.hpp"
 #include "manipulator/details/post_event_to_virtual_devices.hpp"
 #include "thread_utility.hpp"
@@ -12,6 +13,7 @@ int main(int argc, const char* argv[]) {
   }
 
   auto virtual_hid_device_client_ptr = std::make_unique<krbn::virtual_hid_device_client>();
+  krbn::console_user_server_client console_user_server_client;
   krbn::manipulator::details::post_event_to_virtual_devices::queue queue;
 
   auto client_connected_connection = virtual_hid_device_client_ptr->client_connected.connect([&]() {
@@ -30,7 +32,7 @@ int main(int argc, const char* argv[]) {
                                    krbn::hid_usage(kHIDUsage_KeyboardSpacebar),
                                    krbn::event_type::key_down,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
     }
     {
       auto time_stamp = mach_absolute_time();
@@ -38,7 +40,7 @@ int main(int argc, const char* argv[]) {
                                    krbn::hid_usage(kHIDUsage_KeyboardSpacebar),
                                    krbn::event_type::key_up,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
     }
 
     {
@@ -50,49 +52,49 @@ int main(int argc, const char* argv[]) {
                                    krbn::hid_usage(kHIDUsage_KeyboardLeftShift),
                                    krbn::event_type::key_down,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
 
       queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
                                    krbn::hid_usage(kHIDUsage_KeyboardB),
                                    krbn::event_type::key_down,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
 
       queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
                                    krbn::hid_usage(kHIDUsage_KeyboardB),
                                    krbn::event_type::key_up,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
 
       queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
                                    krbn::hid_usage(kHIDUsage_KeyboardLeftShift),
                                    krbn::event_type::key_up,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
 
       queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
                                    krbn::hid_usage(kHIDUsage_KeyboardC),
                                    krbn::event_type::key_down,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
 
       queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
                                    krbn::hid_usage(kHIDUsage_KeyboardLeftShift),
                                    krbn::event_type::key_down,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
 
       queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
                                    krbn::hid_usage(kHIDUsage_KeyboardC),
                                    krbn::event_type::key_up,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
 
       queue.emplace_back_key_event(krbn::hid_usage_page::keyboard_or_keypad,
                                    krbn::hid_usage(kHIDUsage_KeyboardLeftShift),
                                    krbn::event_type::key_up,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
     }
 
     {
@@ -101,7 +103,7 @@ int main(int argc, const char* argv[]) {
                                    krbn::hid_usage(kHIDUsage_KeyboardA),
                                    krbn::event_type::key_down,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
     }
     {
       auto time_stamp = mach_absolute_time() + krbn::time_utility::nano_to_absolute(2 * NSEC_PER_SEC);
@@ -109,7 +111,7 @@ int main(int argc, const char* argv[]) {
                                    krbn::hid_usage(kHIDUsage_KeyboardA),
                                    krbn::event_type::key_up,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
     }
 
     {
@@ -118,7 +120,7 @@ int main(int argc, const char* argv[]) {
                                    krbn::hid_usage(kHIDUsage_KeyboardB),
                                    krbn::event_type::key_down,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
     }
     {
       auto time_stamp = mach_absolute_time();
@@ -126,7 +128,7 @@ int main(int argc, const char* argv[]) {
                                    krbn::hid_usage(kHIDUsage_KeyboardB),
                                    krbn::event_type::key_up,
                                    time_stamp);
-      queue.post_events(*virtual_hid_device_client_ptr);
+      queue.post_events(*virtual_hid_device_client_ptr, console_user_server_client);
     }
   });
 
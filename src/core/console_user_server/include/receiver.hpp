@@ -6,6 +6,8 @@
 #include "local_datagram_server.hpp"
 #include "shell_utility.hpp"
 #include "types.hpp"
+#include <cstddef>
+#include <cstring>
 #include <vector>
 
 namespace krbn {
@@ -56,70 +58,95 @@ private:
       std::size_t n = server_->receive(boost::asio::buffer(buffer_), boost::posix_time::seconds(1), ec);
 
       if (!ec && n > 0) {
-        switch (operation_type(buffer_[0])) {
-          case operation_type::shell_command_execution:
-            if (n != sizeof(operation_type_shell_command_execution_struct)) {
-              logger::get_logger().error("invalid size for operation_type::shell_command_execution");
-            } else {
-              auto p = reinterpret_cast<operation_type_shell_command_execution_struct*>(&(buffer_[0]));
-
-              // Ensure shell_command is null-terminated string even if corrupted data is sent.
-              p->shell_command[sizeof(p->shell_command) - 1] = '\0';
-
-              std::string background_shell_command = shell_utility::make_background_command(p->shell_command);
-              dispatch_async(dispatch_get_main_queue(), ^{
-                system(background_shell_command.c_str());
-              });
-            }
+        // A datagram might contain multiple operations. (See console_user_server_client.)
+        size_t offset = 0;
+        while (offset < n) {
+          auto size = process_operation(&(buffer_[offset]), n - offset);
+          if (size == 0) {
             break;
+          }
+          offset += size;
+        }
+      }
+    }
+  }
 
-          case operation_type::select_input_source:
-            if (n != sizeof(operation_type_select_input_source_struct)) {
-              logger::get_logger().error("invalid size for operation_type::select_input_source");
-            } else {
-              auto p = reinterpret_cast<operation_type_select_input_source_struct*>(&(buffer_[0]));
-
-              // Ensure input_source_selector's strings are null-terminated string even if corrupted data is sent.
-              p->language[sizeof(p->language) - 1] = '\0';
-              p->input_source_id[sizeof(p->input_source_id) - 1] = '\0';
-              p->input_mode_id[sizeof(p->input_mode_id) - 1] = '\0';
-
-              uint64_t time_stamp = p->time_stamp;
-              boost::optional<std::string> language(std::string(p->language));
-              boost::optional<std::string> input_source_id(std::string(p->input_source_id));
-              boost::optional<std::string> input_mode_id(std::string(p->input_mode_id));
-              if (language && language->empty()) {
-                language = boost::none;
-              }
-              if (input_source_id && input_source_id->empty()) {
-                input_source_id = boost::none;
-              }
-              if (input_mode_id && input_mode_id->empty()) {
-                input_mode_id = boost::none;
-              }
-
-              input_source_selector input_source_selector(language,
-                                                          input_source_id,
-                                                          input_mode_id);
-
-              dispatch_async(dispatch_get_main_queue(), ^{
-                if (last_select_input_source_time_stamp_ == time_stamp) {
-                  return;
-                }
-                if (input_source_manager_.select(input_source_selector)) {
-                  last_select_input_source_time_stamp_ = time_stamp;
-                }
-              });
-            }
-            break;
+  // Returns the size of the processed operation. (0 if the data is invalid.)
+  size_t process_operation(const uint8_t* p, size_t length) {
+    switch (operation_type(p[0])) {
+      case operation_type::shell_command_execution: {
+        using operation_struct = operation_type_shell_command_execution_struct;
+        if (length < sizeof(operation_struct)) {
+          logger::get_logger().error("invalid size for operation_type::shell_command_execution");
+          return 0;
+        }
 
-          default:
-            break;
+        auto shell_command = read_string(p + offsetof(operation_struct, shell_command),
+                                         sizeof(operation_struct::shell_command));
+
+        std::string background_shell_command = shell_utility::make_background_command(shell_command);
+        dispatch_async(dispatch_get_main_queue(), ^{
+          system(background_shell_command.c_str());
+        });
+
+        return sizeof(operation_struct);
+      }
+
+      case operation_type::select_input_source: {
+        using operation_struct = operation_type_select_input_source_struct;
+        if (length < sizeof(operation_struct)) {
+          logger::get_logger().error("invalid size for operation_type::select_input_source");
+          return 0;
         }
+
+        uint64_t time_stamp;
+        memcpy(&time_stamp, p + offsetof(operation_struct, time_stamp), sizeof(time_stamp));
+        boost::optional<std::string> language(read_string(p + offsetof(operation_struct, language),
+                                                          sizeof(operation_struct::language)));
+        boost::optional<std::string> input_source_id(read_string(p + offsetof(operation_struct, input_source_id),
+                                                                 sizeof(operation_struct::input_source_id)));
+        boost::optional<std::string> input_mode_id(read_string(p + offsetof(operation_struct, input_mode_id),
+                                                               sizeof(operation_struct::input_mode_id)));
+        if (language && language->empty()) {
+          language = boost::none;
+        }
+        if (input_source_id && input_source_id->empty()) {
+          input_source_id = boost::none;
+        }
+        if (input_mode_id && input_mode_id->empty()) {
+          input_mode_id = boost::none;
+        }
+
+        input_source_selector input_source_selector(language,
+                                                    input_source_id,
+                                                    input_mode_id);
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+          if (last_select_input_source_time_stamp_ == time_stamp) {
+            return;
+          }
+          if (input_source_manager_.select(input_source_selector)) {
+            last_select_input_source_time_stamp_ = time_stamp;
+          }
+        });
+
+        return sizeof(operation_struct);
       }
+
+      default:
+        return 0;
     }
   }
 
+  // Operations are packed without padding and operation_type_*_struct have a const member.
+  // Thus, we read each field from the buffer instead of copying the whole struct.
+  //
+  // The string is terminated at `length` even if corrupted data is sent.
+  static std::string read_string(const uint8_t* p, size_t length) {
+    auto s = reinterpret_cast<const char*>(p);
+    return std::string(s, strnlen(s, length));
+  }
+
   std::string socket_path_;
   std::vector<uint8_t> buffer_;
   std::unique_ptr<local_datagram_server> server_;
@@ -4,6 +4,7 @@
 
 #include "apple_hid_usage_tables.hpp"
 #include "configuration_monitor.hpp"
+#include "console_user_server_client.hpp"
 #include "constants.hpp"
 #include "device_detail.hpp"
 #include "event_tap_manager.hpp"
@@ -12,8 +13,12 @@
 #include "iokit_utility.hpp"
 #include "krbn_notification_center.hpp"
 #include "logger.hpp"
+#include "manipulator/compiled_rule_set.hpp"
 #include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "manipulator/details/simple_modifications.hpp"
+#include "manipulator/manipulate_batcher.hpp"
 #include "manipulator/manipulator_managers_connector.hpp"
+#include "scheduler.hpp"
 #include "spdlog_utility.hpp"
 #include "system_preferences.hpp"
 #include "types.hpp"
@@ -68,8 +73,13 @@ public:
     manipulator_managers_connector_.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager_,
                                                             posted_event_queue_);
 
+    manipulate_batcher_ = std::make_unique<manipulator::manipulate_batcher>(merged_input_event_queue_,
+                                                                            [this] {
+                                                                              manipulate();
+                                                                            });
+
     input_event_arrived_connection = krbn_notification_center::get_instance().input_event_arrived.connect([&]() {
-      manipulate();
+      manipulate_batcher_->request();
     });
 
     // macOS 10.12 sometimes synchronize caps lock LED to internal keyboard caps lock state.
@@ -116,6 +126,10 @@ public:
 
       input_event_arrived_connection.disconnect();
 
+      // Process pending events before manipulate_batcher_ is released.
+      manipulate_batcher_->flush();
+      manipulate_batcher_ = nullptr;
+
       if (manager_) {
         IOHIDManagerUnscheduleFromRunLoop(manager_, CFRunLoopGetMain(), kCFRunLoopDefaultMode);
         CFRelease(manager_);
@@ -168,6 +182,9 @@ public:
 
       event_tap_manager_ = nullptr;
 
+      // Post pending events (e.g., key_up events of device_ungrabbed) before virtual_hid_device_client_ is closed.
+      manipulate_batcher_->flush();
+
       virtual_hid_device_client_.close();
     });
   }
@@ -246,7 +263,7 @@ public:
       auto event = event_queue::queued_event::event::make_frontmost_application_changed_event(bundle_identifier,
                                                                                               file_path);
       merged_input_event_queue_->emplace_back_event(device_id(0),
-                                                    mach_absolute_time(),
+                                                    scheduler::get_instance().now(),
                                                     event,
                                                     event_type::single,
                                                     event);
@@ -259,7 +276,7 @@ public:
     gcd_utility::dispatch_sync_in_main_queue(^{
       auto event = event_queue::queued_event::event::make_input_source_changed_event(input_source_identifiers);
       merged_input_event_queue_->emplace_back_event(device_id(0),
-                                                    mach_absolute_time(),
+                                                    scheduler::get_instance().now(),
                                                     event,
                                                     event_type::single,
                                                     event);
@@ -274,7 +291,7 @@ public:
         auto keyboard_type = core_configuration_->get_selected_profile().get_virtual_hid_keyboard().get_keyboard_type();
         auto event = event_queue::queued_event::event::make_keyboard_type_changed_event(keyboard_type);
         merged_input_event_queue_->emplace_back_event(device_id(0),
-                                                      mach_absolute_time(),
+                                                      scheduler::get_instance().now(),
                                                       event,
                                                       event_type::single,
                                                       event);
@@ -401,7 +418,8 @@ private:
     manipulator_managers_connector_.manipulate();
 
     posted_event_queue_->clear_events();
-    post_event_to_virtual_devices_manipulator_->post_events(virtual_hid_device_client_);
+    post_event_to_virtual_devices_manipulator_->post_events(virtual_hid_device_client_,
+                                                            console_user_server_client_);
   }
 
   void value_callback(human_interface_device& device,
@@ -431,18 +449,20 @@ private:
   void post_device_ungrabbed_event(device_id device_id) {
     auto event = event_queue::queued_event::event::make_device_ungrabbed_event();
     merged_input_event_queue_->emplace_back_event(device_id,
-                                                  mach_absolute_time(),
+                                                  scheduler::get_instance().now(),
                                                   event,
                                                   event_type::single,
                                                   event);
 
-    krbn_notification_center::get_instance().input_event_arrived();
+    // Process the event immediately in order to release pressed keys
+    // even if virtual_hid_device_client_ is closed after ungrabbing. (e.g., `stop_grabbing`)
+    manipulate_batcher_->flush();
   }
 
   void post_caps_lock_state_changed_callback(bool caps_lock_state) {
     event_queue::queued_event::event event(event_queue::queued_event::event::type::caps_lock_state_changed, caps_lock_state);
     merged_input_event_queue_->emplace_back_event(device_id(0),
-                                                  mach_absolute_time(),
+                                                  scheduler::get_instance().now(),
                                                   event,
                                                   event_type::single,
                                                   event);
@@ -585,7 +605,7 @@ private:
     if (pseudo_event_type && pseudo_event) {
       auto e = event_queue::queued_event::event::make_pointing_device_event_from_event_tap_event();
       merged_input_event_queue_->emplace_back_event(device_id(0),
-                                                    mach_absolute_time(),
+                                                    scheduler::get_instance().now(),
                                                     e,
                                                     *pseudo_event_type,
                                                     *pseudo_event);
@@ -749,24 +769,23 @@ private:
   void update_simple_modifications_manipulators(void) {
     simple_modifications_manipulator_manager_.invalidate_manipulators();
 
+    auto manipulator = std::make_shared<manipulator::details::simple_modifications>();
+
     for (const auto& device : profile_.get_devices()) {
+      auto c = make_device_if_condition(device);
       for (const auto& pair : device.get_simple_modifications().get_pairs()) {
-        if (auto m = make_simple_modifications_manipulator(pair)) {
-          auto c = make_device_if_condition(device);
-          m->push_back_condition(c);
-          simple_modifications_manipulator_manager_.push_back_manipulator(m);
-        }
+        push_back_simple_modifications_pair(*manipulator, pair, c);
       }
     }
 
     for (const auto& pair : profile_.get_simple_modifications().get_pairs()) {
-      if (auto m = make_simple_modifications_manipulator(pair)) {
-        simple_modifications_manipulator_manager_.push_back_manipulator(m);
-      }
+      push_back_simple_modifications_pair(*manipulator, pair, nullptr);
     }
+
+    simple_modifications_manipulator_manager_.push_back_manipulator(manipulator);
   }
 
-  std::shared_ptr<manipulator::details::conditions::base> make_device_if_condition(const core_configuration::profile::device& device) const {
+  std::shared_ptr<manipulator::details::conditions::device> make_device_if_condition(const core_configuration::profile::device& device) const {
     nlohmann::json json;
     json["type"] = "device_if";
     json["identifiers"] = nlohmann::json::array();
@@ -778,36 +797,33 @@ private:
     return std::make_shared<manipulator::details::conditions::device>(json);
   }
 
-  std::shared_ptr<manipulator::details::base> make_simple_modifications_manipulator(const std::pair<core_configuration::profile::simple_modifications::definition, core_configuration::profile::simple_modifications::definition>& pair) const {
+  void push_back_simple_modifications_pair(manipulator::details::simple_modifications& manipulator,
+                                           const std::pair<core_configuration::profile::simple_modifications::definition, core_configuration::profile::simple_modifications::definition>& pair,
+                                           const std::shared_ptr<manipulator::details::conditions::device>& device_condition) const {
     if (pair.first.valid() && pair.second.valid()) {
       auto from_json = pair.first.to_json();
       from_json["modifiers"]["optional"] = "any";
 
       auto to_json = pair.second.to_json();
 
-      return std::make_shared<manipulator::details::basic>(manipulator::details::from_event_definition(from_json),
-                                                           manipulator::details::to_event_definition(to_json));
+      manipulator.push_back_pair(manipulator::details::from_event_definition(from_json),
+                                 manipulator::details::to_event_definition(to_json),
+                                 device_condition);
     }
-    return nullptr;
   }
 
   void update_complex_modifications_manipulators(void) {
     complex_modifications_manipulator_manager_.invalidate_manipulators();
 
-    for (const auto& rule : profile_.get_complex_modifications().get_rules()) {
-      for (const auto& manipulator : rule.get_manipulators()) {
-        auto m = krbn::manipulator::manipulator_factory::make_manipulator(manipulator.get_json(), manipulator.get_parameters());
-        for (const auto& c : manipulator.get_conditions()) {
-          m->push_back_condition(krbn::manipulator::manipulator_factory::make_condition(c.get_json()));
-        }
-        complex_modifications_manipulator_manager_.push_back_manipulator(m);
-      }
-    }
+    complex_modifications_rule_set_.update(profile_.get_complex_modifications());
+    complex_modifications_rule_set_.push_back_manipulators(complex_modifications_manipulator_manager_);
   }
 
   void update_fn_function_keys_manipulators(void) {
     fn_function_keys_manipulator_manager_.invalidate_manipulators();
 
+    auto manipulator = std::make_shared<manipulator::details::simple_modifications>();
+
     std::unordered_set<manipulator::details::event_definition::modifier> from_mandatory_modifiers;
     std::unordered_set<manipulator::details::event_definition::modifier> from_optional_modifiers({
         manipulator::details::event_definition::modifier::any,
@@ -841,45 +857,43 @@ private:
                key_code::f11,
                key_code::f12,
            })) {
-        auto manipulator = std::make_shared<manipulator::details::basic>(manipulator::details::from_event_definition(
-                                                                             key_code,
-                                                                             {
-                                                                                 manipulator::details::event_definition::modifier::fn,
-                                                                             },
-                                                                             {
-                                                                                 manipulator::details::event_definition::modifier::any,
-                                                                             }),
-                                                                         manipulator::details::to_event_definition(
-                                                                             key_code,
-                                                                             {
-                                                                                 manipulator::details::event_definition::modifier::fn,
-                                                                             }));
-        fn_function_keys_manipulator_manager_.push_back_manipulator(std::shared_ptr<manipulator::details::base>(manipulator));
+        manipulator->push_back_pair(manipulator::details::from_event_definition(
+                                        key_code,
+                                        {
+                                            manipulator::details::event_definition::modifier::fn,
+                                        },
+                                        {
+                                            manipulator::details::event_definition::modifier::any,
+                                        }),
+                                    manipulator::details::to_event_definition(
+                                        key_code,
+                                        {
+                                            manipulator::details::event_definition::modifier::fn,
+                                        }));
       }
     }
 
     // from_modifiers+f1 -> display_brightness_decrement ...
 
     for (const auto& device : profile_.get_devices()) {
+      auto c = make_device_if_condition(device);
       for (const auto& pair : device.get_fn_function_keys().get_pairs()) {
-        if (auto m = make_fn_function_keys_manipulator(pair,
-                                                       from_mandatory_modifiers,
-                                                       from_optional_modifiers,
-                                                       to_modifiers)) {
-          auto c = make_device_if_condition(device);
-          m->push_back_condition(c);
-          fn_function_keys_manipulator_manager_.push_back_manipulator(m);
-        }
+        push_back_fn_function_keys_pair(*manipulator,
+                                        pair,
+                                        from_mandatory_modifiers,
+                                        from_optional_modifiers,
+                                        to_modifiers,
+                                        c);
       }
     }
 
     for (const auto& pair : profile_.get_fn_function_keys().get_pairs()) {
-      if (auto m = make_fn_function_keys_manipulator(pair,
-                                                     from_mandatory_modifiers,
-                                                     from_optional_modifiers,
-                                                     to_modifiers)) {
-        fn_function_keys_manipulator_manager_.push_back_manipulator(m);
-      }
+      push_back_fn_function_keys_pair(*manipulator,
+                                      pair,
+                                      from_mandatory_modifiers,
+                                      from_optional_modifiers,
+                                      to_modifiers,
+                                      nullptr);
     }
 
     // fn+return_or_enter -> keypad_enter ...
@@ -893,44 +907,48 @@ private:
         std::make_pair(key_code::up_arrow, key_code::page_up),
     });
     for (const auto& p : pairs) {
-      auto manipulator = std::make_shared<manipulator::details::basic>(manipulator::details::from_event_definition(
-                                                                           p.first,
-                                                                           {
-                                                                               manipulator::details::event_definition::modifier::fn,
-                                                                           },
-                                                                           {
-                                                                               manipulator::details::event_definition::modifier::any,
-                                                                           }),
-                                                                       manipulator::details::to_event_definition(
-                                                                           p.second,
-                                                                           {
-                                                                               manipulator::details::event_definition::modifier::fn,
-                                                                           }));
-      fn_function_keys_manipulator_manager_.push_back_manipulator(std::shared_ptr<manipulator::details::base>(manipulator));
-    }
-  }
-
-  std::shared_ptr<manipulator::details::base> make_fn_function_keys_manipulator(const std::pair<core_configuration::profile::simple_modifications::definition, core_configuration::profile::simple_modifications::definition>& pair,
-                                                                                const std::unordered_set<manipulator::details::event_definition::modifier>& from_mandatory_modifiers,
-                                                                                const std::unordered_set<manipulator::details::event_definition::modifier>& from_optional_modifiers,
-                                                                                const std::unordered_set<manipulator::details::event_definition::modifier>& to_modifiers) {
+      manipulator->push_back_pair(manipulator::details::from_event_definition(
+                                      p.first,
+                                      {
+                                          manipulator::details::event_definition::modifier::fn,
+                                      },
+                                      {
+                                          manipulator::details::event_definition::modifier::any,
+                                      }),
+                                  manipulator::details::to_event_definition(
+                                      p.second,
+                                      {
+                                          manipulator::details::event_definition::modifier::fn,
+                                      }));
+    }
+
+    fn_function_keys_manipulator_manager_.push_back_manipulator(manipulator);
+  }
+
+  void push_back_fn_function_keys_pair(manipulator::details::simple_modifications& manipulator,
+                                       const std::pair<core_configuration::profile::simple_modifications::definition, core_configuration::profile::simple_modifications::definition>& pair,
+                                       const std::unordered_set<manipulator::details::event_definition::modifier>& from_mandatory_modifiers,
+                                       const std::unordered_set<manipulator::details::event_definition::modifier>& from_optional_modifiers,
+                                       const std::unordered_set<manipulator::details::event_definition::modifier>& to_modifiers,
+                                       const std::shared_ptr<manipulator::details::conditions::device>& device_condition) const {
     if (pair.first.valid() && pair.second.valid()) {
       if (auto from_event = types::make_key_code(pair.first.get_value())) {
         if (auto to_event = types::make_key_code(pair.second.get_value())) {
-          return std::make_shared<manipulator::details::basic>(manipulator::details::from_event_definition(
-                                                                   *from_event,
-                                                                   from_mandatory_modifiers,
-                                                                   from_optional_modifiers),
-                                                               manipulator::details::to_event_definition(
-                                                                   *to_event,
-                                                                   to_modifiers));
+          manipulator.push_back_pair(manipulator::details::from_event_definition(
+                                         *from_event,
+                                         from_mandatory_modifiers,
+                                         from_optional_modifiers),
+                                     manipulator::details::to_event_definition(
+                                         *to_event,
+                                         to_modifiers),
+                                     device_condition);
         }
       }
     }
-    return nullptr;
   }
 
   virtual_hid_device_client virtual_hid_device_client_;
+  console_user_server_client console_user_server_client_;
   boost::signals2::connection client_connected_connection;
   boost::signals2::connection client_disconnected_connection;
 
@@ -947,12 +965,14 @@ private:
 
   manipulator::manipulator_managers_connector manipulator_managers_connector_;
   boost::signals2::connection input_event_arrived_connection;
+  std::unique_ptr<manipulator::manipulate_batcher> manipulate_batcher_;
 
   std::shared_ptr<event_queue> merged_input_event_queue_;
 
   manipulator::manipulator_manager simple_modifications_manipulator_manager_;
   std::shared_ptr<event_queue> simple_modifications_applied_event_queue_;
 
+  manipulator::compiled_rule_set complex_modifications_rule_set_;
   manipulator::manipulator_manager complex_modifications_manipulator_manager_;
   std::shared_ptr<event_queue> complex_modifications_applied_event_queue_;
 
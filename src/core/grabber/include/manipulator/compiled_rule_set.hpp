@@ -0,0 +1,202 @@
+#pragma once
+
+#include "boost_defs.hpp"
+
+#include "core_configuration.hpp"
+#include "manipulator/manipulator_factory.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include <boost/functional/hash.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace krbn {
+namespace manipulator {
+// compiled_rule_set holds parsed manipulators of complex_modifications.
+//
+// Manipulators and conditions are cached by their json contents,
+// so `update` parses only changed manipulators when the profile is switched or karabiner.json is updated.
+// The same conditions share one instance (and one set of compiled std::regex).
+//
+// The cached manipulators are prototypes. `push_back_manipulators` pushes their clones into manipulator_manager.
+
+class compiled_rule_set final {
+public:
+  compiled_rule_set(const compiled_rule_set&) = delete;
+
+  compiled_rule_set(void) : generation_(0) {
+  }
+
+  void update(const core_configuration::profile::complex_modifications& complex_modifications) {
+    ++generation_;
+    manipulators_.clear();
+
+    for (const auto& rule : complex_modifications.get_rules()) {
+      for (const auto& manipulator : rule.get_manipulators()) {
+        // The manipulator json contains conditions.
+        // We have to use the parameters as a part of the key since they are inherited from complex_modifications.
+        auto parameters = make_parameters_values(manipulator.get_parameters());
+        auto hash = hash_json(manipulator.get_json());
+        boost::hash_combine(hash, parameters);
+
+        auto& entries = manipulator_cache_[hash];
+        auto it = std::find_if(std::begin(entries),
+                               std::end(entries),
+                               [&](const auto& e) {
+                                 return e.parameters == parameters &&
+                                        e.json == manipulator.get_json();
+                               });
+        if (it == std::end(entries)) {
+          auto m = manipulator_factory::make_manipulator(manipulator.get_json(), manipulator.get_parameters());
+          for (const auto& c : manipulator.get_conditions()) {
+            m->push_back_condition(find_or_make_condition(c.get_json()));
+          }
+          entries.push_back({manipulator.get_json(), parameters, m, generation_});
+          it = std::end(entries) - 1;
+        }
+
+        it->generation = generation_;
+        manipulators_.push_back(it->manipulator);
+      }
+    }
+
+    // Keep unused manipulators in order to make switching back to the previous profile fast,
+    // but drop them when the cache becomes too large.
+
+    if (get_manipulator_cache_size() > manipulators_.size() * 2 + 64) {
+      for (auto it = std::begin(manipulator_cache_); it != std::end(manipulator_cache_);) {
+        auto& entries = it->second;
+        entries.erase(std::remove_if(std::begin(entries),
+                                     std::end(entries),
+                                     [&](const auto& e) {
+                                       return e.generation != generation_;
+                                     }),
+                      std::end(entries));
+        if (entries.empty()) {
+          it = manipulator_cache_.erase(it);
+        } else {
+          std::advance(it, 1);
+        }
+      }
+
+      // Drop conditions which are not used by any cached manipulators.
+      for (auto it = std::begin(condition_cache_); it != std::end(condition_cache_);) {
+        auto& entries = it->second;
+        entries.erase(std::remove_if(std::begin(entries),
+                                     std::end(entries),
+                                     [&](const auto& e) {
+                                       return e.second.use_count() == 1;
+                                     }),
+                      std::end(entries));
+        if (entries.empty()) {
+          it = condition_cache_.erase(it);
+        } else {
+          std::advance(it, 1);
+        }
+      }
+    }
+  }
+
+  void push_back_manipulators(manipulator_manager& manipulator_manager) const {
+    for (const auto& m : manipulators_) {
+      manipulator_manager.push_back_manipulator(m->clone());
+    }
+  }
+
+  size_t get_manipulators_size(void) const {
+    return manipulators_.size();
+  }
+
+  size_t get_manipulator_cache_size(void) const {
+    size_t size = 0;
+    for (const auto& pair : manipulator_cache_) {
+      size += pair.second.size();
+    }
+    return size;
+  }
+
+  size_t get_condition_cache_size(void) const {
+    size_t size = 0;
+    for (const auto& pair : condition_cache_) {
+      size += pair.second.size();
+    }
+    return size;
+  }
+
+private:
+  struct manipulator_cache_entry final {
+    nlohmann::json json;
+    std::vector<int> parameters;
+    std::shared_ptr<details::base> manipulator;
+    uint64_t generation;
+  };
+
+  static std::vector<int> make_parameters_values(const core_configuration::profile::complex_modifications::parameters& parameters) {
+    return {
+        parameters.get_basic_to_if_alone_timeout_milliseconds(),
+        parameters.get_basic_to_delayed_action_delay_milliseconds(),
+    };
+  }
+
+  // Calculate hash without `json.dump()` since serialization is slower than parsing manipulators.
+  static size_t hash_json(const nlohmann::json& json) {
+    size_t seed = static_cast<size_t>(json.type());
+
+    switch (json.type()) {
+      case nlohmann::json::value_t::object:
+        for (auto it = std::begin(json); it != std::end(json); std::advance(it, 1)) {
+          boost::hash_combine(seed, it.key());
+          boost::hash_combine(seed, hash_json(it.value()));
+        }
+        break;
+
+      case nlohmann::json::value_t::array:
+        for (const auto& j : json) {
+          boost::hash_combine(seed, hash_json(j));
+        }
+        break;
+
+      case nlohmann::json::value_t::string:
+        boost::hash_combine(seed, json.get_ref<const std::string&>());
+        break;
+
+      case nlohmann::json::value_t::boolean:
+        boost::hash_combine(seed, json.get<bool>());
+        break;
+
+      case nlohmann::json::value_t::number_integer:
+      case nlohmann::json::value_t::number_unsigned:
+        boost::hash_combine(seed, json.get<int64_t>());
+        break;
+
+      case nlohmann::json::value_t::number_float:
+        boost::hash_combine(seed, json.get<double>());
+        break;
+
+      case nlohmann::json::value_t::null:
+      case nlohmann::json::value_t::discarded:
+        break;
+    }
+
+    return seed;
+  }
+
+  std::shared_ptr<details::conditions::base> find_or_make_condition(const nlohmann::json& json) {
+    auto& entries = condition_cache_[hash_json(json)];
+    for (const auto& e : entries) {
+      if (e.first == json) {
+        return e.second;
+      }
+    }
+
+    auto c = manipulator_factory::make_condition(json);
+    entries.emplace_back(json, c);
+    return c;
+  }
+
+  std::vector<std::shared_ptr<details::base>> manipulators_;
+  std::unordered_map<size_t, std::vector<manipulator_cache_entry>> manipulator_cache_;
+  std::unordered_map<size_t, std::vector<std::pair<nlohmann::json, std::shared_ptr<details::conditions::base>>>> condition_cache_;
+  uint64_t generation_;
+};
+} // namespace manipulator
+} // namespace krbn
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "manipulator/details/conditions/base.hpp"
+#include <algorithm>
 
 namespace krbn {
 namespace manipulator {
@@ -11,22 +12,32 @@ public:
   condition_manager(void) {
   }
 
+  // Conditions are kept in ascending order of the estimated cost. (The order of conditions which have the same cost is kept.)
   void push_back_condition(const std::shared_ptr<krbn::manipulator::details::conditions::base>& condition) {
-    conditions_.push_back(condition);
+    auto it = std::upper_bound(std::begin(conditions_),
+                               std::end(conditions_),
+                               condition->get_estimated_cost(),
+                               [](int cost, const auto& c) {
+                                 return cost < c->get_estimated_cost();
+                               });
+    conditions_.insert(it, condition);
+  }
+
+  const std::vector<std::shared_ptr<krbn::manipulator::details::conditions::base>>& get_conditions(void) const {
+    return conditions_;
   }
 
   bool is_fulfilled(const event_queue::queued_event& queued_event,
                     const krbn::manipulator_environment& manipulator_environment) const {
-    bool result = true;
-
+    // Stop at the first unfulfilled condition. (Cheap conditions are evaluated first.)
     for (const auto& c : conditions_) {
       if (!c->is_fulfilled(queued_event,
                            manipulator_environment)) {
-        result = false;
+        return false;
       }
     }
 
-    return result;
+    return true;
   }
 
 private:
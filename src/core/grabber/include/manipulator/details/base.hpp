@@ -23,6 +23,12 @@ public:
 
   virtual bool active(void) const = 0;
 
+  // manipulator_manager calls `manipulate` only with events which are equal to the returned event.
+  // Return boost::none if `manipulate` has to be called with all events.
+  virtual boost::optional<event_queue::queued_event::event> get_manipulate_target_event(void) const {
+    return boost::none;
+  }
+
   virtual bool needs_virtual_hid_pointing(void) const = 0;
 
   virtual void handle_device_keys_and_pointing_buttons_are_released_event(const event_queue::queued_event& front_input_event,
@@ -38,7 +44,9 @@ public:
   virtual void handle_pointing_device_event_from_event_tap(const event_queue::queued_event& front_input_event,
                                                            event_queue& output_event_queue) = 0;
 
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) = 0;
+  // Make a new manipulator which has the same definition and conditions.
+  // The state (e.g., manipulated events) is not copied.
+  virtual std::shared_ptr<base> clone(void) const = 0;
 
   bool get_valid(void) const {
     return valid_;
@@ -52,6 +60,12 @@ public:
   }
 
 protected:
+  void copy_conditions(const base& other) {
+    for (const auto& c : other.condition_manager_.get_conditions()) {
+      push_back_condition(c);
+    }
+  }
+
   bool valid_;
   condition_manager condition_manager_;
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core_configuration.hpp"
 #include "krbn_notification_center.hpp"
 #include "manipulator/details/base.hpp"
 #include "manipulator/details/types.hpp"
@@ -17,7 +18,7 @@ public:
   public:
     manipulated_original_event(device_id device_id,
                                const event_queue::queued_event::event& original_event,
-                               const std::unordered_set<modifier_flag>& from_mandatory_modifiers,
+                               const modifier_flag_mask& from_mandatory_modifiers,
                                uint64_t key_down_time_stamp) : device_id_(device_id),
                                                                original_event_(original_event),
                                                                from_mandatory_modifiers_(from_mandatory_modifiers),
@@ -33,7 +34,7 @@ public:
       return original_event_;
     }
 
-    const std::unordered_set<modifier_flag>& get_from_mandatory_modifiers(void) const {
+    const modifier_flag_mask& get_from_mandatory_modifiers(void) const {
       return from_mandatory_modifiers_;
     }
 
@@ -58,7 +59,7 @@ public:
   private:
     device_id device_id_;
     event_queue::queued_event::event original_event_;
-    std::unordered_set<modifier_flag> from_mandatory_modifiers_;
+    modifier_flag_mask from_mandatory_modifiers_;
     uint64_t key_down_time_stamp_;
     bool alone_;
   };
@@ -102,8 +103,14 @@ public:
       }
     }
 
+    to_delayed_action(basic& basic,
+                      const to_delayed_action& other) : basic_(basic),
+                                                        to_if_invoked_(other.to_if_invoked_),
+                                                        to_if_canceled_(other.to_if_canceled_) {
+    }
+
     void setup(const event_queue::queued_event& front_input_event,
-               const std::unordered_set<modifier_flag>& from_mandatory_modifiers,
+               const modifier_flag_mask& from_mandatory_modifiers,
                const std::shared_ptr<event_queue>& output_event_queue,
                int delay_milliseconds) {
       if (front_input_event.get_event_type() != event_type::key_down) {
@@ -120,7 +127,11 @@ public:
       output_event_queue_ = output_event_queue;
 
       auto when = front_input_event.get_time_stamp() + time_utility::nano_to_absolute(delay_milliseconds * NSEC_PER_MSEC);
-      manipulator_timer_id_ = manipulator_timer::get_instance().add_entry(when);
+      manipulator_timer_client_.set_entry(when,
+                                          [this] {
+                                            post_events(to_if_invoked_);
+                                            krbn_notification_center::get_instance().input_event_arrived();
+                                          });
     }
 
     void cancel(const event_queue::queued_event& front_input_event) {
@@ -128,23 +139,15 @@ public:
         return;
       }
 
-      if (!manipulator_timer_id_) {
+      if (!manipulator_timer_client_.active()) {
         return;
       }
 
-      manipulator_timer_id_ = boost::none;
+      manipulator_timer_client_.cancel();
 
       post_events(to_if_canceled_);
     }
 
-    void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
-      if (timer_id == manipulator_timer_id_) {
-        manipulator_timer_id_ = boost::none;
-        post_events(to_if_invoked_);
-        krbn_notification_center::get_instance().input_event_arrived();
-      }
-    }
-
     bool needs_virtual_hid_pointing(void) const {
       for (const auto& events : {to_if_invoked_,
                                  to_if_canceled_}) {
@@ -192,9 +195,9 @@ public:
     basic& basic_;
     std::vector<to_event_definition> to_if_invoked_;
     std::vector<to_event_definition> to_if_canceled_;
-    boost::optional<manipulator_timer::timer_id> manipulator_timer_id_;
+    manipulator_timer::client manipulator_timer_client_;
     boost::optional<event_queue::queued_event> front_input_event_;
-    std::unordered_set<modifier_flag> from_mandatory_modifiers_;
+    modifier_flag_mask from_mandatory_modifiers_;
     std::weak_ptr<event_queue> output_event_queue_;
   };
 
@@ -257,6 +260,21 @@ public:
                                          to_({to}) {
   }
 
+  basic(const basic& other) : base(),
+                              parameters_(other.parameters_),
+                              from_(other.from_),
+                              to_(other.to_),
+                              to_after_key_up_(other.to_after_key_up_),
+                              to_if_alone_(other.to_if_alone_) {
+    // Copy the definition only. (The state such as manipulated_original_events_ is not copied.)
+
+    if (other.to_delayed_action_) {
+      to_delayed_action_ = std::make_unique<to_delayed_action>(*this, *(other.to_delayed_action_));
+    }
+
+    copy_conditions(other);
+  }
+
   virtual ~basic(void) {
   }
 
@@ -297,7 +315,7 @@ public:
       }
 
       if (is_target) {
-        std::unordered_set<modifier_flag> from_mandatory_modifiers;
+        modifier_flag_mask from_mandatory_modifiers;
         uint64_t key_down_time_stamp = 0;
         bool alone = false;
 
@@ -498,6 +516,26 @@ public:
     return !manipulated_original_events_.empty();
   }
 
+  virtual boost::optional<event_queue::queued_event::event> get_manipulate_target_event(void) const {
+    // `unset_alone_if_needed` and `to_delayed_action_->cancel` require all events.
+    if (!to_if_alone_.empty() || to_delayed_action_) {
+      return boost::none;
+    }
+
+    if (auto key_code = from_.get_key_code()) {
+      return event_queue::queued_event::event(*key_code);
+    }
+    if (auto consumer_key_code = from_.get_consumer_key_code()) {
+      return event_queue::queued_event::event(*consumer_key_code);
+    }
+    if (auto pointing_button = from_.get_pointing_button()) {
+      return event_queue::queued_event::event(*pointing_button);
+    }
+
+    // `from` is `any`.
+    return boost::none;
+  }
+
   virtual bool needs_virtual_hid_pointing(void) const {
     for (const auto& events : {to_,
                                to_after_key_up_,
@@ -545,10 +583,8 @@ public:
                           front_input_event.get_event_type());
   }
 
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
-    if (to_delayed_action_) {
-      to_delayed_action_->manipulator_timer_invoked(timer_id);
-    }
+  virtual std::shared_ptr<base> clone(void) const {
+    return std::make_shared<basic>(*this);
   }
 
   const from_event_definition& get_from(void) const {
@@ -607,7 +643,7 @@ private:
   }
 
   void post_lazy_modifier_key_events(const event_queue::queued_event& front_input_event,
-                                     const std::unordered_set<modifier_flag>& modifiers,
+                                     const modifier_flag_mask& modifiers,
                                      event_type event_type,
                                      uint64_t& time_stamp_delay,
                                      event_queue& output_event_queue) {
@@ -18,6 +18,10 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const = 0;
+
+  // condition_manager evaluates conditions in ascending order of the estimated cost.
+  // The cost is the one when the result is not cached.
+  virtual int get_estimated_cost(void) const = 0;
 };
 } // namespace conditions
 } // namespace details
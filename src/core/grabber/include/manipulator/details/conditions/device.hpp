@@ -54,50 +54,77 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
-    if (!definitions_.empty()) {
-      if (auto dd = types::find_device_detail(queued_event.get_device_id())) {
-        for (const auto& d : definitions_) {
-          bool fulfilled = true;
+    return is_fulfilled(queued_event.get_device_id());
+  }
 
-          if (d.vendor_id && d.vendor_id != dd->get_vendor_id()) {
-            fulfilled = false;
-          }
-          if (d.product_id && d.product_id != dd->get_product_id()) {
-            fulfilled = false;
-          }
-          if (d.location_id && d.location_id != dd->get_location_id()) {
-            fulfilled = false;
-          }
-          if (d.is_keyboard && d.is_keyboard != dd->get_is_keyboard()) {
-            fulfilled = false;
-          }
-          if (d.is_pointing_device && d.is_pointing_device != dd->get_is_pointing_device()) {
-            fulfilled = false;
-          }
+  // device conditions depend only on the device.
+  // (manipulator::details::simple_modifications resolves them for each device_id.)
+  bool is_fulfilled(device_id device_id) const {
+    // device_detail of a device_id is never changed and device_ids are not reused,
+    // so the result is calculated only once for each device_id.
 
-          if (fulfilled) {
-            switch (type_) {
-              case type::device_if:
-                return true;
-              case type::device_unless:
-                return false;
-            }
-          }
-        }
-      }
+    auto index = static_cast<size_t>(device_id);
+    if (index < cached_results_.size() && cached_results_[index]) {
+      return *(cached_results_[index]);
+    }
+
+    if (definitions_.empty()) {
+      return make_result(false);
     }
 
-    // Not found
+    auto dd = types::find_device_detail(device_id);
+    if (!dd) {
+      // Do not cache the result since the device might not be registered yet.
+      return make_result(false);
+    }
+
+    auto result = make_result(test(*dd));
+
+    if (index >= cached_results_.size()) {
+      cached_results_.resize(index + 1);
+    }
+    cached_results_[index] = result;
 
+    return result;
+  }
+
+  virtual int get_estimated_cost(void) const {
+    // A vector lookup (comparisons of device_detail at the first event of each device)
+    return 1;
+  }
+
+private:
+  bool make_result(bool matched) const {
     switch (type_) {
       case type::device_if:
-        return false;
+        return matched;
       case type::device_unless:
-        return true;
+        return !matched;
     }
   }
 
-private:
+  bool test(const device_detail& dd) const {
+    for (const auto& d : definitions_) {
+      if (d.vendor_id && d.vendor_id != dd.get_vendor_id()) {
+        continue;
+      }
+      if (d.product_id && d.product_id != dd.get_product_id()) {
+        continue;
+      }
+      if (d.location_id && d.location_id != dd.get_location_id()) {
+        continue;
+      }
+      if (d.is_keyboard && d.is_keyboard != dd.get_is_keyboard()) {
+        continue;
+      }
+      if (d.is_pointing_device && d.is_pointing_device != dd.get_is_pointing_device()) {
+        continue;
+      }
+      return true;
+    }
+    return false;
+  }
+
   struct definition final {
     boost::optional<vendor_id> vendor_id;
     boost::optional<product_id> product_id;
@@ -165,6 +192,9 @@ private:
 
   type type_;
   std::vector<definition> definitions_;
+
+  // Results indexed by device_id (boost::none: not calculated yet)
+  mutable std::vector<boost::optional<bool>> cached_results_;
 };
 } // namespace conditions
 } // namespace details
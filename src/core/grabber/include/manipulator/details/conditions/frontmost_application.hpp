@@ -1,7 +1,7 @@
 #pragma once
 
 #include "manipulator/details/conditions/base.hpp"
-#include <regex>
+#include "regex_set.hpp"
 #include <string>
 #include <vector>
 
@@ -16,6 +16,9 @@ public:
     frontmost_application_unless,
   };
 
+  // Copying is not allowed since the destructor releases patterns in the regex sets.
+  frontmost_application(const frontmost_application&) = delete;
+
   frontmost_application(const nlohmann::json& json) : base(),
                                                       type_(type::frontmost_application_if) {
     if (json.is_object()) {
@@ -39,8 +42,7 @@ public:
               if (j.is_string()) {
                 std::string s = j;
                 try {
-                  std::regex r(s);
-                  bundle_identifiers_.push_back(r);
+                  bundle_identifiers_.push_back(get_bundle_identifiers_regex_set().insert(s));
                 } catch (std::exception& e) {
                   logger::get_logger().error("complex_modifications json error: Regex error: \"{0}\" {1}", s, e.what());
                 }
@@ -53,8 +55,7 @@ public:
               if (j.is_string()) {
                 std::string s = j;
                 try {
-                  std::regex r(s);
-                  file_paths_.push_back(r);
+                  file_paths_.push_back(get_file_paths_regex_set().insert(s));
                 } catch (std::exception& e) {
                   logger::get_logger().error("complex_modifications json error: Regex error: \"{0}\" {1}", s, e.what());
                 }
@@ -69,50 +70,37 @@ public:
   }
 
   virtual ~frontmost_application(void) {
+    for (const auto& i : bundle_identifiers_) {
+      get_bundle_identifiers_regex_set().erase(i);
+    }
+    for (const auto& i : file_paths_) {
+      get_file_paths_regex_set().erase(i);
+    }
   }
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
-    if (cached_result_ && cached_result_->first == manipulator_environment.get_frontmost_application()) {
+    auto generation = manipulator_environment.get_frontmost_application_generation();
+    if (cached_result_ && cached_result_->first == generation) {
       return cached_result_->second;
     }
 
     auto& current_bundle_identifier = manipulator_environment.get_frontmost_application().get_bundle_identifier();
     auto& current_file_path = manipulator_environment.get_frontmost_application().get_file_path();
 
-    // Bundle identifiers
+    // Patterns of all frontmost_application conditions are matched at once by the first condition evaluated after the application is changed.
 
     bool result = false;
 
-    for (const auto& b : bundle_identifiers_) {
-      if (regex_search(std::begin(current_bundle_identifier),
-                       std::end(current_bundle_identifier),
-                       b)) {
-        switch (type_) {
-          case type::frontmost_application_if:
-            result = true;
-            goto finish;
-          case type::frontmost_application_unless:
-            result = false;
-            goto finish;
-        }
-      }
-    }
-
-    // File paths
-
-    for (const auto& f : file_paths_) {
-      if (regex_search(std::begin(current_file_path),
-                       std::end(current_file_path),
-                       f)) {
-        switch (type_) {
-          case type::frontmost_application_if:
-            result = true;
-            goto finish;
-          case type::frontmost_application_unless:
-            result = false;
-            goto finish;
-        }
+    if (get_bundle_identifiers_regex_set().match_any(current_bundle_identifier, bundle_identifiers_) ||
+        get_file_paths_regex_set().match_any(current_file_path, file_paths_)) {
+      switch (type_) {
+        case type::frontmost_application_if:
+          result = true;
+          goto finish;
+        case type::frontmost_application_unless:
+          result = false;
+          goto finish;
       }
     }
 
@@ -128,16 +116,34 @@ public:
     }
 
   finish:
-    cached_result_ = std::make_pair(manipulator_environment.get_frontmost_application(), result);
+    cached_result_ = std::make_pair(generation, result);
     return result;
   }
 
+  virtual int get_estimated_cost(void) const {
+    // Regular expressions
+    return 5;
+  }
+
+  // The regex sets are shared by all frontmost_application conditions.
+  static regex_set& get_bundle_identifiers_regex_set(void) {
+    static regex_set instance;
+    return instance;
+  }
+
+  static regex_set& get_file_paths_regex_set(void) {
+    static regex_set instance;
+    return instance;
+  }
+
 private:
   type type_;
-  std::vector<std::regex> bundle_identifiers_;
-  std::vector<std::regex> file_paths_;
+  // Indices in the regex sets
+  std::vector<size_t> bundle_identifiers_;
+  std::vector<size_t> file_paths_;
 
-  mutable boost::optional<std::pair<manipulator_environment::frontmost_application, bool>> cached_result_;
+  // (frontmost_application_generation, result)
+  mutable boost::optional<std::pair<uint64_t, bool>> cached_result_;
 };
 } // namespace conditions
 } // namespace details
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "manipulator/details/conditions/base.hpp"
+#include "regex_set.hpp"
 #include <string>
 #include <vector>
 
@@ -15,6 +16,9 @@ public:
     input_source_unless,
   };
 
+  // Copying is not allowed since the destructor releases patterns in the regex sets.
+  input_source(const input_source&) = delete;
+
   input_source(const nlohmann::json& json) : base(),
                                              type_(type::input_source_if) {
     if (json.is_object()) {
@@ -34,7 +38,8 @@ public:
           }
         } else if (key == "input_sources") {
           for (const auto& j : value) {
-            input_source_selectors_.emplace_back(j);
+            // input_source_selector validates json and regexs.
+            input_source_selectors_.push_back(make_selector(input_source_selector(j)));
           }
         } else {
           logger::get_logger().error("complex_modifications json error: Unknown key: {0} in {1}", key, json.dump());
@@ -44,18 +49,30 @@ public:
   }
 
   virtual ~input_source(void) {
+    for (const auto& s : input_source_selectors_) {
+      if (s.language) {
+        get_languages_regex_set().erase(*s.language);
+      }
+      if (s.input_source_id) {
+        get_input_source_ids_regex_set().erase(*s.input_source_id);
+      }
+      if (s.input_mode_id) {
+        get_input_mode_ids_regex_set().erase(*s.input_mode_id);
+      }
+    }
   }
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
-    if (cached_result_ && cached_result_->first == manipulator_environment.get_input_source_identifiers()) {
+    auto generation = manipulator_environment.get_input_source_identifiers_generation();
+    if (cached_result_ && cached_result_->first == generation) {
       return cached_result_->second;
     }
 
     bool result = false;
 
     for (const auto& s : input_source_selectors_) {
-      if (s.test(manipulator_environment.get_input_source_identifiers())) {
+      if (test(s, manipulator_environment.get_input_source_identifiers())) {
         switch (type_) {
           case type::input_source_if:
             result = true;
@@ -79,15 +96,91 @@ public:
     }
 
   finish:
-    cached_result_ = std::make_pair(manipulator_environment.get_input_source_identifiers(), result);
+    cached_result_ = std::make_pair(generation, result);
     return result;
   }
 
+  virtual int get_estimated_cost(void) const {
+    // Regular expressions
+    return 4;
+  }
+
+  // The regex sets are shared by all input_source conditions.
+  static regex_set& get_languages_regex_set(void) {
+    static regex_set instance;
+    return instance;
+  }
+
+  static regex_set& get_input_source_ids_regex_set(void) {
+    static regex_set instance;
+    return instance;
+  }
+
+  static regex_set& get_input_mode_ids_regex_set(void) {
+    static regex_set instance;
+    return instance;
+  }
+
 private:
+  // input_source_selector with indices in the regex sets.
+  struct selector final {
+    boost::optional<size_t> language;
+    boost::optional<size_t> input_source_id;
+    boost::optional<size_t> input_mode_id;
+  };
+
+  static selector make_selector(const input_source_selector& input_source_selector) {
+    selector s;
+
+    // Invalid regexs are already reported by input_source_selector.
+    // The following patterns are ignored as well as input_source_selector::test.
+    try {
+      if (auto& v = input_source_selector.get_language_string()) {
+        s.language = get_languages_regex_set().insert(*v);
+      }
+      if (auto& v = input_source_selector.get_input_source_id_string()) {
+        s.input_source_id = get_input_source_ids_regex_set().insert(*v);
+      }
+      if (auto& v = input_source_selector.get_input_mode_id_string()) {
+        s.input_mode_id = get_input_mode_ids_regex_set().insert(*v);
+      }
+    } catch (std::exception&) {
+    }
+
+    return s;
+  }
+
+  static bool test(const selector& selector,
+                   const input_source_identifiers& input_source_identifiers) {
+    if (selector.language) {
+      auto& v = input_source_identifiers.get_language();
+      if (!v || !get_languages_regex_set().match(*v, *selector.language)) {
+        return false;
+      }
+    }
+
+    if (selector.input_source_id) {
+      auto& v = input_source_identifiers.get_input_source_id();
+      if (!v || !get_input_source_ids_regex_set().match(*v, *selector.input_source_id)) {
+        return false;
+      }
+    }
+
+    if (selector.input_mode_id) {
+      auto& v = input_source_identifiers.get_input_mode_id();
+      if (!v || !get_input_mode_ids_regex_set().match(*v, *selector.input_mode_id)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
   type type_;
-  std::vector<input_source_selector> input_source_selectors_;
+  std::vector<selector> input_source_selectors_;
 
-  mutable boost::optional<std::pair<input_source_identifiers, bool>> cached_result_;
+  // (input_source_identifiers_generation, result)
+  mutable boost::optional<std::pair<uint64_t, bool>> cached_result_;
 };
 } // namespace conditions
 } // namespace details
@@ -48,13 +48,22 @@ public:
 
   virtual bool is_fulfilled(const event_queue::queued_event& queued_event,
                             const manipulator_environment& manipulator_environment) const {
+    auto generation = manipulator_environment.get_keyboard_type_generation();
+    if (cached_result_ && cached_result_->first == generation) {
+      return cached_result_->second;
+    }
+
+    bool result = false;
+
     for (const auto& t : keyboard_types_) {
       if (t == manipulator_environment.get_keyboard_type()) {
         switch (type_) {
           case type::keyboard_type_if:
-            return true;
+            result = true;
+            goto finish;
           case type::keyboard_type_unless:
-            return false;
+            result = false;
+            goto finish;
         }
       }
     }
@@ -63,17 +72,29 @@ public:
 
     switch (type_) {
       case type::keyboard_type_if:
-        return false;
+        result = false;
+        goto finish;
       case type::keyboard_type_unless:
-        return true;
+        result = true;
+        goto finish;
     }
 
-    return false;
+  finish:
+    cached_result_ = std::make_pair(generation, result);
+    return result;
+  }
+
+  virtual int get_estimated_cost(void) const {
+    // String comparisons
+    return 2;
   }
 
 private:
   type type_;
   std::vector<std::string> keyboard_types_;
+
+  // (keyboard_type_generation, result)
+  mutable boost::optional<std::pair<uint64_t, bool>> cached_result_;
 };
 } // namespace conditions
 } // namespace details
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "manipulator/details/conditions/base.hpp"
+#include "variable_name_table.hpp"
 #include <string>
 #include <vector>
 
@@ -16,7 +17,9 @@ public:
   };
 
   variable(const nlohmann::json& json) : base(),
-                                         type_(type::variable_if) {
+                                         type_(type::variable_if),
+                                         variable_id_(variable_name_table::get_instance().intern("")),
+                                         value_(0) {
     if (json.is_object()) {
       for (auto it = std::begin(json); it != std::end(json); std::advance(it, 1)) {
         // it.key() is always std::string.
@@ -34,7 +37,7 @@ public:
           }
         } else if (key == "name") {
           if (value.is_string()) {
-            name_ = value;
+            variable_id_ = variable_name_table::get_instance().intern(value.get<std::string>());
           } else {
             logger::get_logger().error("complex_modifications json error: Invalid form of {0} in {1}", key, json.dump());
           }
@@ -58,15 +61,21 @@ public:
                             const manipulator_environment& manipulator_environment) const {
     switch (type_) {
       case type::variable_if:
-        return manipulator_environment.get_variable(name_) == value_;
+        return manipulator_environment.get_variable(variable_id_) == value_;
       case type::variable_unless:
-        return manipulator_environment.get_variable(name_) != value_;
+        return manipulator_environment.get_variable(variable_id_) != value_;
     }
   }
 
+  virtual int get_estimated_cost(void) const {
+    // A vector lookup
+    return 1;
+  }
+
 private:
   type type_;
-  std::string name_;
+  // The name is interned when the rule is parsed.
+  variable_id variable_id_;
   int value_;
 };
 } // namespace conditions
@@ -44,7 +44,10 @@ public:
                                                            event_queue& output_event_queue) {
   }
 
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
+  virtual std::shared_ptr<base> clone(void) const {
+    auto m = std::make_shared<nop>();
+    m->copy_conditions(*this);
+    return m;
   }
 };
 } // namespace details
@@ -7,13 +7,15 @@
 #include "krbn_notification_center.hpp"
 #include "manipulator/details/base.hpp"
 #include "manipulator/details/types.hpp"
+#include "pressed_key_set.hpp"
+#include "scheduler.hpp"
 #include "stream_utility.hpp"
 #include "time_utility.hpp"
 #include "types.hpp"
 #include "virtual_hid_device_client.hpp"
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
-#include <mach/mach_time.h>
+#include <deque>
 
 namespace krbn {
 namespace manipulator {
@@ -56,7 +58,8 @@ public:
                                             uint64_t time_stamp) {
         event e;
         e.type_ = type::shell_command;
-        e.value_ = shell_command;
+        e.value_ = boost::blank();
+        e.payload_ = std::make_shared<payload>(shell_command);
         e.time_stamp_ = time_stamp;
         return e;
       }
@@ -65,7 +68,8 @@ public:
                                                   uint64_t time_stamp) {
         event e;
         e.type_ = type::select_input_source;
-        e.value_ = input_source_selector;
+        e.value_ = boost::blank();
+        e.payload_ = std::make_shared<payload>(input_source_selector);
         e.time_stamp_ = time_stamp;
         return e;
       }
@@ -153,15 +157,15 @@ public:
       }
 
       boost::optional<std::string> get_shell_command(void) const {
-        if (type_ == type::shell_command) {
-          return boost::get<std::string>(value_);
+        if (type_ == type::shell_command && payload_) {
+          return boost::get<std::string>(*payload_);
         }
         return boost::none;
       }
 
       boost::optional<std::vector<input_source_selector>> get_input_source_selectors(void) const {
-        if (type_ == type::select_input_source) {
-          return boost::get<std::vector<input_source_selector>>(value_);
+        if (type_ == type::select_input_source && payload_) {
+          return boost::get<std::vector<input_source_selector>>(*payload_);
         }
         return boost::none;
       }
@@ -171,12 +175,25 @@ public:
       }
 
       bool operator==(const event& other) const {
+        if (payload_ != other.payload_) {
+          if (!payload_ || !other.payload_ || !(*payload_ == *other.payload_)) {
+            return false;
+          }
+        }
+
         return type_ == other.type_ &&
                value_ == other.value_ &&
                time_stamp_ == other.time_stamp_;
       }
 
     private:
+      // Rare and large values (shell_command, select_input_source) are stored out of line
+      // in order to keep `event` small and cheap to move for key and pointing events.
+      typedef boost::variant<std::string, // For shell_command
+                             std::vector<input_source_selector> // For select_input_source
+                             >
+          payload;
+
       event(void) {
       }
 
@@ -199,11 +216,10 @@ public:
       type type_;
       boost::variant<pqrs::karabiner_virtual_hid_device::hid_event_service::keyboard_event,
                      pqrs::karabiner_virtual_hid_device::hid_report::pointing_input,
-                     boost::blank, // For clear_keyboard_modifier_flags
-                     std::string, // For shell_command
-                     std::vector<input_source_selector> // For select_input_source
+                     boost::blank // For clear_keyboard_modifier_flags, shell_command and select_input_source
                      >
           value_;
+      std::shared_ptr<const payload> payload_;
       uint64_t time_stamp_;
     };
 
@@ -211,7 +227,7 @@ public:
                   last_event_time_stamp_(0) {
     }
 
-    const std::vector<event>& get_events(void) const {
+    const std::deque<event>& get_events(void) const {
       return events_;
     }
 
@@ -273,7 +289,8 @@ public:
       return events_.empty();
     }
 
-    void post_events(virtual_hid_device_client& virtual_hid_device_client) {
+    void post_events(virtual_hid_device_client& virtual_hid_device_client,
+                     console_user_server_client& console_user_server_client) {
       if (timer_ && timer_->fired()) {
         timer_ = nullptr;
       }
@@ -281,7 +298,7 @@ public:
         return;
       }
 
-      uint64_t now = mach_absolute_time();
+      uint64_t now = scheduler::get_instance().now();
 
       while (!events_.empty()) {
         auto& e = events_.front();
@@ -289,11 +306,11 @@ public:
           // If e.get_time_stamp() is too large, we reduce the delay to 3 seconds.
           auto when = std::min(e.get_time_stamp(), now + time_utility::nano_to_absolute(3 * NSEC_PER_SEC));
 
-          timer_ = std::make_unique<gcd_utility::main_queue_after_timer>(when,
-                                                                         true,
-                                                                         ^{
-                                                                           post_events(virtual_hid_device_client);
-                                                                         });
+          timer_ = scheduler::get_instance().make_timer(when,
+                                                        [this, &virtual_hid_device_client, &console_user_server_client] {
+                                                          post_events(virtual_hid_device_client,
+                                                                      console_user_server_client);
+                                                        });
           return;
         }
 
@@ -306,30 +323,17 @@ public:
         if (e.get_type() == event::type::clear_keyboard_modifier_flags) {
           virtual_hid_device_client.clear_keyboard_modifier_flags();
         }
+        // console_user_server_client sends operations in the background.
         if (auto shell_command = e.get_shell_command()) {
-          try {
-            if (auto current_console_user_id = session::get_current_console_user_id()) {
-              console_user_server_client client(*current_console_user_id);
-              client.shell_command_execution(*shell_command);
-            }
-          } catch (std::exception& e) {
-            logger::get_logger().error("error in shell_command: {0}", e.what());
-          }
+          console_user_server_client.shell_command_execution(*shell_command);
         }
         if (auto input_source_selectors = e.get_input_source_selectors()) {
-          try {
-            if (auto current_console_user_id = session::get_current_console_user_id()) {
-              console_user_server_client client(*current_console_user_id);
-              for (const auto& s : *input_source_selectors) {
-                client.select_input_source(s, now);
-              }
-            }
-          } catch (std::exception& e) {
-            logger::get_logger().error("error in select_input_source: {0}", e.what());
+          for (const auto& s : *input_source_selectors) {
+            console_user_server_client.select_input_source(s, now);
           }
         }
 
-        events_.erase(std::begin(events_));
+        events_.pop_front();
       }
     }
 
@@ -377,8 +381,8 @@ public:
       }
     }
 
-    std::vector<event> events_;
-    std::unique_ptr<gcd_utility::main_queue_after_timer> timer_;
+    std::deque<event> events_;
+    std::unique_ptr<scheduler::timer> timer_;
 
     keyboard_repeat_detector keyboard_repeat_detector_;
 
@@ -431,8 +435,7 @@ public:
                                  uint64_t time_stamp) {
       // Enqueue key_down event if it is not sent yet.
 
-      if (!key_event_exists(hid_usage_page, hid_usage)) {
-        pressed_keys_.emplace_back(device_id, std::make_pair(hid_usage_page, hid_usage));
+      if (pressed_keys_.insert(device_id, hid_usage_page, hid_usage)) {
         enqueue_key_event(hid_usage_page, hid_usage, event_type::key_down, queue, time_stamp);
       }
     }
@@ -443,14 +446,7 @@ public:
                                uint64_t time_stamp) {
       // Enqueue key_up event if it is already sent.
 
-      if (key_event_exists(hid_usage_page, hid_usage)) {
-        pressed_keys_.erase(std::remove_if(std::begin(pressed_keys_),
-                                           std::end(pressed_keys_),
-                                           [&](auto& k) {
-                                             return k.second.first == hid_usage_page &&
-                                                    k.second.second == hid_usage;
-                                           }),
-                            std::end(pressed_keys_));
+      if (pressed_keys_.erase(hid_usage_page, hid_usage)) {
         enqueue_key_event(hid_usage_page, hid_usage, event_type::key_up, queue, time_stamp);
       }
     }
@@ -458,9 +454,7 @@ public:
     void dispatch_modifier_key_event(const modifier_flag_manager& modifier_flag_manager,
                                      queue& queue,
                                      uint64_t time_stamp) {
-      size_t previous_pressed_modifier_flags_size = pressed_modifier_flags_.size();
-
-      auto modifier_flags = {
+      static const modifier_flag_mask modifier_flags({
           modifier_flag::left_control,
           modifier_flag::left_shift,
           modifier_flag::left_option,
@@ -470,37 +464,24 @@ public:
           modifier_flag::right_option,
           modifier_flag::right_command,
           modifier_flag::fn,
-      };
-      for (const auto& m : modifier_flags) {
-        bool pressed = pressed_modifier_flags_.find(m) != std::end(pressed_modifier_flags_);
-
-        if (modifier_flag_manager.is_pressed(m)) {
-          if (!pressed) {
-            if (auto key_code = types::make_key_code(m)) {
-              if (auto hid_usage_page = types::make_hid_usage_page(*key_code)) {
-                if (auto hid_usage = types::make_hid_usage(*key_code)) {
-                  enqueue_key_event(*hid_usage_page, *hid_usage, event_type::key_down, queue, time_stamp);
-                }
-              }
-            }
-            pressed_modifier_flags_.insert(m);
-          }
-
-        } else {
-          if (pressed) {
-            if (auto key_code = types::make_key_code(m)) {
-              if (auto hid_usage_page = types::make_hid_usage_page(*key_code)) {
-                if (auto hid_usage = types::make_hid_usage(*key_code)) {
-                  enqueue_key_event(*hid_usage_page, *hid_usage, event_type::key_up, queue, time_stamp);
-                }
-              }
+      });
+
+      auto previous_pressed_modifier_flags = pressed_modifier_flags_;
+      pressed_modifier_flags_ = modifier_flag_manager.get_pressed_modifier_flags() & modifier_flags;
+
+      // Changed flags are dispatched in the order of modifier_flag values.
+      for (const auto& m : previous_pressed_modifier_flags ^ pressed_modifier_flags_) {
+        auto et = pressed_modifier_flags_.contains(m) ? event_type::key_down : event_type::key_up;
+        if (auto key_code = types::make_key_code(m)) {
+          if (auto hid_usage_page = types::make_hid_usage_page(*key_code)) {
+            if (auto hid_usage = types::make_hid_usage(*key_code)) {
+              enqueue_key_event(*hid_usage_page, *hid_usage, et, queue, time_stamp);
             }
-            pressed_modifier_flags_.erase(m);
           }
         }
       }
 
-      if (pressed_modifier_flags_.empty() && previous_pressed_modifier_flags_size > 0) {
+      if (pressed_modifier_flags_.empty() && !previous_pressed_modifier_flags.empty()) {
         queue.push_back_clear_keyboard_modifier_flags_event(time_stamp);
       }
     }
@@ -508,40 +489,16 @@ public:
     void dispatch_key_up_events_by_device_id(device_id device_id,
                                              queue& queue,
                                              uint64_t time_stamp) {
-      while (true) {
-        bool found = false;
-        for (const auto& k : pressed_keys_) {
-          if (k.first == device_id) {
-            found = true;
-            dispatch_key_up_event(k.second.first,
-                                  k.second.second,
-                                  queue,
-                                  time_stamp);
-            break;
-          }
-        }
-        if (!found) {
-          break;
-        }
+      for (const auto& k : pressed_keys_.erase_by_device_id(device_id)) {
+        enqueue_key_event(k.first, k.second, event_type::key_up, queue, time_stamp);
       }
     }
 
-    const std::vector<std::pair<device_id, std::pair<hid_usage_page, hid_usage>>>& get_pressed_keys(void) const {
-      return pressed_keys_;
+    std::vector<std::pair<device_id, std::pair<hid_usage_page, hid_usage>>> get_pressed_keys(void) const {
+      return pressed_keys_.get_keys();
     }
 
   private:
-    bool key_event_exists(hid_usage_page usage_page,
-                          hid_usage usage) {
-      auto it = std::find_if(std::begin(pressed_keys_),
-                             std::end(pressed_keys_),
-                             [&](auto& k) {
-                               return k.second.first == usage_page &&
-                                      k.second.second == usage;
-                             });
-      return (it != std::end(pressed_keys_));
-    }
-
     void enqueue_key_event(hid_usage_page usage_page,
                            hid_usage usage,
                            event_type event_type,
@@ -550,8 +507,8 @@ public:
       queue.emplace_back_key_event(usage_page, usage, event_type, time_stamp);
     }
 
-    std::vector<std::pair<device_id, std::pair<hid_usage_page, hid_usage>>> pressed_keys_;
-    std::unordered_set<modifier_flag> pressed_modifier_flags_;
+    pressed_key_set pressed_keys_;
+    modifier_flag_mask pressed_modifier_flags_;
   };
 
   class mouse_key_handler final {
@@ -596,14 +553,6 @@ public:
                                       horizontal_wheel_count_converter_(128) {
     }
 
-    void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
-      if (timer_id == manipulator_timer_id_) {
-        manipulator_timer_id_ = boost::none;
-        post_event();
-        krbn_notification_center::get_instance().input_event_arrived();
-      }
-    }
-
     void push_back_mouse_key(device_id device_id,
                              const mouse_key& mouse_key,
                              const std::shared_ptr<event_queue>& output_event_queue,
@@ -644,7 +593,7 @@ public:
     }
 
     bool active(void) const {
-      return manipulator_timer_id_ != boost::none;
+      return manipulator_timer_client_.active();
     }
 
   private:
@@ -667,7 +616,7 @@ public:
         }
 
         if (total.is_zero()) {
-          manipulator_timer_id_ = boost::none;
+          manipulator_timer_client_.cancel();
           last_mouse_key_total_ = boost::none;
 
         } else {
@@ -692,7 +641,11 @@ public:
 
           uint64_t delay_milliseconds = 20;
           auto when = last_time_stamp_ + time_utility::nano_to_absolute(delay_milliseconds * NSEC_PER_MSEC);
-          manipulator_timer_id_ = manipulator_timer::get_instance().add_entry(when);
+          manipulator_timer_client_.set_entry(when,
+                                              [this] {
+                                                post_event();
+                                                krbn_notification_center::get_instance().input_event_arrived();
+                                              });
 
           last_time_stamp_ = when;
         }
@@ -702,7 +655,7 @@ public:
     queue& queue_;
     std::vector<std::pair<device_id, mouse_key>> entries_;
     std::weak_ptr<event_queue> output_event_queue_;
-    boost::optional<manipulator_timer::timer_id> manipulator_timer_id_;
+    manipulator_timer::client manipulator_timer_client_;
     uint64_t last_time_stamp_;
     boost::optional<mouse_key> last_mouse_key_total_;
     count_converter x_count_converter_;
@@ -1055,16 +1008,20 @@ public:
                                      output_event_queue);
   }
 
-  virtual void manipulator_timer_invoked(manipulator_timer::timer_id timer_id) {
-    mouse_key_handler_.manipulator_timer_invoked(timer_id);
+  virtual std::shared_ptr<base> clone(void) const {
+    auto m = std::make_shared<post_event_to_virtual_devices>();
+    m->copy_conditions(*this);
+    return m;
   }
 
   virtual void set_valid(bool value) {
     // This manipulator is always valid.
   }
 
-  void post_events(virtual_hid_device_client& virtual_hid_device_client) {
-    queue_.post_events(virtual_hid_device_client);
+  void post_events(virtual_hid_device_client& virtual_hid_device_client,
+                   console_user_server_client& console_user_server_client) {
+    queue_.post_events(virtual_hid_device_client,
+                       console_user_server_client);
   }
 
   const queue& get_queue(void) const {
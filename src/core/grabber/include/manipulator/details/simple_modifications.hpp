@@ -0,0 +1,391 @@
+#pragma once
+
+#include "manipulator/details/base.hpp"
+#include "manipulator/details/basic.hpp"
+#include "manipulator/details/conditions/device.hpp"
+#include "manipulator/details/types.hpp"
+#include <vector>
+
+namespace krbn {
+namespace manipulator {
+namespace details {
+// simple_modifications applies many `from -> to` pairs (simple_modifications and fn_function_keys in core_configuration) in one manipulator.
+//
+// Pairs are compiled into a table indexed by key_code, consumer_key_code and pointing_button,
+// so `manipulate` costs a table lookup instead of calling a `basic` manipulator per pair.
+//
+// Each pair can have a device condition (device_if).
+// The device conditions are resolved for each device_id at the first event of the device,
+// and the table which contains only pairs for the device is used after that.
+//
+// Pairs are tested in the order of `push_back_pair` (the first pair wins) as well as manipulators in manipulator_manager.
+// Events are sent by `basic` manipulators of pairs, so the output is the same as `basic` manipulators.
+
+class simple_modifications final : public base {
+public:
+  class manipulated_original_event final {
+  public:
+    manipulated_original_event(device_id device_id,
+                               const event_queue::queued_event::event& original_event,
+                               size_t pair_index) : device_id_(device_id),
+                                                    original_event_(original_event),
+                                                    pair_index_(pair_index) {
+    }
+
+    device_id get_device_id(void) const {
+      return device_id_;
+    }
+
+    const event_queue::queued_event::event& get_original_event(void) const {
+      return original_event_;
+    }
+
+    size_t get_pair_index(void) const {
+      return pair_index_;
+    }
+
+  private:
+    device_id device_id_;
+    event_queue::queued_event::event original_event_;
+    size_t pair_index_;
+  };
+
+  simple_modifications(void) : base() {
+  }
+
+  simple_modifications(const simple_modifications& other) : base() {
+    // Copy the definition only. (The state such as manipulated_original_events_ is not copied.)
+
+    for (const auto& p : other.pairs_) {
+      push_back_pair(p.manipulator->get_from(),
+                     p.manipulator->get_to().front(),
+                     p.device_condition);
+    }
+
+    copy_conditions(other);
+  }
+
+  virtual ~simple_modifications(void) {
+  }
+
+  void push_back_pair(const from_event_definition& from,
+                      const to_event_definition& to,
+                      const std::shared_ptr<conditions::device>& device_condition = nullptr) {
+    if (get_table_indices(from).empty()) {
+      logger::get_logger().error("simple_modifications: unsupported `from` event");
+      return;
+    }
+
+    pairs_.push_back({std::make_shared<basic>(from, to), device_condition});
+
+    if (device_condition &&
+        std::find(std::begin(device_conditions_),
+                  std::end(device_conditions_),
+                  device_condition) == std::end(device_conditions_)) {
+      device_conditions_.push_back(device_condition);
+    }
+
+    // Rebuild tables at the next event.
+    tables_.clear();
+    table_indices_by_device_id_.clear();
+  }
+
+  size_t get_pairs_size(void) const {
+    return pairs_.size();
+  }
+
+  virtual void manipulate(event_queue::queued_event& front_input_event,
+                          const event_queue& input_event_queue,
+                          const std::shared_ptr<event_queue>& output_event_queue) {
+    if (!output_event_queue ||
+        !front_input_event.get_valid()) {
+      return;
+    }
+
+    auto index = make_table_index(front_input_event.get_event());
+    if (!index) {
+      return;
+    }
+
+    switch (front_input_event.get_event_type()) {
+      case event_type::key_down:
+      case event_type::single: {
+        if (!valid_) {
+          return;
+        }
+
+        auto& table = find_table(front_input_event.get_device_id());
+        if (*index >= table.pair_indices.size() ||
+            table.pair_indices[*index].empty()) {
+          return;
+        }
+
+        if (!condition_manager_.is_fulfilled(front_input_event,
+                                             output_event_queue->get_manipulator_environment())) {
+          return;
+        }
+
+        for (const auto& i : table.pair_indices[*index]) {
+          pairs_[i].manipulator->manipulate(front_input_event,
+                                            input_event_queue,
+                                            output_event_queue);
+
+          // The pair is applied if the event is consumed. (The pair is not applied if modifiers are not matched.)
+          if (!front_input_event.get_valid()) {
+            if (front_input_event.get_event_type() == event_type::key_down) {
+              manipulated_original_events_.emplace_back(front_input_event.get_device_id(),
+                                                        front_input_event.get_original_event(),
+                                                        i);
+            }
+            break;
+          }
+        }
+        break;
+      }
+
+      case event_type::key_up: {
+        // Send key_up by the pair which manipulated the key_down.
+
+        auto it = std::find_if(std::begin(manipulated_original_events_),
+                               std::end(manipulated_original_events_),
+                               [&](const auto& manipulated_original_event) {
+                                 return manipulated_original_event.get_device_id() == front_input_event.get_device_id() &&
+                                        manipulated_original_event.get_original_event() == front_input_event.get_original_event();
+                               });
+        if (it != std::end(manipulated_original_events_)) {
+          auto pair_index = it->get_pair_index();
+          manipulated_original_events_.erase(it);
+
+          pairs_[pair_index].manipulator->manipulate(front_input_event,
+                                                     input_event_queue,
+                                                     output_event_queue);
+        }
+        break;
+      }
+    }
+  }
+
+  virtual bool active(void) const {
+    return !manipulated_original_events_.empty();
+  }
+
+  virtual bool needs_virtual_hid_pointing(void) const {
+    for (const auto& p : pairs_) {
+      if (p.manipulator->needs_virtual_hid_pointing()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  virtual void handle_device_keys_and_pointing_buttons_are_released_event(const event_queue::queued_event& front_input_event,
+                                                                          event_queue& output_event_queue) {
+  }
+
+  virtual void handle_device_ungrabbed_event(device_id device_id,
+                                             const event_queue& output_event_queue,
+                                             uint64_t time_stamp) {
+    for (const auto& e : manipulated_original_events_) {
+      if (e.get_device_id() == device_id) {
+        pairs_[e.get_pair_index()].manipulator->handle_device_ungrabbed_event(device_id,
+                                                                              output_event_queue,
+                                                                              time_stamp);
+      }
+    }
+
+    manipulated_original_events_.erase(std::remove_if(std::begin(manipulated_original_events_),
+                                                      std::end(manipulated_original_events_),
+                                                      [&](const auto& e) {
+                                                        return e.get_device_id() == device_id;
+                                                      }),
+                                       std::end(manipulated_original_events_));
+  }
+
+  virtual void handle_event_from_ignored_device(const event_queue::queued_event& front_input_event,
+                                                event_queue& output_event_queue) {
+  }
+
+  virtual void handle_pointing_device_event_from_event_tap(const event_queue::queued_event& front_input_event,
+                                                           event_queue& output_event_queue) {
+  }
+
+  virtual std::shared_ptr<base> clone(void) const {
+    return std::make_shared<simple_modifications>(*this);
+  }
+
+private:
+  struct pair_entry final {
+    std::shared_ptr<basic> manipulator;
+    // nullptr if the pair is applied to all devices.
+    std::shared_ptr<conditions::device> device_condition;
+  };
+
+  struct table final {
+    // Results of device_conditions_
+    std::vector<bool> device_condition_results;
+    // table index -> indices of pairs_
+    std::vector<std::vector<size_t>> pair_indices;
+  };
+
+  // Table indices:
+  //   0x000 - 0x0ff: key_code (keyboard_or_keypad usage page)
+  //   0x100 - 0x1ff: key_code (karabiner own virtual key codes. 0x10000 - 0x100ff)
+  //   0x200 - 0x5ff: consumer_key_code
+  //   0x600 - 0x6ff: pointing_button
+  static boost::optional<size_t> make_table_index(key_code key_code) {
+    auto value = static_cast<size_t>(key_code);
+    if (value < 0x100) {
+      return value;
+    }
+    auto extra = static_cast<size_t>(key_code::extra_);
+    if (extra <= value && value < extra + 0x100) {
+      return 0x100 + (value - extra);
+    }
+    return boost::none;
+  }
+
+  static boost::optional<size_t> make_table_index(consumer_key_code consumer_key_code) {
+    auto value = static_cast<size_t>(consumer_key_code);
+    if (value < 0x400) {
+      return 0x200 + value;
+    }
+    return boost::none;
+  }
+
+  static boost::optional<size_t> make_table_index(pointing_button pointing_button) {
+    auto value = static_cast<size_t>(pointing_button);
+    if (value < 0x100) {
+      return 0x600 + value;
+    }
+    return boost::none;
+  }
+
+  static boost::optional<size_t> make_table_index(const event_queue::queued_event::event& event) {
+    if (auto key_code = event.get_key_code()) {
+      return make_table_index(*key_code);
+    }
+    if (auto consumer_key_code = event.get_consumer_key_code()) {
+      return make_table_index(*consumer_key_code);
+    }
+    if (auto pointing_button = event.get_pointing_button()) {
+      return make_table_index(*pointing_button);
+    }
+    return boost::none;
+  }
+
+  // Returns table indices which are matched with `from`. (`from` might be `any`.)
+  static std::vector<size_t> get_table_indices(const from_event_definition& from) {
+    std::vector<size_t> indices;
+
+    boost::optional<size_t> index;
+    if (auto key_code = from.get_key_code()) {
+      index = make_table_index(*key_code);
+    }
+    if (auto consumer_key_code = from.get_consumer_key_code()) {
+      index = make_table_index(*consumer_key_code);
+    }
+    if (auto pointing_button = from.get_pointing_button()) {
+      index = make_table_index(*pointing_button);
+    }
+    if (index) {
+      indices.push_back(*index);
+    }
+
+    if (auto any_type = from.get_any_type()) {
+      std::pair<size_t, size_t> range(0, 0);
+      switch (*any_type) {
+        case event_definition::type::key_code:
+          range = std::make_pair(0x000, 0x200);
+          break;
+        case event_definition::type::consumer_key_code:
+          range = std::make_pair(0x200, 0x600);
+          break;
+        case event_definition::type::pointing_button:
+          range = std::make_pair(0x600, 0x700);
+          break;
+        default:
+          break;
+      }
+      for (auto i = range.first; i < range.second; ++i) {
+        indices.push_back(i);
+      }
+    }
+
+    return indices;
+  }
+
+  const table& find_table(device_id device_id) {
+    auto index = static_cast<size_t>(device_id);
+    if (index < table_indices_by_device_id_.size() && table_indices_by_device_id_[index]) {
+      return tables_[*(table_indices_by_device_id_[index])];
+    }
+
+    std::vector<bool> device_condition_results;
+    for (const auto& c : device_conditions_) {
+      device_condition_results.push_back(c->is_fulfilled(device_id));
+    }
+
+    // Devices which match the same device conditions share one table.
+
+    auto it = std::find_if(std::begin(tables_),
+                           std::end(tables_),
+                           [&](const auto& t) {
+                             return t.device_condition_results == device_condition_results;
+                           });
+    if (it == std::end(tables_)) {
+      tables_.push_back(make_table(device_condition_results));
+      it = std::end(tables_) - 1;
+    }
+
+    auto table_index = static_cast<size_t>(std::distance(std::begin(tables_), it));
+
+    // Do not cache the table index of unknown devices since the device might not be registered yet.
+    if (types::find_device_detail(device_id)) {
+      if (index >= table_indices_by_device_id_.size()) {
+        table_indices_by_device_id_.resize(index + 1);
+      }
+      table_indices_by_device_id_[index] = table_index;
+    }
+
+    return tables_[table_index];
+  }
+
+  table make_table(const std::vector<bool>& device_condition_results) const {
+    table t;
+    t.device_condition_results = device_condition_results;
+
+    for (size_t i = 0; i < pairs_.size(); ++i) {
+      const auto& p = pairs_[i];
+
+      if (p.device_condition) {
+        auto it = std::find(std::begin(device_conditions_),
+                            std::end(device_conditions_),
+                            p.device_condition);
+        if (!device_condition_results[std::distance(std::begin(device_conditions_), it)]) {
+          continue;
+        }
+      }
+
+      for (const auto& index : get_table_indices(p.manipulator->get_from())) {
+        if (index >= t.pair_indices.size()) {
+          t.pair_indices.resize(index + 1);
+        }
+        t.pair_indices[index].push_back(i);
+      }
+    }
+
+    return t;
+  }
+
+  std::vector<pair_entry> pairs_;
+  std::vector<std::shared_ptr<conditions::device>> device_conditions_;
+
+  std::vector<table> tables_;
+  // device_id -> index of tables_ (boost::none: not resolved yet)
+  std::vector<boost::optional<size_t>> table_indices_by_device_id_;
+
+  std::vector<manipulated_original_event> manipulated_original_events_;
+};
+} // namespace details
+} // namespace manipulator
+} // namespace krbn
@@ -96,9 +96,9 @@ public:
     return boost::none;
   }
 
-  boost::optional<std::pair<std::string, int>> get_set_variable(void) const {
+  boost::optional<std::pair<variable_id, int>> get_set_variable(void) const {
     if (type_ == type::set_variable) {
-      return boost::get<std::pair<std::string, int>>(value_);
+      return boost::get<std::pair<variable_id, int>>(value_);
     }
     return boost::none;
   }
@@ -110,27 +110,13 @@ public:
     return boost::none;
   }
 
+  // The event is made at the first call and reused since making payload events (shell_command, mouse_key, etc.)
+  // requires a `payload_table` lookup.
   boost::optional<event_queue::queued_event::event> to_event(void) const {
-    switch (type_) {
-      case type::none:
-        return boost::none;
-      case type::key_code:
-        return event_queue::queued_event::event(boost::get<key_code>(value_));
-      case type::consumer_key_code:
-        return event_queue::queued_event::event(boost::get<consumer_key_code>(value_));
-      case type::pointing_button:
-        return event_queue::queued_event::event(boost::get<pointing_button>(value_));
-      case type::any:
-        return boost::none;
-      case type::shell_command:
-        return event_queue::queued_event::event::make_shell_command_event(boost::get<std::string>(value_));
-      case type::select_input_source:
-        return event_queue::queued_event::event::make_select_input_source_event(boost::get<std::vector<input_source_selector>>(value_));
-      case type::set_variable:
-        return event_queue::queued_event::event::make_set_variable_event(boost::get<std::pair<std::string, int>>(value_));
-      case type::mouse_key:
-        return event_queue::queued_event::event::make_mouse_key_event(boost::get<mouse_key>(value_));
+    if (!event_) {
+      event_ = make_event();
     }
+    return event_;
   }
 
   static std::unordered_set<modifier> make_modifiers(const nlohmann::json& json) {
@@ -356,6 +342,29 @@ protected:
     }
   }
 
+  boost::optional<event_queue::queued_event::event> make_event(void) const {
+    switch (type_) {
+      case type::none:
+        return boost::none;
+      case type::key_code:
+        return event_queue::queued_event::event(boost::get<key_code>(value_));
+      case type::consumer_key_code:
+        return event_queue::queued_event::event(boost::get<consumer_key_code>(value_));
+      case type::pointing_button:
+        return event_queue::queued_event::event(boost::get<pointing_button>(value_));
+      case type::any:
+        return boost::none;
+      case type::shell_command:
+        return event_queue::queued_event::event::make_shell_command_event(boost::get<std::string>(value_));
+      case type::select_input_source:
+        return event_queue::queued_event::event::make_select_input_source_event(boost::get<std::vector<input_source_selector>>(value_));
+      case type::set_variable:
+        return event_queue::queued_event::event::make_set_variable_event(boost::get<std::pair<variable_id, int>>(value_));
+      case type::mouse_key:
+        return event_queue::queued_event::event::make_mouse_key_event(boost::get<mouse_key>(value_));
+    }
+  }
+
   type type_;
   boost::variant<key_code,
                  consumer_key_code,
@@ -363,10 +372,12 @@ protected:
                  type, // For any
                  std::string, // For shell_command
                  std::vector<input_source_selector>, // For select_input_source
-                 std::pair<std::string, int>, // For set_variable
+                 std::pair<variable_id, int>, // For set_variable
                  mouse_key // For mouse_key
                  >
       value_;
+  // The cache of `to_event`.
+  mutable boost::optional<event_queue::queued_event::event> event_;
 }; // namespace details
 
 class from_event_definition final : public event_definition {
@@ -376,6 +387,8 @@ public:
                 [&](const std::string& key, const nlohmann::json& value, const nlohmann::json& json) {
                   return extra_json_handler(key, value, json);
                 });
+
+    compile_modifiers();
   }
 
   from_event_definition(key_code key_code,
@@ -383,6 +396,7 @@ public:
                         const std::unordered_set<modifier>& optional_modifiers) : event_definition(key_code),
                                                                                   mandatory_modifiers_(mandatory_modifiers),
                                                                                   optional_modifiers_(optional_modifiers) {
+    compile_modifiers();
   }
 
   virtual ~from_event_definition(void) {
@@ -396,61 +410,32 @@ public:
     return optional_modifiers_;
   }
 
-  boost::optional<std::unordered_set<modifier_flag>> test_modifiers(const modifier_flag_manager& modifier_flag_manager) const {
-    std::unordered_set<modifier_flag> modifier_flags;
+  boost::optional<modifier_flag_mask> test_modifiers(const modifier_flag_manager& modifier_flag_manager) const {
+    const auto& pressed_modifier_flags = modifier_flag_manager.get_pressed_modifier_flags();
 
     // If mandatory_modifiers_ contains modifier::any, return all active modifier_flags.
 
-    if (mandatory_modifiers_.find(modifier::any) != std::end(mandatory_modifiers_)) {
-      for (auto i = static_cast<uint32_t>(modifier_flag::zero) + 1; i != static_cast<uint32_t>(modifier_flag::end_); ++i) {
-        auto flag = modifier_flag(i);
-        if (modifier_flag_manager.is_pressed(flag)) {
-          modifier_flags.insert(flag);
-        }
-      }
-      return modifier_flags;
+    if (mandatory_modifiers_contain_any_) {
+      return pressed_modifier_flags & modifier_flag_mask::all();
     }
 
     // Check modifier_flag state.
 
-    for (int i = 0; i < static_cast<int>(modifier::end_); ++i) {
-      auto m = modifier(i);
+    modifier_flag_mask modifier_flags;
 
-      if (mandatory_modifiers_.find(m) != std::end(mandatory_modifiers_)) {
-        auto pair = test_modifier(modifier_flag_manager, m);
-        if (!pair.first) {
-          return boost::none;
-        }
-        if (pair.second != modifier_flag::zero) {
-          modifier_flags.insert(pair.second);
-        }
+    for (const auto& mask : mandatory_modifier_masks_) {
+      auto pressed = pressed_modifier_flags & mask;
+      if (pressed.empty()) {
+        return boost::none;
       }
+      // Use the first pressed modifier_flag (e.g., left_shift if both shift keys are pressed) as `test_modifier` does.
+      modifier_flags.insert(*std::begin(pressed));
     }
 
     // If optional_modifiers_ does not contain modifier::any, we have to check modifier flags strictly.
 
-    if (optional_modifiers_.find(modifier::any) == std::end(optional_modifiers_)) {
-      std::unordered_set<modifier_flag> extra_modifier_flags;
-      for (auto m = static_cast<uint32_t>(modifier_flag::zero) + 1; m != static_cast<uint32_t>(modifier_flag::end_); ++m) {
-        extra_modifier_flags.insert(modifier_flag(m));
-      }
-
-      for (int i = 0; i < static_cast<int>(modifier::end_); ++i) {
-        auto m = modifier(i);
-
-        if (mandatory_modifiers_.find(m) != std::end(mandatory_modifiers_) ||
-            optional_modifiers_.find(m) != std::end(optional_modifiers_)) {
-          for (const auto& flag : get_modifier_flags(m)) {
-            extra_modifier_flags.erase(flag);
-          }
-        }
-      }
-
-      for (const auto& flag : extra_modifier_flags) {
-        if (modifier_flag_manager.is_pressed(flag)) {
-          return boost::none;
-        }
-      }
+    if (!(pressed_modifier_flags & extra_modifier_flags_).empty()) {
+      return boost::none;
     }
 
     return modifier_flags;
@@ -528,8 +513,45 @@ private:
     return false;
   }
 
+  // Convert modifiers into modifier_flag_mask in order to avoid hash set lookups in `test_modifiers`.
+  void compile_modifiers(void) {
+    mandatory_modifiers_contain_any_ = (mandatory_modifiers_.find(modifier::any) != std::end(mandatory_modifiers_));
+    mandatory_modifier_masks_.clear();
+    extra_modifier_flags_ = modifier_flag_mask::all();
+
+    for (int i = 0; i < static_cast<int>(modifier::end_); ++i) {
+      auto m = modifier(i);
+
+      if (mandatory_modifiers_.find(m) != std::end(mandatory_modifiers_)) {
+        if (m != modifier::any) {
+          modifier_flag_mask mask;
+          for (const auto& flag : get_modifier_flags(m)) {
+            mask.insert(flag);
+          }
+          mandatory_modifier_masks_.push_back(mask);
+        }
+      }
+
+      if (mandatory_modifiers_.find(m) != std::end(mandatory_modifiers_) ||
+          optional_modifiers_.find(m) != std::end(optional_modifiers_)) {
+        for (const auto& flag : get_modifier_flags(m)) {
+          extra_modifier_flags_.erase(flag);
+        }
+      }
+    }
+
+    if (optional_modifiers_.find(modifier::any) != std::end(optional_modifiers_)) {
+      extra_modifier_flags_ = modifier_flag_mask();
+    }
+  }
+
   std::unordered_set<modifier> mandatory_modifiers_;
   std::unordered_set<modifier> optional_modifiers_;
+
+  // Precompiled masks of modifiers (See `compile_modifiers`.)
+  bool mandatory_modifiers_contain_any_;
+  std::vector<modifier_flag_mask> mandatory_modifier_masks_;
+  modifier_flag_mask extra_modifier_flags_;
 };
 
 class to_event_definition final : public event_definition {
@@ -632,7 +654,7 @@ private:
       if (auto n = json_utility::find_optional<std::string>(value, "name")) {
         if (auto v = json_utility::find_optional<int>(value, "value")) {
           type_ = type::set_variable;
-          value_ = std::make_pair(*n, *v);
+          value_ = std::make_pair(variable_name_table::get_instance().intern(*n), *v);
         } else {
           logger::get_logger().error("complex_modifications json error: valid `value` is not found in set_variable: {0}", json.dump());
         }
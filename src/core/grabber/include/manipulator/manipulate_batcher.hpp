@@ -0,0 +1,108 @@
+#pragma once
+
+#include "event_queue.hpp"
+#include "scheduler.hpp"
+#include "time_utility.hpp"
+#include <functional>
+
+namespace krbn {
+namespace manipulator {
+// manipulate_batcher coalesces `input_event_arrived` notifications into batched `manipulate` calls.
+//
+// An isolated input event is processed immediately.
+// While input events arrive in a burst (e.g., a 1000Hz pointing stream),
+// events which arrive before the next main queue turn are processed as one batch.
+// The batch is processed immediately if its oldest event has waited too long or the batch is large enough.
+//
+// Call `flush` before the destination of `manipulate` (virtual_hid_device_client) is closed
+// in order to post pending events (e.g., key_up events of device_ungrabbed).
+
+class manipulate_batcher final {
+public:
+  manipulate_batcher(const manipulate_batcher&) = delete;
+
+  manipulate_batcher(const std::shared_ptr<event_queue>& input_event_queue,
+                     const std::function<void(void)>& manipulate) : input_event_queue_(input_event_queue),
+                                                                    manipulate_(manipulate) {
+  }
+
+  void request(void) {
+    auto now = scheduler::get_instance().now();
+    bool burst = last_request_time_stamp_ && now < *last_request_time_stamp_ + get_max_batch_latency();
+    last_request_time_stamp_ = now;
+
+    if (timer_ && timer_->fired()) {
+      timer_ = nullptr;
+    }
+
+    if (needs_flush(now)) {
+      flush();
+      return;
+    }
+
+    if (timer_) {
+      // The event is appended to the pending batch.
+      return;
+    }
+
+    if (!burst) {
+      if (manipulate_) {
+        manipulate_();
+      }
+      return;
+    }
+
+    timer_ = scheduler::get_instance().make_timer(now,
+                                                  [this] {
+                                                    if (manipulate_) {
+                                                      manipulate_();
+                                                    }
+                                                  });
+  }
+
+  // Process the pending batch immediately.
+  void flush(void) {
+    bool pending = timer_ && !timer_->fired();
+    timer_ = nullptr;
+
+    if (auto ieq = input_event_queue_.lock()) {
+      if (!ieq->empty()) {
+        pending = true;
+      }
+    }
+
+    if (pending && manipulate_) {
+      manipulate_();
+    }
+  }
+
+  bool pending(void) const {
+    return timer_ && !timer_->fired();
+  }
+
+  static size_t get_max_batch_size(void) {
+    return 256;
+  }
+
+  static uint64_t get_max_batch_latency(void) {
+    return time_utility::nano_to_absolute(2 * NSEC_PER_MSEC);
+  }
+
+private:
+  bool needs_flush(uint64_t now) const {
+    if (auto ieq = input_event_queue_.lock()) {
+      if (!ieq->empty()) {
+        return ieq->get_events().size() >= get_max_batch_size() ||
+               ieq->get_front_event().get_time_stamp() + get_max_batch_latency() <= now;
+      }
+    }
+    return false;
+  }
+
+  std::weak_ptr<event_queue> input_event_queue_;
+  std::function<void(void)> manipulate_;
+  std::unique_ptr<scheduler::timer> timer_;
+  boost::optional<uint64_t> last_request_time_stamp_;
+};
+} // namespace manipulator
+} // namespace krbn
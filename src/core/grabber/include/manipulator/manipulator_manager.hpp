@@ -1,6 +1,7 @@
 #pragma once
 
 #include "manipulator/manipulator_factory.hpp"
+#include <unordered_map>
 
 namespace krbn {
 namespace manipulator {
@@ -9,24 +10,16 @@ public:
   manipulator_manager(const manipulator_manager&) = delete;
 
   manipulator_manager(void) {
-    manipulator_timer_connection_ = manipulator_timer::get_instance().timer_invoked.connect([&](auto timer_id) {
-      for (auto&& m : manipulators_) {
-        m->manipulator_timer_invoked(timer_id);
-      }
-    });
-  }
-
-  ~manipulator_manager(void) {
-    manipulator_timer_connection_.disconnect();
   }
 
   void push_back_manipulator(const nlohmann::json& json,
                              const core_configuration::profile::complex_modifications::parameters& parameters) {
-    manipulators_.push_back(manipulator_factory::make_manipulator(json, parameters));
+    push_back_manipulator(manipulator_factory::make_manipulator(json, parameters));
   }
 
   void push_back_manipulator(std::shared_ptr<details::base> ptr) {
     manipulators_.push_back(ptr);
+    add_to_manipulator_index(manipulators_.size() - 1);
   }
 
   void manipulate(const std::shared_ptr<event_queue>& input_event_queue,
@@ -92,10 +85,10 @@ public:
           case event_queue::queued_event::event::type::shell_command:
           case event_queue::queued_event::event::type::select_input_source:
           case event_queue::queued_event::event::type::mouse_key:
-            for (auto&& m : manipulators_) {
-              m->manipulate(front_input_event,
-                            *input_event_queue,
-                            output_event_queue);
+            for (const auto& i : find_manipulator_indices(front_input_event.get_event())) {
+              manipulators_[i]->manipulate(front_input_event,
+                                           *input_event_queue,
+                                           output_event_queue);
             }
             break;
         }
@@ -119,7 +112,7 @@ public:
     remove_invalid_manipulators();
   }
 
-  size_t get_manipulators_size(void) {
+  size_t get_manipulators_size(void) const {
     return manipulators_.size();
   }
 
@@ -134,6 +127,8 @@ public:
 
 private:
   void remove_invalid_manipulators(void) {
+    auto size = manipulators_.size();
+
     manipulators_.erase(std::remove_if(std::begin(manipulators_),
                                        std::end(manipulators_),
                                        [](const auto& it) {
@@ -141,10 +136,72 @@ private:
                                          return !it->get_valid() && !it->active();
                                        }),
                         std::end(manipulators_));
+
+    if (manipulators_.size() != size) {
+      rebuild_manipulator_index();
+    }
+  }
+
+  // manipulator_index_ maps an event (key_code, consumer_key_code or pointing_button) to indices of manipulators_
+  // which have to be called with the event.
+  // Each entry includes indices in all_events_manipulator_indices_ and keeps the order of manipulators_.
+
+  static boost::optional<uint64_t> make_manipulator_index_key(const event_queue::queued_event::event& event) {
+    if (auto key_code = event.get_key_code()) {
+      return (static_cast<uint64_t>(event_queue::queued_event::event::type::key_code) << 32) | static_cast<uint32_t>(*key_code);
+    }
+    if (auto consumer_key_code = event.get_consumer_key_code()) {
+      return (static_cast<uint64_t>(event_queue::queued_event::event::type::consumer_key_code) << 32) | static_cast<uint32_t>(*consumer_key_code);
+    }
+    if (auto pointing_button = event.get_pointing_button()) {
+      return (static_cast<uint64_t>(event_queue::queued_event::event::type::pointing_button) << 32) | static_cast<uint32_t>(*pointing_button);
+    }
+    return boost::none;
+  }
+
+  void add_to_manipulator_index(size_t index) {
+    boost::optional<uint64_t> key;
+    if (auto e = manipulators_[index]->get_manipulate_target_event()) {
+      key = make_manipulator_index_key(*e);
+    }
+
+    if (key) {
+      auto it = manipulator_index_.find(*key);
+      if (it == std::end(manipulator_index_)) {
+        it = manipulator_index_.emplace(*key, all_events_manipulator_indices_).first;
+      }
+      it->second.push_back(index);
+
+    } else {
+      all_events_manipulator_indices_.push_back(index);
+      for (auto&& pair : manipulator_index_) {
+        pair.second.push_back(index);
+      }
+    }
+  }
+
+  void rebuild_manipulator_index(void) {
+    manipulator_index_.clear();
+    all_events_manipulator_indices_.clear();
+
+    for (size_t i = 0; i < manipulators_.size(); ++i) {
+      add_to_manipulator_index(i);
+    }
+  }
+
+  const std::vector<size_t>& find_manipulator_indices(const event_queue::queued_event::event& event) const {
+    if (auto key = make_manipulator_index_key(event)) {
+      auto it = manipulator_index_.find(*key);
+      if (it != std::end(manipulator_index_)) {
+        return it->second;
+      }
+    }
+    return all_events_manipulator_indices_;
   }
 
   std::vector<std::shared_ptr<details::base>> manipulators_;
-  boost::signals2::connection manipulator_timer_connection_;
+  std::unordered_map<uint64_t, std::vector<size_t>> manipulator_index_;
+  std::vector<size_t> all_events_manipulator_indices_;
 };
 } // namespace manipulator
 } // namespace krbn
@@ -17,9 +17,53 @@ public:
                                                                          output_event_queue_(output_event_queue) {
     }
 
-    void manipulate(void) {
-      manipulator_manager_.manipulate(input_event_queue_.lock(),
-                                      output_event_queue_.lock());
+    // `spliced_input_event_queue` is the input event queue of the previous connection if the previous connection is bypassed.
+    // Returns the input event queue if this connection is bypassed. (The next connection reads events from it.)
+    std::shared_ptr<event_queue> manipulate(const std::shared_ptr<event_queue>& spliced_input_event_queue,
+                                            bool bypassable) {
+      auto ieq = spliced_input_event_queue ? spliced_input_event_queue : input_event_queue_.lock();
+      auto oeq = output_event_queue_.lock();
+      if (!ieq || !oeq) {
+        return nullptr;
+      }
+
+      // Stages which have no manipulators pass events through as is.
+      // We do not copy events to the output event queue in that case.
+      // The next connection reads events from the input event queue directly.
+      //
+      // The output event queue must be empty in order to keep the order of events.
+
+      if (bypassable &&
+          manipulator_manager_.get_manipulators_size() == 0 &&
+          oeq->empty()) {
+        for (const auto& e : ieq->get_events()) {
+          // Keep the state of the output event queue (modifier flags, pointing buttons and manipulator_environment)
+          // as well as `manipulator_manager::manipulate` since manipulators might be added later.
+          switch (e.get_event().get_type()) {
+            case event_queue::queued_event::event::type::device_keys_and_pointing_buttons_are_released:
+              oeq->erase_all_active_modifier_flags_except_lock(e.get_device_id());
+              oeq->erase_all_active_pointing_buttons_except_lock(e.get_device_id());
+              break;
+
+            case event_queue::queued_event::event::type::device_ungrabbed:
+              oeq->erase_all_active_modifier_flags(e.get_device_id());
+              oeq->erase_all_active_pointing_buttons(e.get_device_id());
+              break;
+
+            default:
+              break;
+          }
+
+          if (e.get_valid()) {
+            oeq->pass_through_event(e);
+          }
+        }
+
+        return ieq;
+      }
+
+      manipulator_manager_.manipulate(ieq, oeq);
+      return nullptr;
     }
 
     void invalidate_manipulators(void) {
@@ -71,8 +115,12 @@ public:
   }
 
   void manipulate(void) {
-    for (auto&& c : connections_) {
-      c.manipulate();
+    std::shared_ptr<event_queue> spliced_input_event_queue;
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      // The last connection is never bypassed in order to move events to the last output event queue.
+      bool bypassable = (i + 1 < connections_.size());
+      spliced_input_event_queue = connections_[i].manipulate(spliced_input_event_queue,
+                                                             bypassable);
     }
   }
 
@@ -2,10 +2,13 @@
 
 #include "boost_defs.hpp"
 
-#include "gcd_utility.hpp"
-#include <boost/signals2.hpp>
-#include <deque>
-#include <mach/mach_time.h>
+#include "scheduler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <boost/optional.hpp>
+#include <functional>
+#include <unordered_map>
+#include <vector>
 
 namespace krbn {
 namespace manipulator {
@@ -15,15 +18,18 @@ public:
     zero = 0,
   };
 
+  struct timer_id_hash final {
+    std::size_t operator()(timer_id value) const {
+      return std::hash<uint64_t>()(static_cast<uint64_t>(value));
+    }
+  };
+
   class entry final {
   public:
     entry(uint64_t when) : when_(when) {
-      static std::mutex mutex;
-      std::lock_guard<std::mutex> guard(mutex);
+      static std::atomic<uint64_t> last_id(0);
 
-      static timer_id id;
-      id = timer_id(static_cast<uint64_t>(id) + 1);
-      timer_id_ = id;
+      timer_id_ = timer_id(++last_id);
     }
 
     timer_id get_timer_id(void) const {
@@ -34,7 +40,7 @@ public:
       return when_;
     }
 
-    bool compare(const entry& other) {
+    bool compare(const entry& other) const {
       if (when_ != other.when_) {
         return when_ < other.when_;
       } else {
@@ -49,14 +55,27 @@ public:
 
   class core final {
   public:
-    boost::signals2::signal<void(timer_id)> timer_invoked;
-
     core(void) : enabled_(false) {
     }
 
     // For unit testing
-    const std::deque<entry>& get_entries(void) const {
-      return entries_;
+    std::vector<entry> get_entries(void) const {
+      std::lock_guard<std::mutex> guard(mutex_);
+
+      std::vector<entry> entries;
+      for (const auto& e : entries_) {
+        if (functions_.find(e.get_timer_id()) != std::end(functions_)) {
+          entries.push_back(e);
+        }
+      }
+
+      std::sort(std::begin(entries),
+                std::end(entries),
+                [](auto& a, auto& b) {
+                  return a.compare(b);
+                });
+
+      return entries;
     }
 
     void enable(void) {
@@ -71,83 +90,161 @@ public:
       enabled_ = false;
     }
 
-    timer_id add_entry(uint64_t when) {
+    // `function` is called in `signal` when the entry is expired.
+    timer_id add_entry(uint64_t when, const std::function<void(void)>& function) {
       std::lock_guard<std::mutex> guard(mutex_);
 
       entries_.emplace_back(when);
       auto result = entries_.back().get_timer_id();
+      std::push_heap(std::begin(entries_), std::end(entries_), heap_compare);
 
-      std::sort(std::begin(entries_),
-                std::end(entries_),
-                [](auto& a, auto& b) {
-                  return a.compare(b);
-                });
+      functions_[result] = function;
 
       set_timer();
 
       return result;
     }
 
+    // The canceled timer is not invoked.
+    void cancel(timer_id timer_id) {
+      std::lock_guard<std::mutex> guard(mutex_);
+
+      functions_.erase(timer_id);
+
+      // Drop canceled entries if they occupy the heap.
+      if (entries_.size() > functions_.size() * 2 + 64) {
+        entries_.erase(std::remove_if(std::begin(entries_),
+                                      std::end(entries_),
+                                      [&](const auto& e) {
+                                        return functions_.find(e.get_timer_id()) == std::end(functions_);
+                                      }),
+                       std::end(entries_));
+        std::make_heap(std::begin(entries_), std::end(entries_), heap_compare);
+      }
+    }
+
     void signal(uint64_t now) {
       for (;;) {
-        boost::optional<timer_id> id;
+        std::function<void(void)> function;
 
         {
           std::lock_guard<std::mutex> guard(mutex_);
 
-          if (!entries_.empty() && entries_.front().get_when() <= now) {
-            id = entries_.front().get_timer_id();
-            entries_.pop_front();
+          while (!entries_.empty() && entries_.front().get_when() <= now) {
+            auto front_id = entries_.front().get_timer_id();
+            std::pop_heap(std::begin(entries_), std::end(entries_), heap_compare);
+            entries_.pop_back();
+
+            auto it = functions_.find(front_id);
+            if (it != std::end(functions_)) {
+              function = std::move(it->second);
+              functions_.erase(it);
+              break;
+            }
           }
         }
 
-        if (id) {
-          timer_invoked(*id);
+        // Call the function without the lock since it might add entries.
+        if (function) {
+          function();
         } else {
           break;
         }
       }
 
-      set_timer();
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        // The current timer has been fired.
+        timer_when_ = boost::none;
+        set_timer();
+      }
     }
 
   private:
+    // Make `entries_` a min-heap.
+    static bool heap_compare(const entry& a, const entry& b) {
+      return b.compare(a);
+    }
+
+    // This method requires that mutex_ is locked.
     void set_timer(void) {
-      if (!enabled_) {
+      // Drop canceled entries at the top in order to avoid needless timer invocations.
+      while (!entries_.empty() &&
+             functions_.find(entries_.front().get_timer_id()) == std::end(functions_)) {
+        std::pop_heap(std::begin(entries_), std::end(entries_), heap_compare);
+        entries_.pop_back();
+      }
+
+      if (!enabled_ || entries_.empty()) {
         timer_ = nullptr;
+        timer_when_ = boost::none;
         return;
       }
 
-      if (entries_.empty()) {
-        timer_ = nullptr;
+      // Keep the current timer if the earliest entry is not changed.
+      auto when = entries_.front().get_when();
+      if (timer_ && timer_when_ == when) {
         return;
       }
 
-      timer_ = std::make_unique<gcd_utility::main_queue_after_timer>(entries_.front().get_when(),
-                                                                     true,
-                                                                     ^{
-                                                                       uint64_t now = mach_absolute_time();
-                                                                       signal(now);
-                                                                     });
+      timer_when_ = when;
+      timer_ = scheduler::get_instance().make_timer(when,
+                                                    [this] {
+                                                      signal(scheduler::get_instance().now());
+                                                    });
     }
 
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
     bool enabled_;
-    std::deque<entry> entries_;
-    std::unique_ptr<gcd_utility::main_queue_after_timer> timer_;
+    std::vector<entry> entries_;
+    std::unordered_map<timer_id, std::function<void(void)>, timer_id_hash> functions_;
+    std::unique_ptr<scheduler::timer> timer_;
+    boost::optional<uint64_t> timer_when_;
   };
 
   static core& get_instance(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
+    static core core_;
+    return core_;
+  }
+
+  // client holds one entry for the owner and cancels it when the owner is destroyed.
+  class client final {
+  public:
+    client(const client&) = delete;
 
-    static std::unique_ptr<core> core_;
-    if (!core_) {
-      core_ = std::make_unique<core>();
+    client(void) {
     }
 
-    return *core_;
-  }
+    ~client(void) {
+      cancel();
+    }
+
+    // Replace the current entry.
+    void set_entry(uint64_t when, const std::function<void(void)>& function) {
+      cancel();
+
+      timer_id_ = get_instance().add_entry(when,
+                                           [this, function] {
+                                             timer_id_ = boost::none;
+                                             function();
+                                           });
+    }
+
+    void cancel(void) {
+      if (timer_id_) {
+        get_instance().cancel(*timer_id_);
+        timer_id_ = boost::none;
+      }
+    }
+
+    bool active(void) const {
+      return timer_id_ != boost::none;
+    }
+
+  private:
+    boost::optional<timer_id> timer_id_;
+  };
 };
 } // namespace manipulator
 } // namespace krbn
@@ -1,8 +1,9 @@
 #pragma once
 
+#include "async_local_datagram_server.hpp"
 #include "constants.hpp"
 #include "device_grabber.hpp"
-#include "local_datagram_server.hpp"
+#include "operation_message.hpp"
 #include "process_monitor.hpp"
 #include "session.hpp"
 #include "types.hpp"
@@ -13,14 +14,16 @@ class receiver final {
 public:
   receiver(const receiver&) = delete;
 
-  receiver(device_grabber& device_grabber) : device_grabber_(device_grabber),
-                                             exit_loop_(false) {
+  receiver(device_grabber& device_grabber) : device_grabber_(device_grabber) {
     const size_t buffer_length = 32 * 1024;
-    buffer_.resize(buffer_length);
 
     const char* path = constants::get_grabber_socket_file_path();
     unlink(path);
-    server_ = std::make_unique<local_datagram_server>(path);
+    server_ = std::make_unique<async_local_datagram_server>(path,
+                                                            buffer_length,
+                                                            [this](const uint8_t* p, size_t length) {
+                                                              process_datagram(p, length);
+                                                            });
 
     if (auto uid = session::get_current_console_user_id()) {
       chown(path, *uid, 0);
@@ -28,19 +31,11 @@ public:
     chmod(path, 0600);
 
     start_grabbing_if_system_core_configuration_file_exists();
-
-    exit_loop_ = false;
-    thread_ = std::thread([this] { this->worker(); });
   }
 
   ~receiver(void) {
     unlink(constants::get_grabber_socket_file_path());
 
-    exit_loop_ = true;
-    if (thread_.joinable()) {
-      thread_.join();
-    }
-
     server_ = nullptr;
     console_user_server_process_monitor_ = nullptr;
     device_grabber_.stop_grabbing();
@@ -48,83 +43,81 @@ public:
   }
 
 private:
-  void worker(void) {
-    if (!server_) {
-      return;
+  // This method is called in the server thread.
+  void process_datagram(const uint8_t* p, size_t length) {
+    auto count = operation_message::parse(p,
+                                          length,
+                                          [this](operation_type operation_type, operation_message::reader& reader) {
+                                            process_message(operation_type, reader);
+                                          });
+    if (!count) {
+      logger::get_logger().error("receiver: invalid datagram ({0} bytes)", length);
     }
+  }
+
+  void process_message(operation_type operation_type, operation_message::reader& reader) {
+    switch (operation_type) {
+      case operation_type::connect: {
+        auto pid = reader.read_uint32();
+        auto user_core_configuration_file_path = reader.read_string();
+        if (!pid || !user_core_configuration_file_path) {
+          logger::get_logger().error("invalid payload for operation_type::connect");
+          break;
+        }
+
+        logger::get_logger().info("karabiner_console_user_server is connected (pid:{0})", *pid);
+
+        device_grabber_.start_grabbing(*user_core_configuration_file_path);
+
+        // monitor the last process
+        console_user_server_process_monitor_ = nullptr;
+        console_user_server_process_monitor_ = std::make_unique<process_monitor>(static_cast<pid_t>(*pid),
+                                                                                 std::bind(&receiver::console_user_server_exit_callback, this));
+        break;
+      }
 
-    while (!exit_loop_) {
-      boost::system::error_code ec;
-      std::size_t n = server_->receive(boost::asio::buffer(buffer_), boost::posix_time::seconds(1), ec);
-
-      if (!ec && n > 0) {
-        switch (operation_type(buffer_[0])) {
-          case operation_type::connect:
-            if (n != sizeof(operation_type_connect_struct)) {
-              logger::get_logger().error("invalid size for operation_type::connect");
-            } else {
-              auto p = reinterpret_cast<operation_type_connect_struct*>(&(buffer_[0]));
-
-              // Ensure user_core_configuration_file_path is null-terminated string even if corrupted data is sent.
-              p->user_core_configuration_file_path[sizeof(p->user_core_configuration_file_path) - 1] = '\0';
-
-              logger::get_logger().info("karabiner_console_user_server is connected (pid:{0})", p->pid);
-
-              device_grabber_.start_grabbing(p->user_core_configuration_file_path);
-
-              // monitor the last process
-              console_user_server_process_monitor_ = nullptr;
-              console_user_server_process_monitor_ = std::make_unique<process_monitor>(p->pid,
-                                                                                       std::bind(&receiver::console_user_server_exit_callback, this));
-            }
-            break;
-
-          case operation_type::system_preferences_values_updated:
-            if (n < sizeof(operation_type_system_preferences_values_updated_struct)) {
-              logger::get_logger().error("invalid size for operation_type::system_preferences_values_updated ({0})", n);
-            } else {
-              auto p = reinterpret_cast<operation_type_system_preferences_values_updated_struct*>(&(buffer_[0]));
-              device_grabber_.set_system_preferences_values(p->values);
-              logger::get_logger().info("system_preferences_values_updated");
-            }
-            break;
-
-          case operation_type::frontmost_application_changed:
-            if (n < sizeof(operation_type_frontmost_application_changed_struct)) {
-              logger::get_logger().error("invalid size for operation_type::frontmost_application_changed ({0})", n);
-            } else {
-              auto p = reinterpret_cast<operation_type_frontmost_application_changed_struct*>(&(buffer_[0]));
-
-              // Ensure bundle_identifier and file_path are null-terminated string even if corrupted data is sent.
-              p->bundle_identifier[sizeof(p->bundle_identifier) - 1] = '\0';
-              p->file_path[sizeof(p->file_path) - 1] = '\0';
-
-              device_grabber_.post_frontmost_application_changed_event(p->bundle_identifier,
-                                                                       p->file_path);
-            }
-            break;
-
-          case operation_type::input_source_changed:
-            if (n < sizeof(operation_type_input_source_changed_struct)) {
-              logger::get_logger().error("invalid size for operation_type::input_source_changed ({0})", n);
-            } else {
-              auto p = reinterpret_cast<operation_type_input_source_changed_struct*>(&(buffer_[0]));
-
-              // Ensure bundle_identifier and file_path are null-terminated string even if corrupted data is sent.
-              p->language[sizeof(p->language) - 1] = '\0';
-              p->input_source_id[sizeof(p->input_source_id) - 1] = '\0';
-              p->input_mode_id[sizeof(p->input_mode_id) - 1] = '\0';
-
-              device_grabber_.post_input_source_changed_event({std::string(p->language),
-                                                               std::string(p->input_source_id),
-                                                               std::string(p->input_mode_id)});
-            }
-            break;
-
-          default:
-            break;
+      case operation_type::system_preferences_values_updated: {
+        auto keyboard_fn_state = reader.read_uint8();
+        if (!keyboard_fn_state) {
+          logger::get_logger().error("invalid payload for operation_type::system_preferences_values_updated");
+          break;
         }
+
+        device_grabber_.set_system_preferences_values(system_preferences::values(*keyboard_fn_state != 0));
+        logger::get_logger().info("system_preferences_values_updated");
+        break;
+      }
+
+      case operation_type::frontmost_application_changed: {
+        auto bundle_identifier = reader.read_string();
+        auto file_path = reader.read_string();
+        if (!bundle_identifier || !file_path) {
+          logger::get_logger().error("invalid payload for operation_type::frontmost_application_changed");
+          break;
+        }
+
+        device_grabber_.post_frontmost_application_changed_event(*bundle_identifier,
+                                                                 *file_path);
+        break;
       }
+
+      case operation_type::input_source_changed: {
+        auto language = reader.read_string();
+        auto input_source_id = reader.read_string();
+        auto input_mode_id = reader.read_string();
+        if (!language || !input_source_id || !input_mode_id) {
+          logger::get_logger().error("invalid payload for operation_type::input_source_changed");
+          break;
+        }
+
+        device_grabber_.post_input_source_changed_event({*language,
+                                                         *input_source_id,
+                                                         *input_mode_id});
+        break;
+      }
+
+      default:
+        break;
     }
   }
 
@@ -146,10 +139,7 @@ private:
 
   device_grabber& device_grabber_;
 
-  std::vector<uint8_t> buffer_;
-  std::unique_ptr<local_datagram_server> server_;
-  std::thread thread_;
-  std::atomic<bool> exit_loop_;
+  std::unique_ptr<async_local_datagram_server> server_;
 
   std::unique_ptr<process_monitor> console_user_server_process_monitor_;
 };
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <json/json.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace krbn {
+// async_json_file_writer writes json into a file in a background thread.
+//
+// `mark_dirty` is cheap and can be called frequently (e.g., for each key event).
+// It does not take the lock while the output is disabled or the writer is already dirty.
+// The json is made by `make_json` and written at most once per `interval`.
+// The file is replaced atomically by writing a temporary file and renaming it.
+
+class async_json_file_writer final {
+public:
+  async_json_file_writer(const async_json_file_writer&) = delete;
+
+  async_json_file_writer(std::chrono::milliseconds interval,
+                         const std::function<nlohmann::json(void)>& make_json) : interval_(interval),
+                                                                                 make_json_(make_json),
+                                                                                 enabled_(false),
+                                                                                 dirty_(false),
+                                                                                 exit_(false) {
+  }
+
+  ~async_json_file_writer(void) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      exit_ = true;
+    }
+    cv_.notify_one();
+
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+
+    flush();
+  }
+
+  void enable(const std::string& file_path) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      file_path_ = file_path;
+    }
+    enabled_ = true;
+
+    if (!thread_.joinable()) {
+      thread_ = std::thread([this] {
+        worker();
+      });
+    }
+  }
+
+  void disable(void) {
+    enabled_ = false;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      file_path_.clear();
+      dirty_ = false;
+    }
+
+    // Wait for the running `make_json_`.
+    // `make_json_` is not called after `disable` returns until `enable` is called.
+    std::lock_guard<std::mutex> lock(write_mutex_);
+  }
+
+  bool is_enabled(void) const {
+    return enabled_;
+  }
+
+  void mark_dirty(void) {
+    if (!enabled_ || dirty_.exchange(true)) {
+      return;
+    }
+
+    // Take the lock in order to avoid the lost wakeup between the predicate check and the wait in `worker`.
+    // (This lock is taken at most once per write since `dirty_` is cleared only by `flush`.)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+    }
+    cv_.notify_one();
+  }
+
+  // Write the pending changes immediately. (e.g., for unit testing)
+  void flush(void) {
+    std::string file_path;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (!dirty_.exchange(false)) {
+        return;
+      }
+
+      file_path = file_path_;
+    }
+
+    write(file_path);
+  }
+
+private:
+  void worker(void) {
+    auto last_write_time = std::chrono::steady_clock::now() - interval_;
+
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        cv_.wait(lock, [this] {
+          return dirty_ || exit_;
+        });
+
+        // Coalesce changes within the interval.
+        cv_.wait_until(lock, last_write_time + interval_, [this] {
+          return exit_;
+        });
+
+        if (exit_) {
+          return;
+        }
+      }
+
+      flush();
+      last_write_time = std::chrono::steady_clock::now();
+    }
+  }
+
+  void write(const std::string& file_path) {
+    if (file_path.empty()) {
+      return;
+    }
+
+    // Serialize writes from the worker thread and `flush`.
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    if (!enabled_) {
+      return;
+    }
+
+    auto json = make_json_();
+
+    filesystem::create_directory_with_intermediate_directories(filesystem::dirname(file_path), 0755);
+
+    auto tmp_file_path = file_path + ".tmp";
+
+    {
+      std::ofstream output(tmp_file_path);
+      if (!output) {
+        logger::get_logger().warn("Failed to open {0}", tmp_file_path);
+        return;
+      }
+
+      output << std::setw(4) << json << std::endl;
+    }
+
+    if (std::rename(tmp_file_path.c_str(), file_path.c_str()) != 0) {
+      logger::get_logger().warn("Failed to rename {0} to {1}", tmp_file_path, file_path);
+    }
+  }
+
+  std::chrono::milliseconds interval_;
+  std::function<nlohmann::json(void)> make_json_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::string file_path_;
+  std::atomic<bool> enabled_;
+  std::atomic<bool> dirty_;
+  bool exit_;
+
+  std::mutex write_mutex_;
+  std::thread thread_;
+};
+} // namespace krbn
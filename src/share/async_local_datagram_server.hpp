@@ -0,0 +1,152 @@
+#pragma once
+
+#include "boost_defs.hpp"
+
+BEGIN_BOOST_INCLUDE
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+END_BOOST_INCLUDE
+
+#include "logger.hpp"
+#include "spdlog_utility.hpp"
+#include <functional>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace krbn {
+// async_local_datagram_server calls `callback` in its own thread when a datagram is received.
+// (The thread sleeps until a datagram arrives. There is no polling timeout.)
+//
+// When a non-transient error (e.g., bad_descriptor) occurs, the socket is closed and bound again after a delay.
+// (Calling `async_receive` on the broken socket immediately makes a busy loop in the server thread.)
+// The owner and permissions of the socket file are kept.
+
+class async_local_datagram_server final {
+public:
+  typedef std::function<void(const uint8_t* _Nonnull p, size_t length)> callback;
+
+  async_local_datagram_server(const async_local_datagram_server&) = delete;
+
+  async_local_datagram_server(const char* _Nonnull path,
+                              size_t buffer_size,
+                              const callback& callback) : endpoint_(path),
+                                                          io_service_(),
+                                                          socket_(io_service_, endpoint_),
+                                                          rebind_timer_(io_service_),
+                                                          buffer_(buffer_size),
+                                                          callback_(callback) {
+    async_receive();
+
+    thread_ = std::thread([this] { (this->io_service_).run(); });
+  }
+
+  ~async_local_datagram_server(void) {
+    io_service_.post(boost::bind(&async_local_datagram_server::do_stop, this));
+    thread_.join();
+  }
+
+private:
+  void async_receive(void) {
+    socket_.async_receive(boost::asio::buffer(buffer_),
+                          boost::bind(&async_local_datagram_server::handle_receive,
+                                      this,
+                                      boost::asio::placeholders::error,
+                                      boost::asio::placeholders::bytes_transferred));
+  }
+
+  void handle_receive(const boost::system::error_code& ec, std::size_t length) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    }
+
+    if (ec) {
+      if (!is_transient_error(ec)) {
+        log_reducer_.error(std::string("async_local_datagram_server error: ") + ec.message() + " (the socket will be bound again)");
+
+        boost::system::error_code error_code;
+        socket_.close(error_code);
+
+        async_rebind();
+        return;
+      }
+
+      log_reducer_.warn(std::string("async_local_datagram_server error: ") + ec.message());
+    } else {
+      log_reducer_.reset();
+
+      if (length > 0 && callback_) {
+        callback_(&(buffer_[0]), length);
+      }
+    }
+
+    async_receive();
+  }
+
+  void async_rebind(void) {
+    rebind_timer_.expires_from_now(boost::posix_time::seconds(1));
+    rebind_timer_.async_wait([this](const boost::system::error_code& ec) {
+      if (ec == boost::asio::error::operation_aborted) {
+        return;
+      }
+
+      rebind();
+    });
+  }
+
+  void rebind(void) {
+    auto path = endpoint_.path();
+
+    // Keep the owner and permissions which are set by the server owner. (e.g., `receiver`)
+    struct stat st;
+    bool exists = (stat(path.c_str(), &st) == 0);
+    unlink(path.c_str());
+
+    boost::system::error_code error_code;
+    socket_.open(boost::asio::local::datagram_protocol(), error_code);
+    if (!error_code) {
+      socket_.bind(endpoint_, error_code);
+    }
+    if (error_code) {
+      log_reducer_.error(std::string("async_local_datagram_server failed to bind: ") + error_code.message());
+
+      boost::system::error_code e;
+      socket_.close(e);
+
+      async_rebind();
+      return;
+    }
+
+    if (exists) {
+      chown(path.c_str(), st.st_uid, st.st_gid);
+      chmod(path.c_str(), st.st_mode & ALLPERMS);
+    }
+
+    logger::get_logger().info("async_local_datagram_server is bound again: {0}", path);
+
+    async_receive();
+  }
+
+  static bool is_transient_error(const boost::system::error_code& ec) {
+    return ec == boost::asio::error::interrupted ||
+           ec == boost::asio::error::would_block ||
+           ec == boost::asio::error::try_again ||
+           ec == boost::asio::error::no_buffer_space ||
+           ec == boost::asio::error::no_memory;
+  }
+
+  void do_stop(void) {
+    io_service_.stop();
+  }
+
+  boost::asio::local::datagram_protocol::endpoint endpoint_;
+  boost::asio::io_service io_service_;
+  boost::asio::local::datagram_protocol::socket socket_;
+  boost::asio::deadline_timer rebind_timer_;
+  std::vector<uint8_t> buffer_;
+  callback callback_;
+  std::thread thread_;
+  spdlog_utility::log_reducer log_reducer_;
+};
+} // namespace krbn
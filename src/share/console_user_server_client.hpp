@@ -1,34 +1,67 @@
 #pragma once
 
+#include "boost_defs.hpp"
+
+BEGIN_BOOST_INCLUDE
+#include <boost/asio.hpp>
+END_BOOST_INCLUDE
+
 #include "constants.hpp"
 #include "filesystem.hpp"
-#include "local_datagram_client.hpp"
 #include "logger.hpp"
 #include "session.hpp"
 #include "types.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
 namespace krbn {
+// console_user_server_client sends operations (shell_command_execution, select_input_source) to console_user_server.
+//
+// The client is long-lived and it sends operations in a worker thread in order to avoid blocking the caller (main queue).
+// Queued operations are packed into a datagram as many as possible.
+// The socket is reopened when the console user is changed or sending is failed.
+
 class console_user_server_client final {
 public:
   console_user_server_client(const console_user_server_client&) = delete;
 
-  console_user_server_client(uid_t uid) {
-    auto socket_file_path = make_console_user_server_socket_file_path(uid);
+  console_user_server_client(void) : console_user_server_client(session::get_current_console_user_id,
+                                                                make_console_user_server_socket_file_path) {
+  }
 
-    // Check socket file existance
-    if (!filesystem::exists(socket_file_path)) {
-      throw std::runtime_error("console_user_server socket is not found");
-    }
+  // `console_user_id_provider` and `socket_file_path_provider` are replaceable for unit testing.
+  console_user_server_client(const std::function<boost::optional<uid_t>(void)>& console_user_id_provider,
+                             const std::function<std::string(uid_t)>& socket_file_path_provider,
+                             size_t max_queue_size = 64) : console_user_id_provider_(console_user_id_provider),
+                                                           socket_file_path_provider_(socket_file_path_provider),
+                                                           max_queue_size_(max_queue_size),
+                                                           exit_(false),
+                                                           sending_(false) {
+    thread_ = std::thread([this] {
+      worker();
+    });
+  }
 
-    // Check socket file permission
-    if (!filesystem::is_owned(socket_file_path, uid)) {
-      throw std::runtime_error("console_user_server socket owner is invalid");
+  ~console_user_server_client(void) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      exit_ = true;
     }
+    cv_.notify_all();
 
-    client_ = std::make_unique<local_datagram_client>(socket_file_path.c_str());
+    // Pending operations are sent before the worker thread is finished.
+    // (They are sent without retry. See `send`.)
+    if (thread_.joinable()) {
+      thread_.join();
+    }
   }
 
   void shell_command_execution(const std::string& shell_command) {
@@ -43,7 +76,7 @@ public:
             shell_command.c_str(),
             sizeof(s.shell_command));
 
-    client_->send_to(reinterpret_cast<uint8_t*>(&s), sizeof(s));
+    enqueue(reinterpret_cast<uint8_t*>(&s), sizeof(s));
   }
 
   void select_input_source(const input_source_selector& input_source_selector, uint64_t time_stamp) {
@@ -83,7 +116,21 @@ public:
               sizeof(s.input_mode_id));
     }
 
-    client_->send_to(reinterpret_cast<uint8_t*>(&s), sizeof(s));
+    enqueue(reinterpret_cast<uint8_t*>(&s), sizeof(s));
+  }
+
+  // Wait until queued operations are sent. (e.g., for unit testing)
+  void wait_until_idle(void) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    idle_cv_.wait(lock, [this] {
+      return queue_.empty() && !sending_;
+    });
+  }
+
+  // The maximum datagram size of local datagram socket on macOS. (net.local.dgram.maxdgram)
+  static size_t get_max_datagram_size(void) {
+    return 2048;
   }
 
   static std::string make_console_user_server_socket_directory(uid_t uid) {
@@ -97,6 +144,174 @@ public:
   }
 
 private:
-  std::unique_ptr<local_datagram_client> client_;
+  void enqueue(const uint8_t* p, size_t length) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (queue_.size() >= max_queue_size_) {
+        logger::get_logger().warn("console_user_server_client queue is full. An operation is dropped.");
+        return;
+      }
+
+      queue_.emplace_back(p, p + length);
+    }
+    cv_.notify_one();
+  }
+
+  void worker(void) {
+    std::vector<uint8_t> datagram;
+    datagram.reserve(get_max_datagram_size());
+
+    for (;;) {
+      datagram.clear();
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        cv_.wait(lock, [this] {
+          return !queue_.empty() || exit_;
+        });
+
+        if (queue_.empty()) {
+          // exit_ == true
+          return;
+        }
+
+        // Pack operations into a datagram.
+        while (!queue_.empty()) {
+          const auto& v = queue_.front();
+          if (!datagram.empty() && datagram.size() + v.size() > get_max_datagram_size()) {
+            break;
+          }
+          datagram.insert(std::end(datagram), std::begin(v), std::end(v));
+          queue_.pop_front();
+        }
+
+        sending_ = true;
+      }
+
+      send(datagram);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        sending_ = false;
+      }
+      idle_cv_.notify_all();
+    }
+  }
+
+  // This method is called only in the worker thread.
+  void send(const std::vector<uint8_t>& datagram) {
+    // Resolve the console user periodically in order to follow the user switching.
+    auto now = std::chrono::steady_clock::now();
+    if (!socket_ || now - last_resolve_time_ > std::chrono::seconds(1)) {
+      last_resolve_time_ = now;
+
+      auto uid = console_user_id_provider_();
+      if (!uid) {
+        close();
+        return;
+      }
+
+      if (socket_ && uid != socket_uid_) {
+        close();
+      }
+
+      if (!socket_ && !open(*uid)) {
+        return;
+      }
+    }
+
+    boost::system::error_code ec;
+    for (int i = 0; i < 10; ++i) {
+      socket_->send_to(boost::asio::buffer(datagram), endpoint_, 0, ec);
+      if (ec != boost::asio::error::would_block) {
+        break;
+      }
+
+      // The receive buffer of console_user_server is full. Wait a moment.
+      // (Do not wait at destruction in order to avoid blocking the destructor for each pending datagram.)
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if (cv_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+              return exit_;
+            })) {
+          break;
+        }
+      }
+    }
+
+    if (ec == boost::asio::error::would_block) {
+      logger::get_logger().warn("console_user_server is busy. Operations are dropped.");
+      return;
+    }
+
+    if (ec) {
+      logger::get_logger().warn("console_user_server_client error: {0}", ec.message());
+      // Reopen the socket at the next sending since console_user_server might be restarted.
+      close();
+    }
+  }
+
+  bool open(uid_t uid) {
+    auto socket_file_path = socket_file_path_provider_(uid);
+
+    // Check socket file existance
+    if (!filesystem::exists(socket_file_path)) {
+      logger::get_logger().warn("console_user_server socket is not found");
+      return false;
+    }
+
+    // Check socket file permission
+    if (!filesystem::is_owned(socket_file_path, uid)) {
+      logger::get_logger().warn("console_user_server socket owner is invalid");
+      return false;
+    }
+
+    auto socket = std::make_unique<boost::asio::local::datagram_protocol::socket>(io_service_);
+    boost::system::error_code ec;
+    socket->open(boost::asio::local::datagram_protocol(), ec);
+    if (!ec) {
+      // Do not block the worker thread forever even if console_user_server does not receive datagrams.
+      socket->non_blocking(true, ec);
+    }
+    if (ec) {
+      logger::get_logger().warn("console_user_server_client error: {0}", ec.message());
+      return false;
+    }
+
+    socket_ = std::move(socket);
+    socket_uid_ = uid;
+    endpoint_ = boost::asio::local::datagram_protocol::endpoint(socket_file_path);
+
+    return true;
+  }
+
+  void close(void) {
+    socket_ = nullptr;
+    socket_uid_ = boost::none;
+  }
+
+  std::function<boost::optional<uid_t>(void)> console_user_id_provider_;
+  std::function<std::string(uid_t)> socket_file_path_provider_;
+  size_t max_queue_size_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable idle_cv_;
+  std::deque<std::vector<uint8_t>> queue_;
+  bool exit_;
+  bool sending_;
+
+  // The following members are used only in the worker thread.
+  boost::asio::io_service io_service_;
+  std::unique_ptr<boost::asio::local::datagram_protocol::socket> socket_;
+  boost::optional<uid_t> socket_uid_;
+  boost::asio::local::datagram_protocol::endpoint endpoint_;
+  std::chrono::steady_clock::time_point last_resolve_time_;
+
+  std::thread thread_;
 };
 } // namespace krbn
@@ -8,8 +8,14 @@
 #include "pointing_button_manager.hpp"
 #include "stream_utility.hpp"
 #include "types.hpp"
+#include "variable_name_table.hpp"
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
+#include <deque>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace krbn {
 class event_queue final {
@@ -18,7 +24,7 @@ public:
   public:
     class event {
     public:
-      enum class type {
+      enum class type : uint8_t {
         none,
         key_code,
         consumer_key_code,
@@ -44,11 +50,11 @@ public:
       };
 
       event(void) : type_(type::none),
-                    value_(boost::blank()) {
+                    has_value_(false),
+                    value_(0) {
       }
 
-      event(const nlohmann::json& json) : type_(type::none),
-                                          value_(boost::blank()) {
+      event(const nlohmann::json& json) : event() {
         if (auto v = json_utility::find_optional<std::string>(json, "type")) {
           type_ = to_type(*v);
         }
@@ -60,7 +66,7 @@ public:
           case type::key_code:
             if (auto s = json_utility::find_optional<std::string>(json, "key_code")) {
               if (auto v = types::make_key_code(*s)) {
-                value_ = *v;
+                set_value(static_cast<int64_t>(*v));
               }
             }
             break;
@@ -68,7 +74,7 @@ public:
           case type::consumer_key_code:
             if (auto s = json_utility::find_optional<std::string>(json, "consumer_key_code")) {
               if (auto v = types::make_consumer_key_code(*s)) {
-                value_ = *v;
+                set_value(static_cast<int64_t>(*v));
               }
             }
             break;
@@ -76,7 +82,7 @@ public:
           case type::pointing_button:
             if (auto s = json_utility::find_optional<std::string>(json, "pointing_button")) {
               if (auto v = types::make_pointing_button(*s)) {
-                value_ = *v;
+                set_value(static_cast<int64_t>(*v));
               }
             }
             break;
@@ -87,13 +93,13 @@ public:
           case type::pointing_horizontal_wheel:
           case type::caps_lock_state_changed:
             if (auto v = json_utility::find_optional<int>(json, "integer_value")) {
-              value_ = *v;
+              set_value(*v);
             }
             break;
 
           case type::shell_command:
             if (auto v = json_utility::find_optional<std::string>(json, "shell_command")) {
-              value_ = *v;
+              set_payload(*v);
             }
             break;
 
@@ -103,7 +109,7 @@ public:
               for (const auto& j : *v) {
                 input_source_selectors.emplace_back(j);
               }
-              value_ = input_source_selectors;
+              set_payload(input_source_selectors);
             }
             break;
 
@@ -116,31 +122,31 @@ public:
               if (auto v = json_utility::find_optional<int>(*o, "value")) {
                 pair.second = *v;
               }
-              value_ = pair;
+              set_set_variable(variable_name_table::get_instance().intern(pair.first), pair.second);
             }
             break;
 
           case type::mouse_key:
             if (auto v = json_utility::find_json(json, "mouse_key")) {
-              value_ = mouse_key(*v);
+              set_payload(mouse_key(*v));
             }
             break;
 
           case type::frontmost_application_changed:
             if (auto v = json_utility::find_json(json, "frontmost_application")) {
-              value_ = manipulator_environment::frontmost_application(*v);
+              set_payload(manipulator_environment::frontmost_application(*v));
             }
             break;
 
           case type::input_source_changed:
             if (auto v = json_utility::find_json(json, "input_source_identifiers")) {
-              value_ = input_source_identifiers(*v);
+              set_payload(input_source_identifiers(*v));
             }
             break;
 
           case type::keyboard_type_changed:
             if (auto v = json_utility::find_optional<std::string>(json, "keyboard_type")) {
-              value_ = *v;
+              set_payload(*v);
             }
             break;
 
@@ -208,7 +214,7 @@ public:
 
           case type::set_variable:
             if (auto v = get_set_variable()) {
-              json["set_variable"]["name"] = v->first;
+              json["set_variable"]["name"] = variable_name_table::get_instance().get_name(v->first);
               json["set_variable"]["value"] = v->second;
             }
             break;
@@ -247,48 +253,57 @@ public:
         return json;
       }
 
-      event(key_code key_code) : type_(type::key_code),
-                                 value_(key_code) {
+      event(key_code key_code) : event() {
+        type_ = type::key_code;
+        set_value(static_cast<int64_t>(key_code));
       }
 
-      event(consumer_key_code consumer_key_code) : type_(type::consumer_key_code),
-                                                   value_(consumer_key_code) {
+      event(consumer_key_code consumer_key_code) : event() {
+        type_ = type::consumer_key_code;
+        set_value(static_cast<int64_t>(consumer_key_code));
       }
 
-      event(pointing_button pointing_button) : type_(type::pointing_button),
-                                               value_(pointing_button) {
+      event(pointing_button pointing_button) : event() {
+        type_ = type::pointing_button;
+        set_value(static_cast<int64_t>(pointing_button));
       }
 
       event(type type,
-            int64_t integer_value) : type_(type),
-                                     value_(integer_value) {
+            int64_t integer_value) : event() {
+        type_ = type;
+        set_value(integer_value);
       }
 
       static event make_shell_command_event(const std::string& shell_command) {
         event e;
         e.type_ = type::shell_command;
-        e.value_ = shell_command;
+        e.set_payload(shell_command);
         return e;
       }
 
       static event make_select_input_source_event(const std::vector<input_source_selector>& input_source_selector) {
         event e;
         e.type_ = type::select_input_source;
-        e.value_ = input_source_selector;
+        e.set_payload(input_source_selector);
         return e;
       }
 
-      static event make_set_variable_event(const std::pair<std::string, int>& pair) {
+      static event make_set_variable_event(const std::pair<variable_id, int>& pair) {
         event e;
         e.type_ = type::set_variable;
-        e.value_ = pair;
+        e.set_set_variable(pair.first, pair.second);
         return e;
       }
 
+      static event make_set_variable_event(const std::pair<std::string, int>& pair) {
+        return make_set_variable_event(std::make_pair(variable_name_table::get_instance().intern(pair.first),
+                                                      pair.second));
+      }
+
       static event make_mouse_key_event(const mouse_key& mouse_key) {
         event e;
         e.type_ = type::mouse_key;
-        e.value_ = mouse_key;
+        e.set_payload(mouse_key);
         return e;
       }
 
@@ -312,22 +327,22 @@ public:
                                                             const std::string& file_path) {
         event e;
         e.type_ = type::frontmost_application_changed;
-        e.value_ = manipulator_environment::frontmost_application(bundle_identifier,
-                                                                  file_path);
+        e.set_payload(manipulator_environment::frontmost_application(bundle_identifier,
+                                                                     file_path));
         return e;
       }
 
       static event make_input_source_changed_event(const input_source_identifiers& input_source_identifiers) {
         event e;
         e.type_ = type::input_source_changed;
-        e.value_ = input_source_identifiers;
+        e.set_payload(input_source_identifiers);
         return e;
       }
 
       static event make_keyboard_type_changed_event(const std::string& keyboard_type) {
         event e;
         e.type_ = type::keyboard_type_changed;
-        e.value_ = keyboard_type;
+        e.set_payload(keyboard_type);
         return e;
       }
 
@@ -336,132 +351,255 @@ public:
       }
 
       boost::optional<key_code> get_key_code(void) const {
-        try {
-          if (type_ == type::key_code) {
-            return boost::get<key_code>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::key_code && has_value_) {
+          return static_cast<key_code>(value_);
         }
         return boost::none;
       }
 
       boost::optional<consumer_key_code> get_consumer_key_code(void) const {
-        try {
-          if (type_ == type::consumer_key_code) {
-            return boost::get<consumer_key_code>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::consumer_key_code && has_value_) {
+          return static_cast<consumer_key_code>(value_);
         }
         return boost::none;
       }
 
       boost::optional<pointing_button> get_pointing_button(void) const {
-        try {
-          if (type_ == type::pointing_button) {
-            return boost::get<pointing_button>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::pointing_button && has_value_) {
+          return static_cast<pointing_button>(value_);
         }
         return boost::none;
       }
 
       boost::optional<int64_t> get_integer_value(void) const {
-        try {
-          if (type_ == type::pointing_x ||
-              type_ == type::pointing_y ||
-              type_ == type::pointing_vertical_wheel ||
-              type_ == type::pointing_horizontal_wheel ||
-              type_ == type::caps_lock_state_changed) {
-            return boost::get<int64_t>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if ((type_ == type::pointing_x ||
+             type_ == type::pointing_y ||
+             type_ == type::pointing_vertical_wheel ||
+             type_ == type::pointing_horizontal_wheel ||
+             type_ == type::caps_lock_state_changed) &&
+            has_value_) {
+          return value_;
         }
         return boost::none;
       }
 
       boost::optional<std::string> get_shell_command(void) const {
-        try {
-          if (type_ == type::shell_command) {
-            return boost::get<std::string>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::shell_command) {
+          return get_payload<std::string>();
         }
         return boost::none;
       }
 
       boost::optional<std::vector<input_source_selector>> get_input_source_selectors(void) const {
-        try {
-          if (type_ == type::select_input_source) {
-            return boost::get<std::vector<input_source_selector>>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::select_input_source) {
+          return get_payload<std::vector<input_source_selector>>();
         }
         return boost::none;
       }
 
-      boost::optional<std::pair<std::string, int>> get_set_variable(void) const {
-        try {
-          if (type_ == type::set_variable) {
-            return boost::get<std::pair<std::string, int>>(value_);
-          }
-        } catch (boost::bad_get&) {
+      boost::optional<std::pair<variable_id, int>> get_set_variable(void) const {
+        if (type_ == type::set_variable && has_value_) {
+          return std::make_pair(variable_id(static_cast<uint64_t>(value_) >> 32),
+                                static_cast<int>(static_cast<uint32_t>(value_)));
         }
         return boost::none;
       }
 
       boost::optional<mouse_key> get_mouse_key(void) const {
-        try {
-          if (type_ == type::mouse_key) {
-            return boost::get<mouse_key>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::mouse_key) {
+          return get_payload<mouse_key>();
         }
         return boost::none;
       }
 
       boost::optional<manipulator_environment::frontmost_application> get_frontmost_application(void) const {
-        try {
-          if (type_ == type::frontmost_application_changed) {
-            return boost::get<manipulator_environment::frontmost_application>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::frontmost_application_changed) {
+          return get_payload<manipulator_environment::frontmost_application>();
         }
         return boost::none;
       }
 
       boost::optional<input_source_identifiers> get_input_source_identifiers(void) const {
-        try {
-          if (type_ == type::input_source_changed) {
-            return boost::get<input_source_identifiers>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::input_source_changed) {
+          return get_payload<input_source_identifiers>();
         }
         return boost::none;
       }
 
       boost::optional<std::string> get_keyboard_type(void) const {
-        try {
-          if (type_ == type::keyboard_type_changed) {
-            return boost::get<std::string>(value_);
-          }
-        } catch (boost::bad_get&) {
+        if (type_ == type::keyboard_type_changed) {
+          return get_payload<std::string>();
         }
         return boost::none;
       }
 
       bool operator==(const event& other) const {
-        return get_type() == other.get_type() &&
-               value_ == other.value_;
+        if (get_type() != other.get_type() ||
+            has_value_ != other.has_value_) {
+          return false;
+        }
+
+        // frontmost_application payloads are not interned. (See `payload_table`.)
+        if (type_ == type::frontmost_application_changed) {
+          return get_frontmost_application() == other.get_frontmost_application();
+        }
+
+        // Other payloads are interned, so the same payload always has the same index.
+        return value_ == other.value_;
       }
 
     private:
+      // Payloads which require heap allocation are stored in `payload_table` and `event` holds only their index.
+      // `event` is copied many times in each manipulator stage,
+      // so we keep `event` trivially copyable and avoid allocations on the key path.
+
+      using payload = boost::variant<std::string,                                    // For shell_command, keyboard_type_changed
+                                     std::vector<input_source_selector>,             // For select_input_source
+                                     mouse_key,                                      // For mouse_key
+                                     manipulator_environment::frontmost_application, // For frontmost_application_changed
+                                     input_source_identifiers>;                      // For input_source_changed
+
+      class payload_table final {
+      public:
+        static payload_table& get_instance(void) {
+          static payload_table instance;
+          return instance;
+        }
+
+        payload_table(void) : transient_payloads_(get_transient_payload_capacity(),
+                                                  std::make_pair(-1, payload())),
+                              next_transient_index_(0) {
+        }
+
+        // Payloads which come from the configuration (shell_command, select_input_source, mouse_key) or
+        // have a small number of distinct values (keyboard_type, input_source_identifiers) are interned
+        // and kept while the process is running. (to_event_definition holds events for a long time.)
+        //
+        // frontmost_application payloads are not interned since their distinct values are unbounded
+        // (e.g., file_path of translocated or versioned application bundles).
+        // They are stored in a ring buffer and evicted after `get_transient_payload_capacity` newer ones.
+        // (frontmost_application_changed events are consumed in one `manipulate` call.)
+        int64_t intern(const payload& p) {
+          std::lock_guard<std::mutex> lock(mutex_);
+
+          if (boost::get<manipulator_environment::frontmost_application>(&p)) {
+            // Reuse the last entry for the same application.
+            if (next_transient_index_ > 0) {
+              const auto& last = transient_payloads_[(next_transient_index_ - 1) % get_transient_payload_capacity()];
+              if (last.second == p) {
+                return last.first;
+              }
+            }
+
+            auto index = next_transient_index_++;
+            transient_payloads_[index % get_transient_payload_capacity()] = std::make_pair(index, p);
+            return index;
+          }
+
+          auto& indices = indices_[make_key(p)];
+          for (const auto& i : indices) {
+            if (payloads_[i] == p) {
+              return static_cast<int64_t>(i);
+            }
+          }
+
+          payloads_.push_back(p);
+          indices.push_back(payloads_.size() - 1);
+          return static_cast<int64_t>(payloads_.size() - 1);
+        }
+
+        template <typename T>
+        boost::optional<T> get(int64_t index) const {
+          std::lock_guard<std::mutex> lock(mutex_);
+
+          const payload* p = nullptr;
+          if (std::is_same<T, manipulator_environment::frontmost_application>::value) {
+            if (index >= 0) {
+              const auto& e = transient_payloads_[index % get_transient_payload_capacity()];
+              if (e.first == index) {
+                p = &(e.second);
+              }
+            }
+          } else {
+            if (0 <= index && static_cast<size_t>(index) < payloads_.size()) {
+              p = &(payloads_[index]);
+            }
+          }
+
+          if (p) {
+            if (auto v = boost::get<T>(p)) {
+              return *v;
+            }
+          }
+          return boost::none;
+        }
+
+        size_t get_interned_payloads_size(void) const {
+          std::lock_guard<std::mutex> lock(mutex_);
+
+          return payloads_.size();
+        }
+
+        static size_t get_transient_payload_capacity(void) {
+          return 256;
+        }
+
+      private:
+        // The hash key of interned payloads.
+        static std::string make_key(const payload& p) {
+          nlohmann::json json;
+          if (auto v = boost::get<std::string>(&p)) {
+            json = *v;
+          } else if (auto v = boost::get<std::vector<input_source_selector>>(&p)) {
+            json = nlohmann::json::array();
+            for (const auto& s : *v) {
+              json.push_back(s.to_json());
+            }
+          } else if (auto v = boost::get<mouse_key>(&p)) {
+            json = v->to_json();
+          } else if (auto v = boost::get<input_source_identifiers>(&p)) {
+            json = v->to_json();
+          }
+          return std::to_string(p.which()) + json.dump();
+        }
+
+        mutable std::mutex mutex_;
+        std::deque<payload> payloads_;
+        // make_key -> indices of payloads_ (payloads which have the same key are compared by operator==)
+        std::unordered_map<std::string, std::vector<size_t>> indices_;
+        // (index, payload)
+        std::vector<std::pair<int64_t, payload>> transient_payloads_;
+        int64_t next_transient_index_;
+      };
+
       static event make_virtual_event(type type) {
         event e;
         e.type_ = type;
-        e.value_ = boost::blank();
         return e;
       }
 
+      void set_value(int64_t value) {
+        has_value_ = true;
+        value_ = value;
+      }
+
+      // set_variable is stored in value_ directly. (upper 32 bits: variable_id, lower 32 bits: value)
+      void set_set_variable(variable_id id, int value) {
+        set_value(static_cast<int64_t>((static_cast<uint64_t>(id) << 32) | static_cast<uint32_t>(value)));
+      }
+
+      void set_payload(const payload& p) {
+        set_value(payload_table::get_instance().intern(p));
+      }
+
+      template <typename T>
+      boost::optional<T> get_payload(void) const {
+        if (has_value_) {
+          return payload_table::get_instance().get<T>(value_);
+        }
+        return boost::none;
+      }
+
       static const char* to_c_string(type t) {
 #define TO_C_STRING(TYPE) \
   case type::TYPE:        \
@@ -529,21 +667,13 @@ public:
       }
 
       type type_;
-
-      boost::variant<key_code,                                       // For type::key_code
-                     consumer_key_code,                              // For type::consumer_key_code
-                     pointing_button,                                // For type::pointing_button
-                     int64_t,                                        // For type::pointing_x, type::pointing_y, type::pointing_vertical_wheel, type::pointing_horizontal_wheel
-                     std::string,                                    // For shell_command, keyboard_type_changed
-                     std::vector<input_source_selector>,             // For select_input_source
-                     std::pair<std::string, int>,                    // For set_variable
-                     mouse_key,                                      // For mouse_key
-                     manipulator_environment::frontmost_application, // For frontmost_application_changed
-                     input_source_identifiers,                       // For input_source_changed
-                     boost::blank>                                   // For virtual events
-          value_;
+      bool has_value_;
+      int64_t value_; // key_code, consumer_key_code, pointing_button, integer_value, set_variable or index of payload_table.
     };
 
+    static_assert(std::is_trivially_copyable<event>::value, "event must be trivially copyable");
+    static_assert(sizeof(event) <= 16, "event must be compact");
+
     queued_event(device_id device_id,
                  uint64_t time_stamp,
                  const class event& event,
@@ -660,6 +790,8 @@ public:
     event original_event_;
   };
 
+  static_assert(std::is_trivially_copyable<queued_event>::value, "queued_event must be trivially copyable");
+
   event_queue(const event_queue&) = delete;
 
   event_queue(void) : time_stamp_delay_(0) {
@@ -780,59 +912,7 @@ public:
 
     sort_events();
 
-    // Update modifier_flag_manager
-
-    if (auto key_code = event.get_key_code()) {
-      if (auto modifier_flag = types::make_modifier_flag(*key_code)) {
-        auto type = (event_type == event_type::key_down ? modifier_flag_manager::active_modifier_flag::type::increase
-                                                        : modifier_flag_manager::active_modifier_flag::type::decrease);
-        modifier_flag_manager::active_modifier_flag active_modifier_flag(type,
-                                                                         *modifier_flag,
-                                                                         device_id);
-        modifier_flag_manager_.push_back_active_modifier_flag(active_modifier_flag);
-      }
-    }
-
-    if (event.get_type() == queued_event::event::type::caps_lock_state_changed) {
-      if (auto integer_value = event.get_integer_value()) {
-        auto type = (*integer_value ? modifier_flag_manager::active_modifier_flag::type::increase_lock
-                                    : modifier_flag_manager::active_modifier_flag::type::decrease_lock);
-        modifier_flag_manager::active_modifier_flag active_modifier_flag(type,
-                                                                         modifier_flag::caps_lock,
-                                                                         device_id);
-        modifier_flag_manager_.push_back_active_modifier_flag(active_modifier_flag);
-      }
-    }
-
-    // Update pointing_button_manager
-
-    if (auto pointing_button = event.get_pointing_button()) {
-      if (*pointing_button != pointing_button::zero) {
-        auto type = (event_type == event_type::key_down ? pointing_button_manager::active_pointing_button::type::increase
-                                                        : pointing_button_manager::active_pointing_button::type::decrease);
-        pointing_button_manager::active_pointing_button active_pointing_button(type,
-                                                                               *pointing_button,
-                                                                               device_id);
-        pointing_button_manager_.push_back_active_pointing_button(active_pointing_button);
-      }
-    }
-
-    // Update manipulator_environment
-    if (auto frontmost_application = event.get_frontmost_application()) {
-      manipulator_environment_.set_frontmost_application(*frontmost_application);
-    }
-    if (auto input_source_identifiers = event.get_input_source_identifiers()) {
-      manipulator_environment_.set_input_source_identifiers(*input_source_identifiers);
-    }
-    if (event_type == event_type::key_down) {
-      if (auto set_variable = event.get_set_variable()) {
-        manipulator_environment_.set_variable(set_variable->first,
-                                              set_variable->second);
-      }
-    }
-    if (auto keyboard_type = event.get_keyboard_type()) {
-      manipulator_environment_.set_keyboard_type(*keyboard_type);
-    }
+    update_state(device_id, event, event_type);
   }
 
   void push_back_event(const queued_event& queued_event) {
@@ -844,6 +924,15 @@ public:
                        queued_event.get_lazy());
   }
 
+  // Update modifier_flag_manager, pointing_button_manager and manipulator_environment
+  // as if `queued_event` is pushed to this queue, without storing the event.
+  // (manipulator_managers_connector uses this method for stages which have no manipulators.)
+  void pass_through_event(const queued_event& queued_event) {
+    update_state(queued_event.get_device_id(),
+                 queued_event.get_event(),
+                 queued_event.get_event_type());
+  }
+
   void clear_events(void) {
     events_.clear();
     time_stamp_delay_ = 0;
@@ -854,7 +943,7 @@ public:
   }
 
   void erase_front_event(void) {
-    events_.erase(std::begin(events_));
+    events_.pop_front();
     if (events_.empty()) {
       time_stamp_delay_ = 0;
     }
@@ -864,7 +953,7 @@ public:
     return events_.empty();
   }
 
-  const std::vector<queued_event>& get_events(void) const {
+  const std::deque<queued_event>& get_events(void) const {
     return events_;
   }
 
@@ -988,20 +1077,82 @@ public:
   }
 
 private:
+  void update_state(device_id device_id,
+                    const queued_event::event& event,
+                    event_type event_type) {
+    // Update modifier_flag_manager
+
+    if (auto key_code = event.get_key_code()) {
+      if (auto modifier_flag = types::make_modifier_flag(*key_code)) {
+        auto type = (event_type == event_type::key_down ? modifier_flag_manager::active_modifier_flag::type::increase
+                                                        : modifier_flag_manager::active_modifier_flag::type::decrease);
+        modifier_flag_manager::active_modifier_flag active_modifier_flag(type,
+                                                                         *modifier_flag,
+                                                                         device_id);
+        modifier_flag_manager_.push_back_active_modifier_flag(active_modifier_flag);
+      }
+    }
+
+    if (event.get_type() == queued_event::event::type::caps_lock_state_changed) {
+      if (auto integer_value = event.get_integer_value()) {
+        auto type = (*integer_value ? modifier_flag_manager::active_modifier_flag::type::increase_lock
+                                    : modifier_flag_manager::active_modifier_flag::type::decrease_lock);
+        modifier_flag_manager::active_modifier_flag active_modifier_flag(type,
+                                                                         modifier_flag::caps_lock,
+                                                                         device_id);
+        modifier_flag_manager_.push_back_active_modifier_flag(active_modifier_flag);
+      }
+    }
+
+    // Update pointing_button_manager
+
+    if (auto pointing_button = event.get_pointing_button()) {
+      if (*pointing_button != pointing_button::zero) {
+        auto type = (event_type == event_type::key_down ? pointing_button_manager::active_pointing_button::type::increase
+                                                        : pointing_button_manager::active_pointing_button::type::decrease);
+        pointing_button_manager::active_pointing_button active_pointing_button(type,
+                                                                               *pointing_button,
+                                                                               device_id);
+        pointing_button_manager_.push_back_active_pointing_button(active_pointing_button);
+      }
+    }
+
+    // Update manipulator_environment
+    if (auto frontmost_application = event.get_frontmost_application()) {
+      manipulator_environment_.set_frontmost_application(*frontmost_application);
+    }
+    if (auto input_source_identifiers = event.get_input_source_identifiers()) {
+      manipulator_environment_.set_input_source_identifiers(*input_source_identifiers);
+    }
+    if (event_type == event_type::key_down) {
+      if (auto set_variable = event.get_set_variable()) {
+        manipulator_environment_.set_variable(set_variable->first,
+                                              set_variable->second);
+      }
+    }
+    if (auto keyboard_type = event.get_keyboard_type()) {
+      manipulator_environment_.set_keyboard_type(*keyboard_type);
+    }
+  }
+
   void sort_events(void) {
-    for (size_t i = 0; i < events_.size() - 1;) {
-      if (needs_swap(events_[i], events_[i + 1])) {
-        std::swap(events_[i], events_[i + 1]);
-        if (i > 0) {
-          --i;
-        }
-        continue;
+    // The events are always sorted before `emplace_back`.
+    // Thus, we only have to move the last event toward the front while `needs_swap` is true.
+    // (`needs_swap` returns true only for events which have the same time_stamp.)
+
+    if (events_.size() < 2) {
+      return;
+    }
+
+    for (size_t i = events_.size() - 1; i > 0; --i) {
+      if (!needs_swap(events_[i - 1], events_[i])) {
+        break;
       }
-      ++i;
+      std::swap(events_[i - 1], events_[i]);
     }
   }
 
-  std::vector<queued_event> events_;
+  std::deque<queued_event> events_;
   modifier_flag_manager modifier_flag_manager_;
   pointing_button_manager pointing_button_manager_;
   manipulator_environment manipulator_environment_;
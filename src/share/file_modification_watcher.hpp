@@ -0,0 +1,258 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "logger.hpp"
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __APPLE__
+#include "gcd_utility.hpp"
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <thread>
+#endif
+
+namespace krbn {
+// file_modification_watcher calls `callback` when the target files are appended, created, removed or renamed.
+//
+// FSEvents (file_monitor) notifies file changes only when the target file is just closed.
+// So, it is not usable for files which are kept opened and appended (e.g., log files).
+//
+// Backends:
+//   - vnode_file_modification_watcher (macOS): dispatch sources of kqueue vnode events. `callback` is called in the main queue.
+//   - inotify_file_modification_watcher (Linux): inotify. `callback` is called in the watcher thread. (for unit testing)
+
+class file_modification_watcher {
+public:
+  typedef std::function<void(void)> callback;
+
+  virtual ~file_modification_watcher(void) {
+  }
+
+  static std::unique_ptr<file_modification_watcher> make(const std::vector<std::string>& files,
+                                                         const callback& callback);
+};
+
+#ifdef __APPLE__
+
+class vnode_file_modification_watcher final : public file_modification_watcher {
+public:
+  vnode_file_modification_watcher(const vnode_file_modification_watcher&) = delete;
+
+  vnode_file_modification_watcher(const std::vector<std::string>& files,
+                                  const callback& callback) : files_(files),
+                                                              callback_(callback) {
+    gcd_utility::dispatch_sync_in_main_queue(^{
+      update_sources();
+    });
+  }
+
+  virtual ~vnode_file_modification_watcher(void) {
+    // Release sources in main thread to avoid callback invocations after object has been destroyed.
+    gcd_utility::dispatch_sync_in_main_queue(^{
+      for (const auto& it : sources_) {
+        dispatch_source_cancel(it.second);
+        dispatch_release(it.second);
+      }
+      sources_.clear();
+    });
+  }
+
+private:
+  // Watch the files and their parent directories.
+  // Directories are watched in order to observe that the files are created (e.g., after log rotation).
+  void update_sources(void) {
+    for (const auto& file : files_) {
+      add_source(file);
+      add_source(filesystem::dirname(file));
+    }
+  }
+
+  // `path` is passed by value since it is captured by the blocks.
+  void add_source(std::string path) {
+    if (sources_.find(path) != std::end(sources_)) {
+      return;
+    }
+
+    int fd = open(path.c_str(), O_EVTONLY);
+    if (fd < 0) {
+      return;
+    }
+
+    auto source = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE,
+                                         fd,
+                                         DISPATCH_VNODE_WRITE | DISPATCH_VNODE_EXTEND | DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME,
+                                         dispatch_get_main_queue());
+    if (!source) {
+      close(fd);
+      return;
+    }
+
+    dispatch_source_set_event_handler(source, ^{
+      if (dispatch_source_get_data(source) & (DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME)) {
+        // The file has been replaced.
+        remove_source(path);
+      }
+      update_sources();
+
+      if (callback_) {
+        callback_();
+      }
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+      close(fd);
+    });
+    dispatch_resume(source);
+
+    sources_[path] = source;
+  }
+
+  void remove_source(const std::string& path) {
+    auto it = sources_.find(path);
+    if (it != std::end(sources_)) {
+      dispatch_source_cancel(it->second);
+      dispatch_release(it->second);
+      sources_.erase(it);
+    }
+  }
+
+  std::vector<std::string> files_;
+  callback callback_;
+  std::unordered_map<std::string, dispatch_source_t> sources_;
+};
+
+inline std::unique_ptr<file_modification_watcher> file_modification_watcher::make(const std::vector<std::string>& files,
+                                                                                  const callback& callback) {
+  return std::make_unique<vnode_file_modification_watcher>(files, callback);
+}
+
+#endif
+
+#ifdef __linux__
+
+class inotify_file_modification_watcher final : public file_modification_watcher {
+public:
+  inotify_file_modification_watcher(const inotify_file_modification_watcher&) = delete;
+
+  inotify_file_modification_watcher(const std::vector<std::string>& files,
+                                    const callback& callback) : callback_(callback) {
+    stop_pipe_[0] = -1;
+    stop_pipe_[1] = -1;
+
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+      logger::get_logger().error("inotify_init1 error");
+      return;
+    }
+
+    if (pipe(stop_pipe_) != 0) {
+      logger::get_logger().error("pipe error");
+      return;
+    }
+
+    // Watch parent directories in order to follow file creation and renaming (e.g., log rotation).
+    for (const auto& file : files) {
+      auto directory = filesystem::dirname(file);
+      auto wd = inotify_add_watch(fd_,
+                                  directory.c_str(),
+                                  IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+      if (wd < 0) {
+        logger::get_logger().warn("inotify_add_watch error: {0}", directory);
+        continue;
+      }
+
+      auto pos = file.find_last_of('/');
+      names_[wd].insert(pos == std::string::npos ? file : file.substr(pos + 1));
+    }
+
+    thread_ = std::thread([this] { worker(); });
+  }
+
+  virtual ~inotify_file_modification_watcher(void) {
+    if (thread_.joinable()) {
+      char c = 0;
+      write(stop_pipe_[1], &c, 1);
+      thread_.join();
+    }
+
+    for (auto fd : {fd_, stop_pipe_[0], stop_pipe_[1]}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+private:
+  void worker(void) {
+    std::vector<uint8_t> buffer(64 * 1024);
+
+    for (;;) {
+      struct pollfd fds[2];
+      fds[0].fd = fd_;
+      fds[0].events = POLLIN;
+      fds[1].fd = stop_pipe_[0];
+      fds[1].events = POLLIN;
+
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return;
+      }
+
+      if (fds[1].revents) {
+        return;
+      }
+
+      // Read all pending events and call `callback_` once.
+      bool modified = false;
+      for (;;) {
+        auto n = read(fd_, &(buffer[0]), buffer.size());
+        if (n <= 0) {
+          break;
+        }
+
+        for (ssize_t offset = 0; offset < n;) {
+          auto event = reinterpret_cast<const struct inotify_event*>(&(buffer[offset]));
+          if (event->len > 0) {
+            auto it = names_.find(event->wd);
+            if (it != std::end(names_) &&
+                it->second.find(event->name) != std::end(it->second)) {
+              modified = true;
+            }
+          }
+          offset += sizeof(struct inotify_event) + event->len;
+        }
+      }
+
+      if (modified && callback_) {
+        callback_();
+      }
+    }
+  }
+
+  callback callback_;
+  int fd_;
+  int stop_pipe_[2];
+  // watch descriptor -> file names
+  std::unordered_map<int, std::unordered_set<std::string>> names_;
+  std::thread thread_;
+};
+
+inline std::unique_ptr<file_modification_watcher> file_modification_watcher::make(const std::vector<std::string>& files,
+                                                                                  const callback& callback) {
+  return std::make_unique<inotify_file_modification_watcher>(files, callback);
+}
+
+#endif
+} // namespace krbn
@@ -4,6 +4,7 @@
 #include "filesystem.hpp"
 #include "local_datagram_client.hpp"
 #include "logger.hpp"
+#include "operation_message.hpp"
 #include "session.hpp"
 #include "types.hpp"
 #include <unistd.h>
@@ -33,57 +34,47 @@ public:
   }
 
   void connect(void) {
-    operation_type_connect_struct s;
-    s.pid = getpid();
-    client_->send_to(reinterpret_cast<uint8_t*>(&s), sizeof(s));
+    operation_message::writer writer;
+    writer.begin_message(operation_type::connect);
+    writer.write_uint32(static_cast<uint32_t>(getpid()));
+    writer.write_string(constants::get_user_core_configuration_file_path());
+    send(writer);
   }
 
   void system_preferences_values_updated(const system_preferences::values& values) {
-    operation_type_system_preferences_values_updated_struct s;
-    s.values = values;
-    client_->send_to(reinterpret_cast<uint8_t*>(&s), sizeof(s));
+    operation_message::writer writer;
+    writer.begin_message(operation_type::system_preferences_values_updated);
+    writer.write_uint8(values.get_keyboard_fn_state());
+    send(writer);
   }
 
   void frontmost_application_changed(const std::string& bundle_identifier,
                                      const std::string& file_path) {
-    operation_type_frontmost_application_changed_struct s;
-
-    strlcpy(s.bundle_identifier,
-            bundle_identifier.c_str(),
-            sizeof(s.bundle_identifier));
-
-    strlcpy(s.file_path,
-            file_path.c_str(),
-            sizeof(s.file_path));
-
-    client_->send_to(reinterpret_cast<uint8_t*>(&s), sizeof(s));
+    operation_message::writer writer;
+    writer.begin_message(operation_type::frontmost_application_changed);
+    writer.write_string(bundle_identifier);
+    writer.write_string(file_path);
+    send(writer);
   }
 
   void input_source_changed(const input_source_identifiers& input_source_identifiers) {
-    operation_type_input_source_changed_struct s;
-
-    if (auto& v = input_source_identifiers.get_language()) {
-      strlcpy(s.language,
-              v->c_str(),
-              sizeof(s.language));
-    }
-
-    if (auto& v = input_source_identifiers.get_input_source_id()) {
-      strlcpy(s.input_source_id,
-              v->c_str(),
-              sizeof(s.input_source_id));
-    }
+    operation_message::writer writer;
+    writer.begin_message(operation_type::input_source_changed);
+    writer.write_string(input_source_identifiers.get_language().value_or(""));
+    writer.write_string(input_source_identifiers.get_input_source_id().value_or(""));
+    writer.write_string(input_source_identifiers.get_input_mode_id().value_or(""));
+    send(writer);
+  }
 
-    if (auto& v = input_source_identifiers.get_input_mode_id()) {
-      strlcpy(s.input_mode_id,
-              v->c_str(),
-              sizeof(s.input_mode_id));
+private:
+  void send(operation_message::writer& writer) {
+    if (writer.end_message()) {
+      client_->send_to(writer.get_buffer());
+    } else {
+      logger::get_logger().error("grabber_client: message is too long");
     }
-
-    client_->send_to(reinterpret_cast<uint8_t*>(&s), sizeof(s));
   }
 
-private:
   std::unique_ptr<local_datagram_client> client_;
 };
 } // namespace krbn
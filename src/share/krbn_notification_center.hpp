@@ -11,15 +11,8 @@ public:
   };
 
   static core& get_instance(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::unique_ptr<core> core_;
-    if (!core_) {
-      core_ = std::make_unique<core>();
-    }
-
-    return *core_;
+    static core core_;
+    return core_;
   }
 };
 } // namespace krbn
@@ -1,11 +1,23 @@
 #pragma once
 
+#include "boost_defs.hpp"
+
+BEGIN_BOOST_INCLUDE
+#include <boost/circular_buffer.hpp>
+END_BOOST_INCLUDE
+
+#include "file_modification_watcher.hpp"
 #include "filesystem.hpp"
-#include "gcd_utility.hpp"
+#include "mapped_file.hpp"
 #include "spdlog_utility.hpp"
-#include <deque>
-#include <fstream>
-#include <thread>
+#include <algorithm>
+#include <fcntl.h>
+#include <mutex>
+#include <queue>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
 namespace krbn {
@@ -13,175 +25,215 @@ class log_monitor final {
 public:
   typedef std::function<void(const std::string& line)> new_log_line_callback;
 
+  typedef std::function<std::unique_ptr<file_modification_watcher>(const std::vector<std::string>& files,
+                                                                   const file_modification_watcher::callback& callback)>
+      watcher_factory;
+
   log_monitor(const log_monitor&) = delete;
 
-  // FSEvents (file_monitor) notifies file changes only when the target file is just closed.
-  // So, it is not usable for log_monitor since spdlog keeps opening log files and appending lines.
+  // Appended lines are read when file_modification_watcher notifies file changes.
+  // Each log file is sorted by time, so lines from files are merged without sorting all lines.
   //
-  // We use timer to observe file changes instead.
+  // `watcher_factory` is replaceable for unit testing.
 
   log_monitor(const std::vector<std::string>& targets,
-              const new_log_line_callback& callback) : callback_(callback), timer_count_(timer_count(0)) {
+              const new_log_line_callback& callback,
+              const watcher_factory& watcher_factory = file_modification_watcher::make) : callback_(callback),
+                                                                                          watcher_factory_(watcher_factory) {
     // setup initial_lines_
 
+    std::vector<std::string> initial_files;
     for (const auto& target : targets) {
-      add_initial_lines(target + ".1");
-      add_initial_lines(target);
+      initial_files.push_back(target + ".1");
+      initial_files.push_back(target);
 
       files_.push_back(target);
     }
+
+    add_initial_lines(initial_files);
   }
 
   ~log_monitor(void) {
-    timer_ = nullptr;
+    watcher_ = nullptr;
   }
 
   void start(void) {
-    timer_ = std::make_unique<gcd_utility::main_queue_timer>(
-        dispatch_time(DISPATCH_TIME_NOW, 1.0 * NSEC_PER_SEC),
-        1.0 * NSEC_PER_SEC,
-        0,
-        ^{
-          timer_count_ = timer_count(static_cast<uint64_t>(timer_count_) + 1);
-          for (const auto& file : files_) {
-            if (auto size = filesystem::file_size(file)) {
-              auto it = read_position_.find(file);
-              if (it != read_position_.end()) {
-                if (it->second != *size) {
-                  add_lines(file);
-                }
-              }
-            }
-          }
-          call_callback();
-        });
+    watcher_ = watcher_factory_(files_,
+                                [this] {
+                                  add_lines();
+                                });
+
+    // Read lines which are appended before the watcher is started.
+    add_lines();
   }
 
   const std::vector<std::pair<uint64_t, std::string>>& get_initial_lines(void) const {
     return initial_lines_;
   }
 
+  static size_t get_max_initial_lines(void) {
+    return 250;
+  }
+
 private:
-  enum class timer_count : uint64_t {};
-
-  void add_initial_lines(const std::string& file_path) {
-    std::ifstream stream(file_path);
-    std::string line;
-    std::streampos read_position;
-
-    while (std::getline(stream, line)) {
-      if (add_initial_line(line)) {
-        const size_t max_initial_lines = 250;
-        while (initial_lines_.size() > max_initial_lines) {
-          initial_lines_.erase(initial_lines_.begin());
-        }
-      }
-      read_position = stream.tellg();
+  typedef std::pair<uint64_t, std::string> sorted_line;
+
+  void add_initial_lines(const std::vector<std::string>& file_paths) {
+    // Read only the last lines of each file.
+    std::vector<std::vector<sorted_line>> streams(file_paths.size());
+    for (size_t i = 0; i < file_paths.size(); ++i) {
+      read_last_lines(file_paths[i], get_max_initial_lines(), streams[i]);
     }
 
-    read_position_[file_path] = read_position;
+    boost::circular_buffer<sorted_line> lines(get_max_initial_lines());
+    merge(streams,
+          [&](const sorted_line& line) {
+            lines.push_back(line);
+          });
+
+    initial_lines_.assign(std::begin(lines), std::end(lines));
   }
 
-  bool add_initial_line(const std::string& line) {
-    if (auto sort_key = spdlog_utility::get_sort_key(line)) {
-      if (initial_lines_.empty()) {
-        initial_lines_.push_back(std::make_pair(*sort_key, line));
-        return true;
-      }
+  // This method is called in `start` and the watcher's callback.
+  void add_lines(void) {
+    std::lock_guard<std::mutex> lock(mutex_);
 
-      if (*sort_key < initial_lines_.front().first) {
-        // line is too old
-        return false;
-      }
+    std::vector<std::vector<sorted_line>> streams(files_.size());
+    for (size_t i = 0; i < files_.size(); ++i) {
+      read_lines(files_[i], streams[i]);
+    }
+
+    merge(streams,
+          [&](const sorted_line& line) {
+            if (callback_) {
+              callback_(line.second);
+            }
+          });
+  }
+
+  // Read the last `count` lines by scanning the mapped file backwards from the end.
+  // Only the last pages of the file are touched, so the cost does not depend on the file size.
+  //
+  // mapped_file is used only for this one-shot read at construction.
+  // (Log files are rotated by rename, not truncated. See `read_lines` for files which are followed.)
+  void read_last_lines(const std::string& file_path, size_t count, std::vector<sorted_line>& lines) {
+    mapped_file file(file_path);
+    if (!file.get_data()) {
+      return;
+    }
+
+    auto data = file.get_data();
+
+    // Skip the unterminated last line. (It is read by `read_lines` after it is terminated.)
+    size_t end = file.get_size();
+    while (end > 0 && data[end - 1] != '\n') {
+      --end;
+    }
+
+    read_position_[file_path] = end;
 
-      if (*sort_key > initial_lines_.back().first) {
-        initial_lines_.push_back(std::make_pair(*sort_key, line));
-        return true;
+    // `end` points the next of newline.
+    while (end > 0 && lines.size() < count) {
+      auto line_end = end - 1;
+      auto line_begin = line_end;
+      while (line_begin > 0 && data[line_begin - 1] != '\n') {
+        --line_begin;
       }
 
-      for (auto it = initial_lines_.begin(); it != initial_lines_.end(); ++it) {
-        if (*sort_key < it->first) {
-          initial_lines_.insert(it, std::make_pair(*sort_key, line));
-          return true;
-        }
+      if (auto sort_key = spdlog_utility::get_sort_key(data + line_begin, line_end - line_begin)) {
+        lines.push_back(std::make_pair(*sort_key, std::string(data + line_begin, line_end - line_begin)));
       }
 
-      initial_lines_.push_back(std::make_pair(*sort_key, line));
-      return true;
+      end = line_begin;
     }
 
-    return false;
+    std::reverse(std::begin(lines), std::end(lines));
   }
 
-  void add_lines(const std::string& file_path) {
-    std::ifstream stream(file_path);
-    if (!stream) {
+  // Read lines which are appended after the last read position.
+  // The last line is not read until it is terminated with newline since the writer might be writing it.
+  //
+  // We use pread instead of mapped_file since the followed file might be truncated while it is read.
+  // (Accessing truncated pages of mapped file raises SIGBUS. pread just returns fewer bytes.)
+  void read_lines(const std::string& file_path, std::vector<sorted_line>& lines) {
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
       return;
     }
 
-    // ----------------------------------------
-    // seek
+    struct stat s;
+    if (fstat(fd, &s) == 0 && S_ISREG(s.st_mode)) {
+      auto size = static_cast<size_t>(s.st_size);
 
-    auto it = read_position_.find(file_path);
-    if (it != read_position_.end()) {
-      if (auto size = filesystem::file_size(file_path)) {
-        if (it->second < *size) {
-          stream.seekg(it->second);
-        }
+      auto& read_position = read_position_[file_path];
+      if (size < read_position) {
+        // The file has been replaced or truncated. (e.g., log rotation)
+        read_position = 0;
       }
-    }
-
-    // ----------------------------------------
-    // read
 
-    std::string line;
-    std::streampos read_position;
-    while (std::getline(stream, line)) {
-      if (auto sort_key = spdlog_utility::get_sort_key(line)) {
-        added_lines_.push_back(std::make_tuple(timer_count_, *sort_key, line));
+      // Read the appended bytes. (The file might be truncated after fstat.)
+      read_buffer_.resize(size - read_position);
+      size_t n = 0;
+      while (n < read_buffer_.size()) {
+        auto r = pread(fd, &(read_buffer_[n]), read_buffer_.size() - n, read_position + n);
+        if (r <= 0) {
+          break;
+        }
+        n += r;
       }
-      read_position = stream.tellg();
-    }
-
-    read_position_[file_path] = read_position;
 
-    // ----------------------------------------
-    // sort
+      auto p = read_buffer_.data();
+      auto scanned = spdlog_utility::scan_sort_keys(p,
+                                                    n,
+                                                    [&](size_t offset, size_t length, uint64_t sort_key) {
+                                                      lines.push_back(std::make_pair(sort_key, std::string(p + offset, length)));
+                                                    });
+      read_position += scanned;
+    }
 
-    std::stable_sort(added_lines_.begin(), added_lines_.end(), [](const auto& a, const auto& b) {
-      return std::get<1>(a) < std::get<1>(b);
-    });
+    close(fd);
   }
 
-  void call_callback(void) {
-    while (true) {
-      if (added_lines_.empty()) {
-        return;
+  // k-way merge of sorted streams.
+  // Lines which have the same sort key are ordered by the order of streams.
+  template <typename T>
+  static void merge(const std::vector<T>& streams,
+                    const std::function<void(const sorted_line&)>& callback) {
+    // (sort_key, stream index, position in stream)
+    typedef std::tuple<uint64_t, size_t, size_t> head;
+    std::priority_queue<head, std::vector<head>, std::greater<head>> heads;
+
+    for (size_t i = 0; i < streams.size(); ++i) {
+      if (!streams[i].empty()) {
+        heads.emplace(streams[i][0].first, i, 0);
       }
+    }
 
-      auto front = added_lines_.front();
+    while (!heads.empty()) {
+      auto h = heads.top();
+      heads.pop();
 
-      if (std::get<0>(front) != timer_count_) {
-        // Wait if front is just added.
-        return;
-      }
+      auto& stream = streams[std::get<1>(h)];
+      auto position = std::get<2>(h);
+      callback(stream[position]);
 
-      if (callback_) {
-        callback_(std::get<2>(front));
+      ++position;
+      if (position < stream.size()) {
+        heads.emplace(stream[position].first, std::get<1>(h), position);
       }
-
-      added_lines_.pop_front();
     }
   }
 
   new_log_line_callback callback_;
+  watcher_factory watcher_factory_;
 
-  std::unique_ptr<gcd_utility::main_queue_timer> timer_;
-  timer_count timer_count_;
+  std::unique_ptr<file_modification_watcher> watcher_;
+  std::mutex mutex_;
 
   std::vector<std::pair<uint64_t, std::string>> initial_lines_;
-  std::unordered_map<std::string, std::streampos> read_position_;
+  std::unordered_map<std::string, size_t> read_position_;
+  // The buffer of `read_lines`. (guarded by mutex_)
+  std::vector<char> read_buffer_;
   std::vector<std::string> files_;
-  std::deque<std::tuple<timer_count, uint64_t, std::string>> added_lines_;
 };
 } // namespace krbn
@@ -1,12 +1,18 @@
 #pragma once
 
-#include "filesystem.hpp"
+#include "boost_defs.hpp"
+
+#include "async_json_file_writer.hpp"
 #include "logger.hpp"
 #include "types.hpp"
-#include <fstream>
+#include "variable_name_table.hpp"
+#include <atomic>
+#include <boost/optional.hpp>
 #include <iostream>
 #include <json/json.hpp>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace krbn {
 class manipulator_environment final {
@@ -76,24 +82,40 @@ public:
 
   manipulator_environment(const manipulator_environment&) = delete;
 
-  manipulator_environment(void) {
+  manipulator_environment(void) : frontmost_application_generation_(make_generation()),
+                                  input_source_identifiers_generation_(make_generation()),
+                                  variables_generation_(make_generation()),
+                                  keyboard_type_generation_(make_generation()),
+                                  json_file_writer_(std::chrono::milliseconds(100),
+                                                    [this] {
+                                                      std::lock_guard<std::mutex> lock(mutex_);
+
+                                                      return to_json();
+                                                    }) {
   }
 
   nlohmann::json to_json(void) const {
     return nlohmann::json({
         {"frontmost_application", frontmost_application_.to_json()},
         {"input_source_identifiers", input_source_identifiers_.to_json()},
-        {"variables", variables_},
+        {"variables", variables_to_json()},
         {"keyboard_type", keyboard_type_},
     });
   }
 
+  // The json file is written asynchronously in order to avoid file system access in the key event handling.
   void enable_json_output(const std::string& output_json_file_path) {
-    output_json_file_path_ = output_json_file_path;
+    json_file_writer_.enable(output_json_file_path);
+    json_file_writer_.mark_dirty();
   }
 
   void disable_json_output(void) {
-    output_json_file_path_.clear();
+    json_file_writer_.disable();
+  }
+
+  // For unit testing
+  void flush_json_output(void) {
+    json_file_writer_.flush();
   }
 
   const frontmost_application& get_frontmost_application(void) const {
@@ -101,8 +123,21 @@ public:
   }
 
   void set_frontmost_application(const frontmost_application& value) {
-    frontmost_application_ = value;
-    save_to_file();
+    if (frontmost_application_ == value) {
+      return;
+    }
+
+    {
+      auto lock = make_values_lock();
+
+      frontmost_application_ = value;
+    }
+    frontmost_application_generation_ = make_generation();
+    json_file_writer_.mark_dirty();
+  }
+
+  uint64_t get_frontmost_application_generation(void) const {
+    return frontmost_application_generation_;
   }
 
   const input_source_identifiers& get_input_source_identifiers(void) const {
@@ -110,22 +145,65 @@ public:
   }
 
   void set_input_source_identifiers(const input_source_identifiers& value) {
-    input_source_identifiers_ = value;
-    save_to_file();
+    if (input_source_identifiers_ == value) {
+      return;
+    }
+
+    {
+      auto lock = make_values_lock();
+
+      input_source_identifiers_ = value;
+    }
+    input_source_identifiers_generation_ = make_generation();
+    json_file_writer_.mark_dirty();
+  }
+
+  uint64_t get_input_source_identifiers_generation(void) const {
+    return input_source_identifiers_generation_;
+  }
+
+  int get_variable(variable_id id) const {
+    auto index = static_cast<size_t>(id);
+    if (index < variables_.size()) {
+      if (auto& v = variables_[index]) {
+        return *v;
+      }
+    }
+    return 0;
   }
 
   int get_variable(const std::string& name) const {
-    auto it = variables_.find(name);
-    if (it != std::end(variables_)) {
-      return it->second;
+    if (auto id = variable_name_table::get_instance().find(name)) {
+      return get_variable(*id);
     }
     return 0;
   }
 
+  void set_variable(variable_id id, int value) {
+    // logger::get_logger().info("set_variable {0} {1}", variable_name_table::get_instance().get_name(id), value);
+    auto index = static_cast<size_t>(id);
+    if (index < variables_.size() && variables_[index] == value) {
+      return;
+    }
+
+    {
+      auto lock = make_values_lock();
+
+      if (index >= variables_.size()) {
+        variables_.resize(index + 1);
+      }
+      variables_[index] = value;
+    }
+    variables_generation_ = make_generation();
+    json_file_writer_.mark_dirty();
+  }
+
   void set_variable(const std::string& name, int value) {
-    // logger::get_logger().info("set_variable {0} {1}", name, value);
-    variables_[name] = value;
-    save_to_file();
+    set_variable(variable_name_table::get_instance().intern(name), value);
+  }
+
+  uint64_t get_variables_generation(void) const {
+    return variables_generation_;
   }
 
   const std::string& get_keyboard_type(void) const {
@@ -133,29 +211,67 @@ public:
   }
 
   void set_keyboard_type(const std::string& value) {
-    keyboard_type_ = value;
-    save_to_file();
+    if (keyboard_type_ == value) {
+      return;
+    }
+
+    {
+      auto lock = make_values_lock();
+
+      keyboard_type_ = value;
+    }
+    keyboard_type_generation_ = make_generation();
+    json_file_writer_.mark_dirty();
+  }
+
+  uint64_t get_keyboard_type_generation(void) const {
+    return keyboard_type_generation_;
   }
 
 private:
-  void save_to_file(void) const {
-    if (!output_json_file_path_.empty()) {
-      filesystem::create_directory_with_intermediate_directories(filesystem::dirname(output_json_file_path_), 0755);
+  // Generations are changed when the values are changed.
+  // They are unique among all manipulator_environment instances,
+  // so conditions can cache their results with the generation instead of copies of the values.
+  static uint64_t make_generation(void) {
+    static std::atomic<uint64_t> last_generation(0);
+    return ++last_generation;
+  }
 
-      std::ofstream output(output_json_file_path_);
-      if (output) {
-        output << std::setw(4) << to_json() << std::endl;
-      } else {
-        logger::get_logger().warn("Failed to open {0}", output_json_file_path_);
+  // The values are read from the background thread only while the json output is enabled.
+  // Thus, the setters do not take the lock while the json output is disabled.
+  std::unique_lock<std::mutex> make_values_lock(void) {
+    if (json_file_writer_.is_enabled()) {
+      return std::unique_lock<std::mutex>(mutex_);
+    }
+    return std::unique_lock<std::mutex>(mutex_, std::defer_lock);
+  }
+
+  nlohmann::json variables_to_json(void) const {
+    auto json = nlohmann::json::object();
+    for (size_t i = 0; i < variables_.size(); ++i) {
+      if (auto& v = variables_[i]) {
+        json[variable_name_table::get_instance().get_name(variable_id(i))] = *v;
       }
     }
+    return json;
   }
 
-  std::string output_json_file_path_;
+  // mutex_ guards the values while json_file_writer_ reads them in the background thread. (See `make_values_lock`.)
+  // (The values are modified only in the main thread.)
+  std::mutex mutex_;
   frontmost_application frontmost_application_;
   input_source_identifiers input_source_identifiers_;
-  std::unordered_map<std::string, int> variables_;
+  // Indexed by variable_id. (boost::none if the variable is not set.)
+  std::vector<boost::optional<int>> variables_;
   std::string keyboard_type_;
+
+  uint64_t frontmost_application_generation_;
+  uint64_t input_source_identifiers_generation_;
+  uint64_t variables_generation_;
+  uint64_t keyboard_type_generation_;
+
+  // json_file_writer_ should be destroyed first since it calls `to_json` at destruction.
+  async_json_file_writer json_file_writer_;
 };
 
 inline std::ostream& operator<<(std::ostream& stream, const manipulator_environment::frontmost_application& value) {
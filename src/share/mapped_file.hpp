@@ -0,0 +1,67 @@
+#pragma once
+
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace krbn {
+// mapped_file maps a whole file into memory as read-only.
+//
+// Note:
+// Pages are loaded on access, so only touched pages cost I/O.
+// Do not use mapped_file for files which might be truncated while mapped. (Accessing truncated pages raises SIGBUS.)
+// Appending to the file (e.g., log files) is safe; the appended bytes are just not visible.
+
+class mapped_file final {
+public:
+  mapped_file(const mapped_file&) = delete;
+
+  mapped_file(const std::string& path) : data_(nullptr),
+                                         size_(0) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+
+    struct stat s;
+    if (fstat(fd, &s) == 0 && S_ISREG(s.st_mode) && s.st_size > 0) {
+      auto p = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        data_ = static_cast<const char*>(p);
+        size_ = s.st_size;
+      }
+    }
+
+    // The mapping is kept after the file descriptor is closed.
+    close(fd);
+  }
+
+  ~mapped_file(void) {
+    if (data_) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  // Returns nullptr if the file is not found or empty.
+  const char* _Nullable get_data(void) const {
+    return data_;
+  }
+
+  size_t get_size(void) const {
+    return size_;
+  }
+
+  // Tell the kernel the access pattern. (e.g., MADV_SEQUENTIAL)
+  void advise(int advice) const {
+    if (data_) {
+      madvise(const_cast<char*>(data_), size_, advice);
+    }
+  }
+
+private:
+  const char* _Nullable data_;
+  size_t size_;
+};
+} // namespace krbn
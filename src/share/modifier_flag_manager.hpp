@@ -1,7 +1,10 @@
 #pragma once
 
 #include "types.hpp"
+#include <array>
+#include <cstdlib>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace krbn {
@@ -75,83 +78,122 @@ public:
     device_id device_id_;
   };
 
-  const std::vector<active_modifier_flag>& get_active_modifier_flags(void) const {
-    return active_modifier_flags_;
+  modifier_flag_manager(void) : totals_{} {
+  }
+
+  // Note:
+  // This method is slow since it reconstructs active_modifier_flags from counters.
+  // Use `is_pressed` or `get_pressed_modifier_flags` in the event processing.
+  std::vector<active_modifier_flag> get_active_modifier_flags(void) const {
+    std::vector<active_modifier_flag> active_modifier_flags;
+
+    for (const auto& pair : counters_) {
+      for (size_t i = 0; i < modifier_flag_count; ++i) {
+        auto flag = static_cast<modifier_flag>(i);
+        auto count = pair.second.count[i];
+        auto type = (count > 0 ? active_modifier_flag::type::increase : active_modifier_flag::type::decrease);
+        for (int j = 0; j < std::abs(count); ++j) {
+          active_modifier_flags.emplace_back(type, flag, pair.first);
+        }
+        for (int j = 0; j < pair.second.lock_count[i]; ++j) {
+          active_modifier_flags.emplace_back(active_modifier_flag::type::increase_lock, flag, pair.first);
+        }
+      }
+    }
+
+    return active_modifier_flags;
   }
 
   void push_back_active_modifier_flag(const active_modifier_flag& flag) {
+    auto i = static_cast<size_t>(flag.get_modifier_flag());
+    if (i >= modifier_flag_count) {
+      return;
+    }
+
+    auto& c = counters_[flag.get_device_id()];
+
     switch (flag.get_type()) {
       case active_modifier_flag::type::increase:
       case active_modifier_flag::type::decrease:
+        // type::increase and type::decrease cancel each other.
+        c.count[i] += flag.get_count();
+        totals_[i] += flag.get_count();
+        break;
+
       case active_modifier_flag::type::increase_lock:
-        active_modifier_flags_.push_back(flag);
-        erase_pairs();
+        ++(c.lock_count[i]);
+        ++(totals_[i]);
         break;
 
       case active_modifier_flag::type::decrease_lock:
         // Remove all type::increase_lock
-        active_modifier_flags_.erase(std::remove_if(std::begin(active_modifier_flags_),
-                                                    std::end(active_modifier_flags_),
-                                                    [&](auto& f) {
-                                                      return f.is_paired(flag);
-                                                    }),
-                                     std::end(active_modifier_flags_));
+        totals_[i] -= c.lock_count[i];
+        c.lock_count[i] = 0;
         break;
     }
+
+    update_pressed_modifier_flags(i);
   }
 
   void erase_all_active_modifier_flags(device_id device_id) {
-    active_modifier_flags_.erase(std::remove_if(std::begin(active_modifier_flags_),
-                                                std::end(active_modifier_flags_),
-                                                [&](const active_modifier_flag& f) {
-                                                  return f.get_device_id() == device_id;
-                                                }),
-                                 std::end(active_modifier_flags_));
+    auto it = counters_.find(device_id);
+    if (it != std::end(counters_)) {
+      for (size_t i = 0; i < modifier_flag_count; ++i) {
+        totals_[i] -= it->second.count[i] + it->second.lock_count[i];
+        update_pressed_modifier_flags(i);
+      }
+      counters_.erase(it);
+    }
   }
 
   void erase_all_active_modifier_flags_except_lock(device_id device_id) {
-    active_modifier_flags_.erase(std::remove_if(std::begin(active_modifier_flags_),
-                                                std::end(active_modifier_flags_),
-                                                [&](const active_modifier_flag& f) {
-                                                  return f.get_device_id() == device_id &&
-                                                         (f.get_type() != active_modifier_flag::type::increase_lock &&
-                                                          f.get_type() != active_modifier_flag::type::decrease_lock);
-                                                }),
-                                 std::end(active_modifier_flags_));
+    auto it = counters_.find(device_id);
+    if (it != std::end(counters_)) {
+      for (size_t i = 0; i < modifier_flag_count; ++i) {
+        totals_[i] -= it->second.count[i];
+        it->second.count[i] = 0;
+        update_pressed_modifier_flags(i);
+      }
+    }
   }
 
   void reset(void) {
-    active_modifier_flags_.clear();
+    counters_.clear();
+    totals_.fill(0);
+    pressed_modifier_flags_ = modifier_flag_mask();
   }
 
   bool is_pressed(modifier_flag modifier_flag) const {
-    int count = 0;
-
-    for (const auto& f : active_modifier_flags_) {
-      if (f.get_modifier_flag() == modifier_flag) {
-        count += f.get_count();
-      }
-    }
+    return pressed_modifier_flags_.contains(modifier_flag);
+  }
 
-    return count > 0;
+  const modifier_flag_mask& get_pressed_modifier_flags(void) const {
+    return pressed_modifier_flags_;
   }
 
 private:
-  void erase_pairs(void) {
-    for (size_t i1 = 0; i1 < active_modifier_flags_.size(); ++i1) {
-      for (size_t i2 = i1 + 1; i2 < active_modifier_flags_.size(); ++i2) {
-        if (active_modifier_flags_[i1].is_paired(active_modifier_flags_[i2])) {
-          active_modifier_flags_.erase(std::begin(active_modifier_flags_) + i2);
-          active_modifier_flags_.erase(std::begin(active_modifier_flags_) + i1);
-          if (i1 > 0) {
-            --i1;
-          }
-          break;
-        }
-      }
+  static constexpr size_t modifier_flag_count = static_cast<size_t>(modifier_flag::end_);
+  struct counter final {
+    counter(void) : count{},
+                    lock_count{} {
+    }
+
+    // The sum of type::increase (+1) and type::decrease (-1).
+    std::array<int, modifier_flag_count> count;
+    // The number of type::increase_lock.
+    std::array<int, modifier_flag_count> lock_count;
+  };
+
+  void update_pressed_modifier_flags(size_t i) {
+    if (totals_[i] > 0) {
+      pressed_modifier_flags_.insert(modifier_flag(i));
+    } else {
+      pressed_modifier_flags_.erase(modifier_flag(i));
     }
   }
 
-  std::vector<active_modifier_flag> active_modifier_flags_;
+  std::unordered_map<device_id, counter> counters_;
+  std::array<int, modifier_flag_count> totals_;
+  modifier_flag_mask pressed_modifier_flags_;
 };
 } // namespace krbn
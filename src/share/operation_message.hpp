@@ -0,0 +1,223 @@
+#pragma once
+
+#include "boost_defs.hpp"
+
+#include "logger.hpp"
+#include "types.hpp"
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace krbn {
+// operation_message is the datagram format between karabiner_console_user_server and karabiner_grabber.
+//
+// datagram:
+//   magic ('k', 'r') | version (uint8) | message count (uint16) | message | message | ...
+//
+// message:
+//   operation_type (uint8) | payload length (uint16) | payload
+//
+// Integers are little-endian.
+// Strings are stored as length (uint16) and bytes (without null terminator).
+// Messages which have unknown operation_type are skipped by the payload length.
+// The message count detects datagrams which are truncated at a message boundary.
+
+class operation_message final {
+public:
+  static uint8_t get_version(void) {
+    return 1;
+  }
+
+  static size_t get_header_size(void) {
+    return 5;
+  }
+
+  class writer final {
+  public:
+    writer(void) : message_offset_(0),
+                   message_count_(0) {
+      clear();
+    }
+
+    void clear(void) {
+      buffer_.clear();
+      buffer_.push_back('k');
+      buffer_.push_back('r');
+      buffer_.push_back(get_version());
+      // Message count is set in `end_message`.
+      buffer_.push_back(0);
+      buffer_.push_back(0);
+      message_count_ = 0;
+    }
+
+    const std::vector<uint8_t>& get_buffer(void) const {
+      return buffer_;
+    }
+
+    size_t get_message_count(void) const {
+      return message_count_;
+    }
+
+    void begin_message(operation_type operation_type) {
+      message_offset_ = buffer_.size();
+      buffer_.push_back(static_cast<uint8_t>(operation_type));
+      // Payload length is set in `end_message`.
+      buffer_.push_back(0);
+      buffer_.push_back(0);
+    }
+
+    // Returns false and discards the message if the payload is too long or there are too many messages.
+    bool end_message(void) {
+      auto length = buffer_.size() - message_offset_ - 3;
+      if (length > 0xffff || message_count_ >= 0xffff) {
+        buffer_.resize(message_offset_);
+        return false;
+      }
+
+      buffer_[message_offset_ + 1] = static_cast<uint8_t>(length & 0xff);
+      buffer_[message_offset_ + 2] = static_cast<uint8_t>((length >> 8) & 0xff);
+      ++message_count_;
+      buffer_[3] = static_cast<uint8_t>(message_count_ & 0xff);
+      buffer_[4] = static_cast<uint8_t>((message_count_ >> 8) & 0xff);
+      return true;
+    }
+
+    void write_uint8(uint8_t value) {
+      buffer_.push_back(value);
+    }
+
+    void write_uint32(uint32_t value) {
+      for (int i = 0; i < 4; ++i) {
+        buffer_.push_back(static_cast<uint8_t>((value >> (i * 8)) & 0xff));
+      }
+    }
+
+    void write_uint64(uint64_t value) {
+      for (int i = 0; i < 8; ++i) {
+        buffer_.push_back(static_cast<uint8_t>((value >> (i * 8)) & 0xff));
+      }
+    }
+
+    // Strings which are longer than 0xffff bytes are truncated.
+    void write_string(const std::string& value) {
+      auto length = std::min(value.length(), static_cast<size_t>(0xffff));
+      buffer_.push_back(static_cast<uint8_t>(length & 0xff));
+      buffer_.push_back(static_cast<uint8_t>((length >> 8) & 0xff));
+      buffer_.insert(std::end(buffer_), std::begin(value), std::begin(value) + length);
+    }
+
+  private:
+    std::vector<uint8_t> buffer_;
+    size_t message_offset_;
+    size_t message_count_;
+  };
+
+  // reader reads values from a payload.
+  // Methods return boost::none if the payload is too short.
+  class reader final {
+  public:
+    reader(const uint8_t* p, size_t length) : p_(p),
+                                              length_(length),
+                                              offset_(0) {
+    }
+
+    boost::optional<uint8_t> read_uint8(void) {
+      if (length_ - offset_ < 1) {
+        return boost::none;
+      }
+      return p_[offset_++];
+    }
+
+    boost::optional<uint32_t> read_uint32(void) {
+      if (length_ - offset_ < 4) {
+        return boost::none;
+      }
+      uint32_t value = 0;
+      for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(p_[offset_++]) << (i * 8);
+      }
+      return value;
+    }
+
+    boost::optional<uint64_t> read_uint64(void) {
+      if (length_ - offset_ < 8) {
+        return boost::none;
+      }
+      uint64_t value = 0;
+      for (int i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(p_[offset_++]) << (i * 8);
+      }
+      return value;
+    }
+
+    boost::optional<std::string> read_string(void) {
+      if (length_ - offset_ < 2) {
+        return boost::none;
+      }
+      size_t length = p_[offset_] | (p_[offset_ + 1] << 8);
+      if (length_ - offset_ - 2 < length) {
+        return boost::none;
+      }
+      offset_ += 2;
+      std::string value(reinterpret_cast<const char*>(p_ + offset_), length);
+      offset_ += length;
+      return value;
+    }
+
+  private:
+    const uint8_t* p_;
+    size_t length_;
+    size_t offset_;
+  };
+
+  // Call `callback` for each message in the datagram.
+  // Returns the number of messages, or boost::none if the datagram is invalid.
+  // The callback is not called for an invalid datagram.
+  static boost::optional<size_t> parse(const uint8_t* p,
+                                       size_t length,
+                                       const std::function<void(operation_type, reader&)>& callback) {
+    if (length < get_header_size() ||
+        p[0] != 'k' ||
+        p[1] != 'r') {
+      return boost::none;
+    }
+
+    if (p[2] != get_version()) {
+      logger::get_logger().error("operation_message version mismatch (expected:{0}, actual:{1})",
+                                 static_cast<int>(get_version()),
+                                 static_cast<int>(p[2]));
+      return boost::none;
+    }
+
+    // Validate message lengths before calling callback.
+    size_t expected_count = p[3] | (p[4] << 8);
+    size_t count = 0;
+    for (size_t offset = get_header_size(); offset < length;) {
+      if (length - offset < 3) {
+        return boost::none;
+      }
+      size_t payload_length = p[offset + 1] | (p[offset + 2] << 8);
+      if (length - offset - 3 < payload_length) {
+        return boost::none;
+      }
+      offset += 3 + payload_length;
+      ++count;
+    }
+    if (count != expected_count) {
+      return boost::none;
+    }
+
+    for (size_t offset = get_header_size(); offset < length;) {
+      auto type = operation_type(p[offset]);
+      size_t payload_length = p[offset + 1] | (p[offset + 2] << 8);
+      reader r(p + offset + 3, payload_length);
+      callback(type, r);
+      offset += 3 + payload_length;
+    }
+
+    return count;
+  }
+};
+} // namespace krbn
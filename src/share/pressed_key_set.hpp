@@ -0,0 +1,215 @@
+#pragma once
+
+#include "boost_defs.hpp"
+
+#include "types.hpp"
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace krbn {
+// pressed_key_set is a set of pressed keys (hid_usage_page, hid_usage) and the devices which pressed them.
+//
+// Keys are mapped to dense slots and the set is stored as bitmaps (a global one and one for each device),
+// so that lookups and releasing all keys of a device are bit operations.
+// keyboard_or_keypad keys (usage < 256) use fixed slots. Other keys (e.g., consumer keys) are assigned slots on first use.
+//
+// Keys are returned in the pressed order. (The order of key_up events at device ungrabbing is kept.)
+
+class pressed_key_set final {
+public:
+  pressed_key_set(void) : size_(0),
+                          last_sequence_(0) {
+    for (size_t i = 0; i < keyboard_slot_count; ++i) {
+      slot_keys_.push_back(pack(hid_usage_page::keyboard_or_keypad, hid_usage(i)));
+    }
+    owners_.resize(keyboard_slot_count, device_id::zero);
+    sequences_.resize(keyboard_slot_count, 0);
+  }
+
+  bool empty(void) const {
+    return size_ == 0;
+  }
+
+  size_t size(void) const {
+    return size_;
+  }
+
+  bool contains(hid_usage_page usage_page, hid_usage usage) const {
+    if (auto slot = find_slot(usage_page, usage)) {
+      return test(pressed_, *slot);
+    }
+    return false;
+  }
+
+  // Returns false if the key is already pressed (by any device).
+  bool insert(device_id device_id, hid_usage_page usage_page, hid_usage usage) {
+    auto slot = get_or_make_slot(usage_page, usage);
+    if (test(pressed_, slot)) {
+      return false;
+    }
+
+    set(pressed_, slot);
+    set(get_device_bitmap(device_id), slot);
+    owners_[slot] = device_id;
+    sequences_[slot] = ++last_sequence_;
+    ++size_;
+
+    return true;
+  }
+
+  // Returns false if the key is not pressed.
+  bool erase(hid_usage_page usage_page, hid_usage usage) {
+    auto slot = find_slot(usage_page, usage);
+    if (!slot || !test(pressed_, *slot)) {
+      return false;
+    }
+
+    reset(pressed_, *slot);
+    reset(get_device_bitmap(owners_[*slot]), *slot);
+    --size_;
+
+    return true;
+  }
+
+  // Remove keys which are pressed by `device_id` and return them.
+  std::vector<std::pair<hid_usage_page, hid_usage>> erase_by_device_id(device_id device_id) {
+    std::vector<std::pair<hid_usage_page, hid_usage>> keys;
+
+    auto it = device_bitmaps_.find(device_id);
+    if (it == std::end(device_bitmaps_)) {
+      return keys;
+    }
+
+    auto& bitmap = it->second;
+    auto slots = get_slots(bitmap);
+    for (size_t i = 0; i < bitmap.size(); ++i) {
+      pressed_[i] &= ~bitmap[i];
+      bitmap[i] = 0;
+    }
+    size_ -= slots.size();
+
+    for (const auto& slot : slots) {
+      keys.push_back(unpack(slot_keys_[slot]));
+    }
+
+    return keys;
+  }
+
+  std::vector<std::pair<device_id, std::pair<hid_usage_page, hid_usage>>> get_keys(void) const {
+    std::vector<std::pair<device_id, std::pair<hid_usage_page, hid_usage>>> keys;
+
+    for (const auto& slot : get_slots(pressed_)) {
+      keys.emplace_back(owners_[slot], unpack(slot_keys_[slot]));
+    }
+
+    return keys;
+  }
+
+  void clear(void) {
+    std::fill(std::begin(pressed_), std::end(pressed_), 0);
+    for (auto& pair : device_bitmaps_) {
+      std::fill(std::begin(pair.second), std::end(pair.second), 0);
+    }
+    size_ = 0;
+  }
+
+private:
+  static const size_t keyboard_slot_count = 256;
+
+  typedef std::vector<uint64_t> bitmap;
+
+  static uint64_t pack(hid_usage_page usage_page, hid_usage usage) {
+    return (static_cast<uint64_t>(usage_page) << 32) | static_cast<uint32_t>(usage);
+  }
+
+  static std::pair<hid_usage_page, hid_usage> unpack(uint64_t key) {
+    return std::make_pair(hid_usage_page(key >> 32),
+                          hid_usage(key & 0xffffffff));
+  }
+
+  boost::optional<size_t> find_slot(hid_usage_page usage_page, hid_usage usage) const {
+    if (usage_page == hid_usage_page::keyboard_or_keypad &&
+        static_cast<uint32_t>(usage) < keyboard_slot_count) {
+      return static_cast<size_t>(usage);
+    }
+
+    auto it = slots_.find(pack(usage_page, usage));
+    if (it != std::end(slots_)) {
+      return it->second;
+    }
+    return boost::none;
+  }
+
+  size_t get_or_make_slot(hid_usage_page usage_page, hid_usage usage) {
+    if (auto slot = find_slot(usage_page, usage)) {
+      return *slot;
+    }
+
+    auto key = pack(usage_page, usage);
+    auto slot = slot_keys_.size();
+    slots_[key] = slot;
+    slot_keys_.push_back(key);
+    owners_.push_back(device_id::zero);
+    sequences_.push_back(0);
+    return slot;
+  }
+
+  // Returns slots in `bitmap` in the pressed order.
+  std::vector<size_t> get_slots(const bitmap& bitmap) const {
+    std::vector<size_t> slots;
+
+    for (size_t i = 0; i < bitmap.size(); ++i) {
+      for (auto bits = bitmap[i]; bits != 0; bits &= bits - 1) {
+        slots.push_back(i * 64 + __builtin_ctzll(bits));
+      }
+    }
+
+    std::sort(std::begin(slots),
+              std::end(slots),
+              [this](auto a, auto b) {
+                return sequences_[a] < sequences_[b];
+              });
+
+    return slots;
+  }
+
+  bitmap& get_device_bitmap(device_id device_id) {
+    return device_bitmaps_[device_id];
+  }
+
+  static bool test(const bitmap& bitmap, size_t slot) {
+    auto i = slot / 64;
+    return i < bitmap.size() && (bitmap[i] & (1ULL << (slot % 64))) != 0;
+  }
+
+  static void set(bitmap& bitmap, size_t slot) {
+    auto i = slot / 64;
+    if (i >= bitmap.size()) {
+      bitmap.resize(i + 1, 0);
+    }
+    bitmap[i] |= (1ULL << (slot % 64));
+  }
+
+  static void reset(bitmap& bitmap, size_t slot) {
+    auto i = slot / 64;
+    if (i < bitmap.size()) {
+      bitmap[i] &= ~(1ULL << (slot % 64));
+    }
+  }
+
+  bitmap pressed_;
+  std::unordered_map<device_id, bitmap> device_bitmaps_;
+  // slot -> device_id
+  std::vector<device_id> owners_;
+  // slot -> the sequence number of key_down
+  std::vector<uint64_t> sequences_;
+  // slot -> packed (hid_usage_page, hid_usage)
+  std::vector<uint64_t> slot_keys_;
+  // packed (hid_usage_page, hid_usage) -> slot (except keyboard_or_keypad keys which have fixed slots)
+  std::unordered_map<uint64_t, size_t> slots_;
+  size_t size_;
+  uint64_t last_sequence_;
+};
+} // namespace krbn
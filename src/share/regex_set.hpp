@@ -0,0 +1,387 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace krbn {
+// regex_set evaluates many patterns (e.g., `bundle_identifiers` of all frontmost_application conditions) against one string in one pass.
+//
+// Patterns which consist only of literal characters (e.g., `^com\.apple\.Terminal$`) are matched without std::regex:
+//   - `^literal$` patterns are looked up in a hash table at once.
+//   - `^literal`, `literal$` and `literal` patterns are matched by string comparison.
+// Other patterns are matched by std::regex.
+// They are skipped without std::regex when the input does not start with the literal prefix of the pattern. (e.g., `com.microsoft.` of `^com\.microsoft\.(Word|Excel)$`)
+//
+// The results of the last input are cached, so conditions which share a regex_set cost one std::regex search per pattern when the input is changed.
+//
+// Identical patterns share one entry.
+// `insert` and `erase` are reference counted, so conditions should call `erase` at destruction.
+
+class regex_set final {
+public:
+  regex_set(const regex_set&) = delete;
+
+  regex_set(void) {
+  }
+
+  // Throws std::regex_error if `pattern` is invalid.
+  size_t insert(const std::string& pattern) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = indices_.find(pattern);
+    if (it != std::end(indices_)) {
+      ++(entries_[it->second].reference_count);
+      return it->second;
+    }
+
+    entry e(pattern);
+
+    size_t index = 0;
+    if (free_indices_.empty()) {
+      index = entries_.size();
+      entries_.push_back(std::move(e));
+    } else {
+      index = free_indices_.back();
+      free_indices_.pop_back();
+      entries_[index] = std::move(e);
+    }
+
+    indices_[pattern] = index;
+    if (entries_[index].type == pattern_type::exact) {
+      exact_indices_[entries_[index].literal].push_back(index);
+    }
+
+    last_input_ = boost::none;
+
+    return index;
+  }
+
+  void erase(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (index >= entries_.size() ||
+        entries_[index].reference_count == 0) {
+      return;
+    }
+
+    auto& e = entries_[index];
+    --(e.reference_count);
+    if (e.reference_count > 0) {
+      return;
+    }
+
+    if (e.type == pattern_type::exact) {
+      auto& v = exact_indices_[e.literal];
+      v.erase(std::remove(std::begin(v), std::end(v), index), std::end(v));
+      if (v.empty()) {
+        exact_indices_.erase(e.literal);
+      }
+    }
+
+    indices_.erase(e.pattern);
+    e = entry();
+    free_indices_.push_back(index);
+
+    last_input_ = boost::none;
+  }
+
+  // Returns true if any pattern of `indices` matches `input`.
+  bool match_any(const std::string& input,
+                 const std::vector<size_t>& indices) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    update_results(input);
+
+    for (const auto& i : indices) {
+      if (i < results_.size() && results_[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool match(const std::string& input,
+             size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    update_results(input);
+
+    return index < results_.size() && results_[index];
+  }
+
+  size_t size(void) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return indices_.size();
+  }
+
+  // The number of patterns which are matched by std::regex.
+  size_t get_regex_pattern_count(void) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t count = 0;
+    for (const auto& e : entries_) {
+      if (e.reference_count > 0 && e.type == pattern_type::regex) {
+        ++count;
+      }
+    }
+    return count;
+  }
+
+private:
+  enum class pattern_type {
+    exact,    // ^literal$
+    prefix,   // ^literal
+    suffix,   // literal$
+    contains, // literal
+    regex,
+  };
+
+  struct entry final {
+    entry(void) : type(pattern_type::regex),
+                  reference_count(0) {
+    }
+
+    explicit entry(const std::string& p) : pattern(p),
+                                           type(pattern_type::regex),
+                                           reference_count(1) {
+      if (!parse_literal_pattern(pattern, type, literal)) {
+        // Compile the regex only when it is required. (This also validates the pattern.)
+        regex = std::regex(pattern);
+        type = pattern_type::regex;
+        literal = get_literal_prefix(pattern);
+      }
+    }
+
+    std::string pattern;
+    pattern_type type;
+    // The whole literal (exact, prefix, suffix, contains) or the literal prefix (regex).
+    std::string literal;
+    boost::optional<std::regex> regex;
+    size_t reference_count;
+  };
+
+  void update_results(const std::string& input) {
+    if (last_input_ && *last_input_ == input) {
+      return;
+    }
+
+    results_.assign(entries_.size(), false);
+
+    {
+      auto it = exact_indices_.find(input);
+      if (it != std::end(exact_indices_)) {
+        for (const auto& i : it->second) {
+          results_[i] = true;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      const auto& e = entries_[i];
+      if (e.reference_count == 0) {
+        continue;
+      }
+
+      switch (e.type) {
+        case pattern_type::exact:
+          break;
+
+        case pattern_type::prefix:
+          results_[i] = starts_with(input, e.literal);
+          break;
+
+        case pattern_type::suffix:
+          results_[i] = input.size() >= e.literal.size() &&
+                        input.compare(input.size() - e.literal.size(), e.literal.size(), e.literal) == 0;
+          break;
+
+        case pattern_type::contains:
+          results_[i] = input.find(e.literal) != std::string::npos;
+          break;
+
+        case pattern_type::regex:
+          if (starts_with(input, e.literal) && e.regex) {
+            results_[i] = regex_search(std::begin(input),
+                                       std::end(input),
+                                       *(e.regex));
+          }
+          break;
+      }
+    }
+
+    last_input_ = input;
+  }
+
+  static bool starts_with(const std::string& input, const std::string& literal) {
+    return input.compare(0, literal.size(), literal) == 0;
+  }
+
+  // Characters which have special meanings in ECMAScript regex.
+  static bool is_special_character(char c) {
+    switch (c) {
+      case '^':
+      case '$':
+      case '\\':
+      case '.':
+      case '*':
+      case '+':
+      case '?':
+      case '(':
+      case ')':
+      case '[':
+      case ']':
+      case '{':
+      case '}':
+      case '|':
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Read one literal character at `pattern[i]`. (`\.` is read as `.`)
+  // Returns the length of the read characters, or 0 if `pattern[i]` is not a literal character.
+  static size_t read_literal_character(const std::string& pattern, size_t i, char& c) {
+    if (i >= pattern.size()) {
+      return 0;
+    }
+
+    if (pattern[i] == '\\') {
+      // `\d`, `\w`, `\b`, `\1`, ... are not literal.
+      if (i + 1 < pattern.size() &&
+          is_special_character(pattern[i + 1])) {
+        c = pattern[i + 1];
+        return 2;
+      }
+      return 0;
+    }
+
+    if (is_special_character(pattern[i])) {
+      return 0;
+    }
+
+    c = pattern[i];
+    return 1;
+  }
+
+  static bool parse_literal_pattern(const std::string& pattern, pattern_type& type, std::string& literal) {
+    size_t i = 0;
+    bool head = false;
+    bool tail = false;
+
+    if (i < pattern.size() && pattern[i] == '^') {
+      head = true;
+      ++i;
+    }
+
+    literal.clear();
+    while (i < pattern.size()) {
+      char c;
+      if (auto n = read_literal_character(pattern, i, c)) {
+        literal += c;
+        i += n;
+      } else {
+        break;
+      }
+    }
+
+    if (i + 1 == pattern.size() && pattern[i] == '$') {
+      tail = true;
+      ++i;
+    }
+
+    if (i != pattern.size()) {
+      return false;
+    }
+
+    if (head && tail) {
+      type = pattern_type::exact;
+    } else if (head) {
+      type = pattern_type::prefix;
+    } else if (tail) {
+      type = pattern_type::suffix;
+    } else {
+      type = pattern_type::contains;
+    }
+    return true;
+  }
+
+  // Returns the literal which every matched input starts with.
+  // (e.g., `com.microsoft.` of `^com\.microsoft\.(Word|Excel)$`)
+  static std::string get_literal_prefix(const std::string& pattern) {
+    // `^a|b` matches inputs which do not start with `a`.
+    if (pattern.empty() ||
+        pattern[0] != '^' ||
+        has_top_level_alternative(pattern)) {
+      return "";
+    }
+
+    std::string literal;
+    size_t i = 1;
+    while (i < pattern.size()) {
+      char c;
+      auto n = read_literal_character(pattern, i, c);
+      if (n == 0) {
+        break;
+      }
+
+      // The last character is optional in `ab?`, `ab*` and `ab{0,1}`.
+      if (i + n < pattern.size()) {
+        auto next = pattern[i + n];
+        if (next == '?' || next == '*' || next == '{') {
+          break;
+        }
+      }
+
+      literal += c;
+      i += n;
+    }
+
+    return literal;
+  }
+
+  static bool has_top_level_alternative(const std::string& pattern) {
+    int depth = 0;
+    bool in_bracket = false;
+
+    for (size_t i = 0; i < pattern.size(); ++i) {
+      auto c = pattern[i];
+      if (c == '\\') {
+        ++i;
+      } else if (in_bracket) {
+        if (c == ']') {
+          in_bracket = false;
+        }
+      } else if (c == '[') {
+        in_bracket = true;
+      } else if (c == '(') {
+        ++depth;
+      } else if (c == ')') {
+        --depth;
+      } else if (c == '|' && depth <= 0) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  mutable std::mutex mutex_;
+
+  std::vector<entry> entries_;
+  std::vector<size_t> free_indices_;
+  // pattern -> index
+  std::unordered_map<std::string, size_t> indices_;
+  // literal of `^literal$` -> indices
+  std::unordered_map<std::string, std::vector<size_t>> exact_indices_;
+
+  boost::optional<std::string> last_input_;
+  std::vector<bool> results_;
+};
+} // namespace krbn
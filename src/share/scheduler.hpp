@@ -0,0 +1,224 @@
+#pragma once
+
+#include "boost_defs.hpp"
+
+#include "gcd_utility.hpp"
+#include <atomic>
+#include <boost/optional.hpp>
+#include <functional>
+#include <mach/mach_time.h>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace krbn {
+// scheduler provides the current time and one-shot timers in mach absolute time.
+//
+// `system_scheduler` uses mach_absolute_time and the main queue.
+// `virtual_scheduler` uses a manually advanced time in order to run the manipulator pipeline headless
+// (unit tests and benchmarks) without waiting for real timers.
+
+class scheduler {
+public:
+  class timer {
+  public:
+    virtual ~timer(void) {
+    }
+
+    virtual bool fired(void) const = 0;
+  };
+
+  virtual ~scheduler(void) {
+  }
+
+  virtual uint64_t now(void) const = 0;
+
+  // The timer is canceled when the returned object is destroyed.
+  virtual std::unique_ptr<timer> make_timer(uint64_t when, const std::function<void(void)>& function) = 0;
+
+  static scheduler& get_instance(void);
+  static void set_instance(const std::shared_ptr<scheduler>& instance);
+
+private:
+  static std::shared_ptr<scheduler>& get_instance_pointer(void) {
+    static std::shared_ptr<scheduler> instance;
+    return instance;
+  }
+
+  // `get_instance` is called several times per event.
+  // We read the current instance via an atomic pointer in order to avoid locking `get_mutex` on each call.
+  static std::atomic<scheduler*>& get_instance_raw_pointer(void) {
+    static std::atomic<scheduler*> pointer(nullptr);
+    return pointer;
+  }
+
+  static std::mutex& get_mutex(void) {
+    static std::mutex mutex;
+    return mutex;
+  }
+};
+
+class system_scheduler final : public scheduler {
+public:
+  class system_timer final : public timer {
+  public:
+    system_timer(uint64_t when, const std::function<void(void)>& function) : function_(function) {
+      timer_ = std::make_unique<gcd_utility::main_queue_after_timer>(when,
+                                                                     true,
+                                                                     ^{
+                                                                       function_();
+                                                                     });
+    }
+
+    virtual bool fired(void) const {
+      return timer_->fired();
+    }
+
+  private:
+    std::function<void(void)> function_;
+    std::unique_ptr<gcd_utility::main_queue_after_timer> timer_;
+  };
+
+  virtual uint64_t now(void) const {
+    return mach_absolute_time();
+  }
+
+  virtual std::unique_ptr<timer> make_timer(uint64_t when, const std::function<void(void)>& function) {
+    return std::make_unique<system_timer>(when, function);
+  }
+};
+
+class virtual_scheduler final : public scheduler {
+public:
+  class virtual_timer final : public timer {
+  public:
+    class state final {
+    public:
+      state(const std::function<void(void)>& function) : function(function),
+                                                          fired(false),
+                                                          canceled(false) {
+      }
+
+      std::function<void(void)> function;
+      bool fired;
+      bool canceled;
+    };
+
+    virtual_timer(const std::shared_ptr<state>& state) : state_(state) {
+    }
+
+    virtual ~virtual_timer(void) {
+      state_->canceled = true;
+    }
+
+    virtual bool fired(void) const {
+      return state_->fired;
+    }
+
+  private:
+    std::shared_ptr<state> state_;
+  };
+
+  virtual_scheduler(uint64_t now = 0) : now_(now),
+                                        last_sequence_(0) {
+  }
+
+  virtual uint64_t now(void) const {
+    return now_;
+  }
+
+  virtual std::unique_ptr<timer> make_timer(uint64_t when, const std::function<void(void)>& function) {
+    auto s = std::make_shared<virtual_timer::state>(function);
+    // Timers which have the same `when` are invoked in the order of creation.
+    entries_.emplace(std::make_pair(when, ++last_sequence_), s);
+    return std::make_unique<virtual_timer>(s);
+  }
+
+  // Invoke timers in order until `time`.
+  // `now()` returns the `when` of each timer while it is invoked.
+  void advance_to(uint64_t time) {
+    while (!entries_.empty()) {
+      auto it = std::begin(entries_);
+      if (it->first.first > time) {
+        break;
+      }
+
+      auto s = it->second;
+      if (now_ < it->first.first) {
+        now_ = it->first.first;
+      }
+      entries_.erase(it);
+
+      if (!s->canceled) {
+        s->fired = true;
+        s->function();
+      }
+    }
+
+    if (now_ < time) {
+      now_ = time;
+    }
+  }
+
+  void advance(uint64_t duration) {
+    advance_to(now_ + duration);
+  }
+
+  // Advance the time until all active timers are invoked.
+  void run_until_idle(void) {
+    while (auto when = get_next_when()) {
+      advance_to(*when);
+    }
+  }
+
+  size_t get_active_timer_count(void) const {
+    size_t count = 0;
+    for (const auto& e : entries_) {
+      if (!e.second->canceled) {
+        ++count;
+      }
+    }
+    return count;
+  }
+
+private:
+  boost::optional<uint64_t> get_next_when(void) {
+    while (!entries_.empty()) {
+      auto it = std::begin(entries_);
+      if (!it->second->canceled) {
+        return it->first.first;
+      }
+      entries_.erase(it);
+    }
+    return boost::none;
+  }
+
+  uint64_t now_;
+  uint64_t last_sequence_;
+  std::map<std::pair<uint64_t, uint64_t>, std::shared_ptr<virtual_timer::state>> entries_;
+};
+
+inline scheduler& scheduler::get_instance(void) {
+  if (auto p = get_instance_raw_pointer().load(std::memory_order_acquire)) {
+    return *p;
+  }
+
+  std::lock_guard<std::mutex> guard(get_mutex());
+
+  auto& instance = get_instance_pointer();
+  if (!instance) {
+    instance = std::make_shared<system_scheduler>();
+    get_instance_raw_pointer().store(instance.get(), std::memory_order_release);
+  }
+
+  return *instance;
+}
+
+// Note: Do not replace the instance while other threads are using it.
+inline void scheduler::set_instance(const std::shared_ptr<scheduler>& instance) {
+  std::lock_guard<std::mutex> guard(get_mutex());
+
+  get_instance_pointer() = instance;
+  get_instance_raw_pointer().store(instance.get(), std::memory_order_release);
+}
+} // namespace krbn
@@ -3,11 +3,12 @@
 #include "boost_defs.hpp"
 
 BEGIN_BOOST_INCLUDE
-#include <boost/lexical_cast.hpp>
 #include <boost/optional.hpp>
 END_BOOST_INCLUDE
 
 #include "logger.hpp"
+#include "mapped_file.hpp"
+#include <cstring>
 #include <deque>
 #include <iomanip>
 
@@ -19,74 +20,101 @@ public:
   }
 
   static boost::optional<uint64_t> get_sort_key(const std::string& line) {
-    // line == "[2016-09-22 20:18:37.649] [info] [grabber] version 0.90.36"
-    // return 20160922201837649
-
-    // We can parse time strictly by using boost::posix_time::time_from_string.
-    // But we cannot use it with boost header only.
-    // So we use this rough way.
+    return get_sort_key(line.c_str(), line.size());
+  }
 
-    if (line.size() < strlen("[0000-00-00 00:00:00.000]")) {
+  // line == "[2016-09-22 20:18:37.649] [info] [grabber] version 0.90.36"
+  // return 20160922201837649
+  //
+  // `p` does not have to be null-terminated. (e.g., a line in a mapped file)
+  // Digits are read at the fixed offsets without allocation,
+  // and separators are validated with the digits at once in order to avoid branches per character.
+  static boost::optional<uint64_t> get_sort_key(const char* _Nonnull p, size_t length) {
+    if (length < get_sort_key_length()) {
       return boost::none;
     }
 
-    if (line.empty()) {
-      return boost::none;
+    // "[0000-00-00 00:00:00.000]"
+    //  0    5  8  11 14 17 20  24
+    uint32_t invalid = (p[0] ^ '[') |
+                       (p[5] ^ '-') |
+                       (p[8] ^ '-') |
+                       (p[11] ^ ' ') |
+                       (p[14] ^ ':') |
+                       (p[17] ^ ':') |
+                       (p[20] ^ '.') |
+                       (p[24] ^ ']');
+
+    static const uint8_t digit_positions[] = {
+        1, 2, 3, 4,   // years
+        6, 7,         // months
+        9, 10,        // days
+        12, 13,       // hours
+        15, 16,       // minutes
+        18, 19,       // seconds
+        21, 22, 23,   // milliseconds
+    };
+
+    uint64_t value = 0;
+    for (auto position : digit_positions) {
+      // Characters which are less than '0' are wrapped around to large values.
+      uint32_t digit = static_cast<uint8_t>(p[position]) - static_cast<uint32_t>('0');
+      invalid |= static_cast<uint32_t>(digit > 9);
+      value = value * 10 + digit;
     }
 
-    if (line[0] != '[') {
+    if (invalid) {
       return boost::none;
     }
+    return value;
+  }
 
-    std::string result_string(4 + 2 + 2 + // years,months,days
-                                  2 + 2 + 2 + // hours,minutes,seconds
-                                  3, // milliseconds
-                              '0');
-    size_t line_pos = 1;
-    size_t result_pos = 0;
-
-    // years
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-
-    // months
-    ++line_pos;
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-
-    // days
-    ++line_pos;
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-
-    // hours
-    ++line_pos;
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-
-    // minutes
-    ++line_pos;
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-
-    // seconds
-    ++line_pos;
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-
-    // milliseconds
-    ++line_pos;
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-    result_string[result_pos++] = line[line_pos++];
-
-    try {
-      return boost::lexical_cast<uint64_t>(result_string);
-    } catch (...) {
+  static size_t get_sort_key_length(void) {
+    return 25; // strlen("[0000-00-00 00:00:00.000]")
+  }
+
+  // Scan lines in `p` and call `callback(offset, length, sort_key)` for each line which has a sort key.
+  // (`offset` and `length` do not include the newline.)
+  //
+  // The last line is ignored if it is not terminated with newline.
+  // Returns the length of the scanned lines. (The position of the unterminated line.)
+  template <typename T>
+  static size_t scan_sort_keys(const char* _Nonnull p, size_t length, T callback) {
+    size_t offset = 0;
+    while (offset < length) {
+      auto end = static_cast<const char*>(memchr(p + offset, '\n', length - offset));
+      if (!end) {
+        break;
+      }
+
+      size_t line_length = end - (p + offset);
+      if (auto sort_key = get_sort_key(p + offset, line_length)) {
+        callback(offset, line_length, *sort_key);
+      }
+
+      offset += line_length + 1;
     }
-    return boost::none;
+    return offset;
+  }
+
+  // Scan lines of a file with mapped_file.
+  // `callback(data, offset, length, sort_key)` is called for each line. (`data` is valid only in `callback`.)
+  // Returns boost::none if the file is not found or empty.
+  template <typename T>
+  static boost::optional<size_t> scan_sort_keys(const std::string& file_path, T callback) {
+    mapped_file file(file_path);
+    if (!file.get_data()) {
+      return boost::none;
+    }
+
+    file.advise(MADV_SEQUENTIAL);
+
+    auto data = file.get_data();
+    return scan_sort_keys(data,
+                          file.get_size(),
+                          [&](size_t offset, size_t length, uint64_t sort_key) {
+                            callback(data, offset, length, sort_key);
+                          });
   }
 
   static boost::optional<spdlog::level::level_enum> get_level(const std::string& line) {
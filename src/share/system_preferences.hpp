@@ -14,6 +14,9 @@ public:
     values(void) : keyboard_fn_state_(system_preferences::get_keyboard_fn_state()) {
     }
 
+    explicit values(bool keyboard_fn_state) : keyboard_fn_state_(keyboard_fn_state) {
+    }
+
     bool get_keyboard_fn_state(void) const { return keyboard_fn_state_; }
 
     bool operator==(const system_preferences::values& other) const {
@@ -6,10 +6,7 @@ namespace krbn {
 class thread_utility final {
 public:
   static std::thread::id get_main_thread_id(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::thread::id id = std::this_thread::get_id();
+    static const std::thread::id id = std::this_thread::get_id();
     return id;
   }
 
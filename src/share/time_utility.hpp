@@ -23,16 +23,12 @@ public:
 
 private:
   static const mach_timebase_info_data_t& get_mach_timebase_info_data(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static bool once = false;
-    static mach_timebase_info_data_t mach_timebase_info_data;
-
-    if (!once) {
-      once = true;
-      mach_timebase_info(&mach_timebase_info_data);
-    }
+    // We do not need a lock for each call since the value is immutable after the initialization.
+    static const mach_timebase_info_data_t mach_timebase_info_data = [] {
+      mach_timebase_info_data_t t;
+      mach_timebase_info(&t);
+      return t;
+    }();
 
     return mach_timebase_info_data;
   }
@@ -335,6 +335,139 @@ enum class product_id : uint32_t {
 enum class location_id : uint32_t {
 };
 
+// A set of modifier_flag represented as a bitmask.
+// It is used in the key event processing instead of `std::unordered_set<modifier_flag>` to avoid allocations.
+class modifier_flag_mask final {
+public:
+  class const_iterator final {
+  public:
+    const_iterator(uint16_t value) : value_(value) {
+    }
+
+    modifier_flag operator*(void) const {
+      // Return the lowest set bit.
+      for (uint32_t i = 0; i < 16; ++i) {
+        if (value_ & (1 << i)) {
+          return modifier_flag(i);
+        }
+      }
+      return modifier_flag::zero;
+    }
+
+    const_iterator& operator++(void) {
+      // Clear the lowest set bit.
+      value_ &= static_cast<uint16_t>(value_ - 1);
+      return *this;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return value_ == other.value_;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+  private:
+    uint16_t value_;
+  };
+
+  modifier_flag_mask(void) : value_(0) {
+  }
+
+  explicit modifier_flag_mask(uint16_t value) : value_(value) {
+  }
+
+  modifier_flag_mask(std::initializer_list<modifier_flag> modifier_flags) : value_(0) {
+    for (const auto& f : modifier_flags) {
+      insert(f);
+    }
+  }
+
+  static modifier_flag_mask all(void) {
+    // modifier_flag::zero is not included.
+    modifier_flag_mask mask;
+    for (auto i = static_cast<uint32_t>(modifier_flag::zero) + 1; i != static_cast<uint32_t>(modifier_flag::end_); ++i) {
+      mask.insert(modifier_flag(i));
+    }
+    return mask;
+  }
+
+  uint16_t get_value(void) const {
+    return value_;
+  }
+
+  bool empty(void) const {
+    return value_ == 0;
+  }
+
+  size_t size(void) const {
+    size_t count = 0;
+    for (auto v = value_; v != 0; v &= static_cast<uint16_t>(v - 1)) {
+      ++count;
+    }
+    return count;
+  }
+
+  bool contains(modifier_flag modifier_flag) const {
+    return (value_ & make_bit(modifier_flag)) != 0;
+  }
+
+  void insert(modifier_flag modifier_flag) {
+    value_ |= make_bit(modifier_flag);
+  }
+
+  void erase(modifier_flag modifier_flag) {
+    value_ &= static_cast<uint16_t>(~make_bit(modifier_flag));
+  }
+
+  const_iterator begin(void) const {
+    return const_iterator(value_);
+  }
+
+  const_iterator end(void) const {
+    return const_iterator(0);
+  }
+
+  modifier_flag_mask operator&(const modifier_flag_mask& other) const {
+    return modifier_flag_mask(static_cast<uint16_t>(value_ & other.value_));
+  }
+
+  modifier_flag_mask operator|(const modifier_flag_mask& other) const {
+    return modifier_flag_mask(static_cast<uint16_t>(value_ | other.value_));
+  }
+
+  modifier_flag_mask operator^(const modifier_flag_mask& other) const {
+    return modifier_flag_mask(static_cast<uint16_t>(value_ ^ other.value_));
+  }
+
+  modifier_flag_mask& operator|=(const modifier_flag_mask& other) {
+    value_ |= other.value_;
+    return *this;
+  }
+
+  bool operator==(const modifier_flag_mask& other) const {
+    return value_ == other.value_;
+  }
+
+  bool operator!=(const modifier_flag_mask& other) const {
+    return !(*this == other);
+  }
+
+private:
+  static uint16_t make_bit(modifier_flag modifier_flag) {
+    auto i = static_cast<uint32_t>(modifier_flag);
+    if (i >= 16) {
+      return 0;
+    }
+    return static_cast<uint16_t>(1 << i);
+  }
+
+  static_assert(static_cast<uint32_t>(modifier_flag::end_) <= 16, "modifier_flag must fit in uint16_t");
+
+  uint16_t value_;
+};
+
 class device_identifiers final {
 public:
   device_identifiers(void) : vendor_id_(vendor_id::zero),
@@ -932,10 +1065,7 @@ public:
 
   // string -> hid usage map
   static const std::vector<std::pair<std::string, key_code>>& get_key_code_name_value_pairs(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::vector<std::pair<std::string, key_code>> pairs({
+    static const std::vector<std::pair<std::string, key_code>> pairs({
         // From IOHIDUsageTables.h
         {"a", key_code(kHIDUsage_KeyboardA)},
         {"b", key_code(kHIDUsage_KeyboardB)},
@@ -1155,22 +1285,7 @@ public:
   }
 
   static const std::unordered_map<std::string, key_code>& get_key_code_name_value_map(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::unordered_map<std::string, key_code> map;
-
-    if (map.empty()) {
-      for (const auto& pair : get_key_code_name_value_pairs()) {
-        auto it = map.find(pair.first);
-        if (it != std::end(map)) {
-          logger::get_logger().error("duplicate entry in get_key_code_name_value_pairs: {0}", pair.first);
-        } else {
-          map.emplace(pair.first, pair.second);
-        }
-      }
-    }
-
+    static const auto map = make_name_value_map(get_key_code_name_value_pairs(), "get_key_code_name_value_pairs");
     return map;
   }
 
@@ -1325,10 +1440,7 @@ public:
   }
 
   static const std::vector<std::pair<std::string, consumer_key_code>>& get_consumer_key_code_name_value_pairs(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::vector<std::pair<std::string, consumer_key_code>> pairs({
+    static const std::vector<std::pair<std::string, consumer_key_code>> pairs({
         {"power", consumer_key_code::power},
         {"display_brightness_increment", consumer_key_code::display_brightness_increment},
         {"display_brightness_decrement", consumer_key_code::display_brightness_decrement},
@@ -1347,22 +1459,7 @@ public:
   }
 
   static const std::unordered_map<std::string, consumer_key_code>& get_consumer_key_code_name_value_map(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::unordered_map<std::string, consumer_key_code> map;
-
-    if (map.empty()) {
-      for (const auto& pair : get_consumer_key_code_name_value_pairs()) {
-        auto it = map.find(pair.first);
-        if (it != std::end(map)) {
-          logger::get_logger().error("duplicate entry in get_consumer_key_code_name_value_pairs: {0}", pair.first);
-        } else {
-          map.emplace(pair.first, pair.second);
-        }
-      }
-    }
-
+    static const auto map = make_name_value_map(get_consumer_key_code_name_value_pairs(), "get_consumer_key_code_name_value_pairs");
     return map;
   }
 
@@ -1422,10 +1519,7 @@ public:
   }
 
   static const std::vector<std::pair<std::string, pointing_button>>& get_pointing_button_name_value_pairs(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::vector<std::pair<std::string, pointing_button>> pairs({
+    static const std::vector<std::pair<std::string, pointing_button>> pairs({
         // From IOHIDUsageTables.h
 
         {"button1", pointing_button::button1},
@@ -1469,22 +1563,7 @@ public:
   }
 
   static const std::unordered_map<std::string, pointing_button>& get_pointing_button_name_value_map(void) {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> guard(mutex);
-
-    static std::unordered_map<std::string, pointing_button> map;
-
-    if (map.empty()) {
-      for (const auto& pair : get_pointing_button_name_value_pairs()) {
-        auto it = map.find(pair.first);
-        if (it != std::end(map)) {
-          logger::get_logger().error("duplicate entry in get_pointing_button_name_value_pairs: {0}", pair.first);
-        } else {
-          map.emplace(pair.first, pair.second);
-        }
-      }
-    }
-
+    static const auto map = make_name_value_map(get_pointing_button_name_value_pairs(), "get_pointing_button_name_value_pairs");
     return map;
   }
 
@@ -1536,53 +1615,27 @@ public:
   }
 
 private:
-  static std::unordered_map<device_id, std::shared_ptr<device_detail>>& get_device_id_map(void) {
-    static std::unordered_map<device_id, std::shared_ptr<device_detail>> map;
-    return map;
-  }
-};
-
-struct operation_type_connect_struct {
-  operation_type_connect_struct(void) : operation_type(operation_type::connect) {
-    strlcpy(user_core_configuration_file_path,
-            constants::get_user_core_configuration_file_path().c_str(),
-            sizeof(user_core_configuration_file_path));
-  }
-
-  const operation_type operation_type;
-  pid_t pid;
-  char user_core_configuration_file_path[_POSIX_PATH_MAX];
-};
-
-struct operation_type_system_preferences_values_updated_struct {
-  operation_type_system_preferences_values_updated_struct(void) : operation_type(operation_type::system_preferences_values_updated) {}
-
-  const operation_type operation_type;
-  system_preferences::values values;
-};
+  template <typename T>
+  static std::unordered_map<std::string, T> make_name_value_map(const std::vector<std::pair<std::string, T>>& pairs,
+                                                                 const char* pairs_name) {
+    std::unordered_map<std::string, T> map;
+
+    for (const auto& pair : pairs) {
+      auto it = map.find(pair.first);
+      if (it != std::end(map)) {
+        logger::get_logger().error("duplicate entry in {0}: {1}", pairs_name, pair.first);
+      } else {
+        map.emplace(pair.first, pair.second);
+      }
+    }
 
-struct operation_type_frontmost_application_changed_struct {
-  operation_type_frontmost_application_changed_struct(void) : operation_type(operation_type::frontmost_application_changed) {
-    bundle_identifier[0] = '\0';
-    file_path[0] = '\0';
+    return map;
   }
 
-  const operation_type operation_type;
-  char bundle_identifier[256];
-  char file_path[_POSIX_PATH_MAX];
-};
-
-struct operation_type_input_source_changed_struct {
-  operation_type_input_source_changed_struct(void) : operation_type(operation_type::input_source_changed) {
-    language[0] = '\0';
-    input_source_id[0] = '\0';
-    input_mode_id[0] = '\0';
+  static std::unordered_map<device_id, std::shared_ptr<device_detail>>& get_device_id_map(void) {
+    static std::unordered_map<device_id, std::shared_ptr<device_detail>> map;
+    return map;
   }
-
-  const operation_type operation_type;
-  char language[256];
-  char input_source_id[256];
-  char input_mode_id[256];
 };
 
 struct operation_type_shell_command_execution_struct {
@@ -1689,6 +1742,21 @@ inline std::ostream& operator<<(std::ostream& stream, const container<modifier_f
   return stream_utility::output_enums(stream, values);
 }
 
+inline std::ostream& operator<<(std::ostream& stream, const modifier_flag_mask& value) {
+  bool first = true;
+  stream << "[";
+  for (const auto& v : value) {
+    if (first) {
+      first = false;
+    } else {
+      stream << ",";
+    }
+    stream << v;
+  }
+  stream << "]";
+  return stream;
+}
+
 inline std::ostream& operator<<(std::ostream& stream, const input_source_identifiers& value) {
   stream << "language:";
 
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <boost/optional.hpp>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace krbn {
+enum class variable_id : uint32_t {
+  zero = 0,
+};
+
+// variable_name_table maps variable names (`set_variable` and `variable_if` in complex_modifications) to dense ids.
+// Names are interned when rules or events are parsed, so the key event handling uses only ids.
+// Names are used only for json input and output.
+
+class variable_name_table final {
+public:
+  variable_name_table(const variable_name_table&) = delete;
+
+  variable_name_table(void) {
+  }
+
+  variable_id intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = ids_.find(name);
+    if (it != std::end(ids_)) {
+      return it->second;
+    }
+
+    auto id = variable_id(names_.size());
+    names_.push_back(name);
+    ids_.emplace(name, id);
+    return id;
+  }
+
+  // `find` does not register the name unlike `intern`.
+  boost::optional<variable_id> find(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = ids_.find(name);
+    if (it != std::end(ids_)) {
+      return it->second;
+    }
+    return boost::none;
+  }
+
+  const std::string& get_name(variable_id id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto index = static_cast<size_t>(id);
+    if (index < names_.size()) {
+      return names_[index];
+    }
+
+    static std::string empty;
+    return empty;
+  }
+
+  size_t size(void) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return names_.size();
+  }
+
+  static variable_name_table& get_instance(void) {
+    static variable_name_table instance;
+    return instance;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  // std::deque keeps references to names valid.
+  std::deque<std::string> names_;
+  std::unordered_map<std::string, variable_id> ids_;
+};
+} // namespace krbn
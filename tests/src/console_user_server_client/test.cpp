@@ -0,0 +1,207 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "console_user_server_client.hpp"
+#include "local_datagram_server.hpp"
+#include "thread_utility.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <future>
+
+namespace {
+const std::string socket_file_path("tmp/receiver");
+
+// A stand-in for console_user_server.
+class server final {
+public:
+  server(void) {
+    krbn::filesystem::create_directory_with_intermediate_directories(krbn::filesystem::dirname(socket_file_path), 0700);
+    unlink(socket_file_path.c_str());
+    server_ = std::make_unique<krbn::local_datagram_server>(socket_file_path.c_str());
+  }
+
+  ~server(void) {
+    server_ = nullptr;
+    unlink(socket_file_path.c_str());
+  }
+
+  // Receive datagrams until no datagram arrives within `timeout`.
+  std::vector<std::vector<uint8_t>> receive(boost::posix_time::time_duration timeout = boost::posix_time::milliseconds(100)) {
+    std::vector<std::vector<uint8_t>> datagrams;
+
+    for (;;) {
+      std::vector<uint8_t> buffer(32 * 1024);
+      boost::system::error_code ec;
+      auto n = server_->receive(boost::asio::buffer(buffer), timeout, ec);
+      if (ec || n == 0) {
+        break;
+      }
+      buffer.resize(n);
+      datagrams.push_back(buffer);
+    }
+
+    return datagrams;
+  }
+
+private:
+  std::unique_ptr<krbn::local_datagram_server> server_;
+};
+
+// The worker thread waits until `ready` becomes true at opening the socket.
+std::atomic<bool> ready(true);
+
+std::unique_ptr<krbn::console_user_server_client> make_client(void) {
+  return std::make_unique<krbn::console_user_server_client>([] {
+                                                              return boost::optional<uid_t>(getuid());
+                                                            },
+                                                            [](uid_t) {
+                                                              while (!ready) {
+                                                                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                                              }
+                                                              return socket_file_path;
+                                                            });
+}
+
+std::string read_string(const uint8_t* p, size_t length) {
+  auto s = reinterpret_cast<const char*>(p);
+  return std::string(s, strnlen(s, length));
+}
+
+// Split packed operations into shell_commands and input_source_ids.
+std::vector<std::string> unpack(const std::vector<std::vector<uint8_t>>& datagrams) {
+  std::vector<std::string> result;
+
+  for (const auto& d : datagrams) {
+    REQUIRE(d.size() <= krbn::console_user_server_client::get_max_datagram_size());
+
+    size_t offset = 0;
+    while (offset < d.size()) {
+      switch (krbn::operation_type(d[offset])) {
+        case krbn::operation_type::shell_command_execution: {
+          using operation_struct = krbn::operation_type_shell_command_execution_struct;
+          REQUIRE(offset + sizeof(operation_struct) <= d.size());
+          result.push_back(std::string("shell_command:") +
+                           read_string(&(d[offset + offsetof(operation_struct, shell_command)]),
+                                       sizeof(operation_struct::shell_command)));
+          offset += sizeof(operation_struct);
+          break;
+        }
+
+        case krbn::operation_type::select_input_source: {
+          using operation_struct = krbn::operation_type_select_input_source_struct;
+          REQUIRE(offset + sizeof(operation_struct) <= d.size());
+          result.push_back(std::string("input_source_id:") +
+                           read_string(&(d[offset + offsetof(operation_struct, input_source_id)]),
+                                       sizeof(operation_struct::input_source_id)));
+          offset += sizeof(operation_struct);
+          break;
+        }
+
+        default:
+          REQUIRE(false);
+      }
+    }
+  }
+
+  return result;
+}
+} // namespace
+
+TEST_CASE("initialize") {
+  krbn::thread_utility::register_main_thread();
+}
+
+TEST_CASE("console_user_server_client") {
+  server server;
+  auto client = make_client();
+
+  // Receive datagrams while sending since the receive buffer of the socket is small.
+  auto future = std::async(std::launch::async, [&] {
+    return server.receive(boost::posix_time::seconds(1));
+  });
+
+  std::vector<std::string> expected;
+
+  // Queue operations while the worker thread is sending the first datagram.
+  ready = false;
+
+  for (int i = 0; i < 20; ++i) {
+    auto shell_command = std::string("echo ") + std::to_string(i);
+    client->shell_command_execution(shell_command);
+    expected.push_back("shell_command:" + shell_command);
+
+    if (i % 5 == 0) {
+      auto input_source_id = std::string("com.apple.keylayout.") + std::to_string(i);
+      krbn::input_source_selector selector(boost::none, input_source_id, boost::none);
+      client->select_input_source(selector, i);
+      expected.push_back("input_source_id:" + input_source_id);
+    }
+  }
+
+  ready = true;
+  client->wait_until_idle();
+
+  auto datagrams = future.get();
+  REQUIRE(unpack(datagrams) == expected);
+  // Operations are packed.
+  REQUIRE(datagrams.size() < expected.size());
+
+  // Too long shell_command is ignored.
+  client->shell_command_execution(std::string(1024, 'x'));
+  client->wait_until_idle();
+  REQUIRE(server.receive().empty());
+}
+
+TEST_CASE("console_user_server_client reconnect") {
+  auto client = make_client();
+
+  // Server is not running.
+  client->shell_command_execution("echo 1");
+  client->wait_until_idle();
+
+  {
+    server server;
+
+    client->shell_command_execution("echo 2");
+    client->wait_until_idle();
+
+    REQUIRE(unpack(server.receive()) == std::vector<std::string>({"shell_command:echo 2"}));
+  }
+
+  // Server is terminated.
+  client->shell_command_execution("echo 3");
+  client->wait_until_idle();
+
+  {
+    // Server is restarted.
+    server server;
+
+    client->shell_command_execution("echo 4");
+    client->wait_until_idle();
+
+    REQUIRE(unpack(server.receive()) == std::vector<std::string>({"shell_command:echo 4"}));
+  }
+}
+
+TEST_CASE("console_user_server_client destruction") {
+  // The server does not receive datagrams and its receive buffer becomes full.
+  server server;
+
+  auto client = std::make_unique<krbn::console_user_server_client>([] {
+                                                                     return boost::optional<uid_t>(getuid());
+                                                                   },
+                                                                   [](uid_t) {
+                                                                     return socket_file_path;
+                                                                   },
+                                                                   1024);
+
+  for (int i = 0; i < 1024; ++i) {
+    client->shell_command_execution(std::string(200, 'x'));
+  }
+
+  // The destructor does not wait for the server for each pending datagram.
+  auto start = std::chrono::steady_clock::now();
+  client = nullptr;
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
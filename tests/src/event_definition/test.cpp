@@ -160,7 +160,7 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask());
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
@@ -182,7 +182,7 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask());
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
@@ -206,23 +206,23 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask());
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_command,
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_command,
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
   }
 
@@ -241,18 +241,18 @@ TEST_CASE("event_definition.test_modifiers") {
 
     {
       krbn::modifier_flag_manager modifier_flag_manager;
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask());
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask());
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({}));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask());
     }
   }
 
@@ -278,17 +278,17 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_control_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_control,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_control,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_control_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_control,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_control,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
@@ -320,17 +320,17 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
   }
 
@@ -355,9 +355,9 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
@@ -390,33 +390,33 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::right_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::right_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_command_1);
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
   }
 
@@ -441,24 +441,24 @@ TEST_CASE("event_definition.test_modifiers") {
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::right_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::right_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
       modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
       modifier_flag_manager.push_back_active_modifier_flag(right_shift_1);
-      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == std::unordered_set<krbn::modifier_flag>({
-                                                                            krbn::modifier_flag::left_shift,
-                                                                        }));
+      REQUIRE(event_definition.test_modifiers(modifier_flag_manager) == krbn::modifier_flag_mask({
+                                                             krbn::modifier_flag::left_shift,
+                                                         }));
     }
     {
       krbn::modifier_flag_manager modifier_flag_manager;
@@ -208,6 +208,40 @@ TEST_CASE("get_frontmost_application_bundle_identifier") {
   }
 }
 
+TEST_CASE("payload") {
+  // Interned payloads
+
+  {
+    auto e1 = krbn::event_queue::queued_event::event::make_shell_command_event("open /Applications/Safari.app");
+    auto e2 = krbn::event_queue::queued_event::event::make_shell_command_event("open /Applications/Safari.app");
+    auto e3 = krbn::event_queue::queued_event::event::make_shell_command_event("open /Applications/Mail.app");
+    REQUIRE(e1 == e2);
+    REQUIRE(!(e1 == e3));
+    REQUIRE(e1.get_shell_command() == std::string("open /Applications/Safari.app"));
+  }
+
+  // frontmost_application payloads are not interned.
+
+  {
+    auto terminal1 = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.apple.Terminal",
+                                                                                                      "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal");
+    auto safari = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.apple.Safari",
+                                                                                                   "/Applications/Safari.app/Contents/MacOS/Safari");
+    auto terminal2 = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.apple.Terminal",
+                                                                                                      "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal");
+    REQUIRE(terminal1 == terminal2);
+    REQUIRE(!(terminal1 == safari));
+
+    // Old payloads are evicted in order to bound the memory usage for unbounded distinct values (e.g., translocated file paths).
+    for (int i = 0; i < 1000; ++i) {
+      auto e = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.example.app",
+                                                                                                "/private/var/folders/AppTranslocation/" + std::to_string(i) + "/app");
+      REQUIRE(e.get_frontmost_application()->get_file_path() == "/private/var/folders/AppTranslocation/" + std::to_string(i) + "/app");
+    }
+    REQUIRE(terminal1.get_frontmost_application() == boost::none);
+  }
+}
+
 TEST_CASE("emplace_back_event") {
   // Normal order
   {
@@ -237,7 +271,7 @@ TEST_CASE("emplace_back_event") {
 
     REQUIRE(event_queue.get_pointing_button_manager().is_pressed(krbn::pointing_button::button2) == false);
 
-    std::vector<krbn::event_queue::queued_event> expected;
+    std::deque<krbn::event_queue::queued_event> expected;
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, a_event, key_down, a_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 200, left_shift_event, key_down, left_shift_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 300, button2_event, key_down, button2_event);
@@ -275,7 +309,7 @@ TEST_CASE("emplace_back_event") {
     ENQUEUE_EVENT(event_queue, 1, 500, device_keys_and_pointing_buttons_are_released_event, single, device_keys_and_pointing_buttons_are_released_event);
     ENQUEUE_EVENT(event_queue, 1, 500, left_shift_event, key_down, left_shift_event);
 
-    std::vector<krbn::event_queue::queued_event> expected;
+    std::deque<krbn::event_queue::queued_event> expected;
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_control_event, key_down, left_control_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_shift_event, key_down, left_shift_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, a_event, key_down, a_event);
@@ -297,7 +331,7 @@ TEST_CASE("emplace_back_event") {
     ENQUEUE_EVENT(event_queue, 1, 100, b_event, key_down, b_event);
     ENQUEUE_EVENT(event_queue, 1, 100, left_control_event, key_down, left_control_event);
 
-    std::vector<krbn::event_queue::queued_event> expected;
+    std::deque<krbn::event_queue::queued_event> expected;
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_shift_event, key_down, left_shift_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_control_event, key_down, left_control_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, a_event, key_down, a_event);
@@ -312,7 +346,7 @@ TEST_CASE("emplace_back_event") {
     ENQUEUE_EVENT(event_queue, 1, 100, left_control_event, key_down, left_control_event);
     ENQUEUE_EVENT(event_queue, 1, 100, left_shift_event, key_down, left_shift_event);
 
-    std::vector<krbn::event_queue::queued_event> expected;
+    std::deque<krbn::event_queue::queued_event> expected;
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_control_event, key_down, left_control_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_shift_event, key_down, left_shift_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, b_event, key_down, b_event);
@@ -327,7 +361,7 @@ TEST_CASE("emplace_back_event") {
     ENQUEUE_EVENT(event_queue, 1, 100, left_control_event, key_down, left_control_event);
     ENQUEUE_EVENT(event_queue, 1, 100, left_shift_event, key_down, left_shift_event);
 
-    std::vector<krbn::event_queue::queued_event> expected;
+    std::deque<krbn::event_queue::queued_event> expected;
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_control_event, key_down, left_control_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, left_shift_event, key_down, left_shift_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, b_event, key_up, b_event);
@@ -343,7 +377,7 @@ TEST_CASE("emplace_back_event") {
     ENQUEUE_EVENT(event_queue, 1, 100, left_control_event, key_down, left_control_event);
     ENQUEUE_EVENT(event_queue, 1, 100, left_shift_event, key_down, left_shift_event);
 
-    std::vector<krbn::event_queue::queued_event> expected;
+    std::deque<krbn::event_queue::queued_event> expected;
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, b_event, key_up, b_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, a_event, key_up, a_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, device_keys_and_pointing_buttons_are_released_event, single, device_keys_and_pointing_buttons_are_released_event);
@@ -408,7 +442,7 @@ TEST_CASE("emplace_back_event.usage_page") {
   REQUIRE(ENQUEUE_USAGE(event_queue, 1, 500, kHIDPage_GenericDesktop, kHIDUsage_GD_X, 10) == true);
   REQUIRE(ENQUEUE_USAGE(event_queue, 1, 600, kHIDPage_GenericDesktop, kHIDUsage_GD_Y, -10) == true);
 
-  std::vector<krbn::event_queue::queued_event> expected;
+  std::deque<krbn::event_queue::queued_event> expected;
   PUSH_BACK_QUEUED_EVENT(expected, 1, 100, tab_event, key_down, tab_event);
   PUSH_BACK_QUEUED_EVENT(expected, 1, 200, tab_event, key_up, tab_event);
   PUSH_BACK_QUEUED_EVENT(expected, 1, 300, button2_event, key_down, button2_event);
@@ -432,7 +466,7 @@ TEST_CASE("increase_time_stamp_delay") {
 
     ENQUEUE_EVENT(event_queue, 1, 400, tab_event, key_up, tab_event);
 
-    std::vector<krbn::event_queue::queued_event> expected;
+    std::deque<krbn::event_queue::queued_event> expected;
     PUSH_BACK_QUEUED_EVENT(expected, 1, 100, tab_event, key_down, tab_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 210, tab_event, key_up, tab_event);
     PUSH_BACK_QUEUED_EVENT(expected, 1, 310, tab_event, key_down, tab_event);
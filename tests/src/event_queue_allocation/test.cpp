@@ -0,0 +1,234 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "event_queue.hpp"
+#include "manipulator/manipulator_factory.hpp"
+#include "manipulator/manipulator_manager.hpp"
+#include "manipulator/manipulator_managers_connector.hpp"
+#include "thread_utility.hpp"
+#include <atomic>
+#include <boost/optional/optional_io.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+namespace {
+std::atomic<bool> counting(false);
+std::atomic<size_t> allocation_count(0);
+
+class allocation_counter final {
+public:
+  allocation_counter(void) {
+    allocation_count = 0;
+    counting = true;
+  }
+
+  ~allocation_counter(void) {
+    counting = false;
+  }
+
+  size_t get_count(void) const {
+    return allocation_count;
+  }
+};
+
+std::vector<krbn::event_queue::queued_event> load_fixtures(void) {
+  std::vector<krbn::event_queue::queued_event> result;
+
+  std::ifstream ifs("../manipulator/json/manipulator_manager/tests.json");
+  REQUIRE(ifs);
+  for (const auto& test : nlohmann::json::parse(ifs)) {
+    for (const auto& key : {"input_event_queue", "expected_event_queue"}) {
+      if (auto file_path = krbn::json_utility::find_optional<std::string>(test, key)) {
+        std::ifstream f("../manipulator/" + *file_path);
+        REQUIRE(f);
+        for (const auto& j : nlohmann::json::parse(f)) {
+          if (krbn::json_utility::find_json(j, "event")) {
+            result.emplace_back(j);
+          }
+        }
+      }
+    }
+  }
+
+  return result;
+}
+} // namespace
+
+void* operator new(size_t size) {
+  if (counting) {
+    ++allocation_count;
+  }
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+TEST_CASE("initialize") {
+  krbn::thread_utility::register_main_thread();
+}
+
+TEST_CASE("event") {
+  REQUIRE(std::is_trivially_copyable<krbn::event_queue::queued_event::event>::value);
+  REQUIRE(std::is_trivially_copyable<krbn::event_queue::queued_event>::value);
+  REQUIRE(sizeof(krbn::event_queue::queued_event::event) <= 16);
+}
+
+TEST_CASE("key path") {
+  auto queued_events = load_fixtures();
+  REQUIRE(!queued_events.empty());
+
+  std::vector<krbn::event_queue::queued_event> copied_events;
+  copied_events.reserve(queued_events.size());
+
+  size_t key_code_count = 0;
+
+  {
+    allocation_counter counter;
+
+    for (const auto& e : queued_events) {
+      copied_events.push_back(e);
+
+      auto event = copied_events.back().get_event();
+      auto original_event = copied_events.back().get_original_event();
+      if (event.get_key_code() && original_event.get_key_code()) {
+        ++key_code_count;
+      }
+      REQUIRE(event == e.get_event());
+    }
+
+    REQUIRE(counter.get_count() == 0);
+  }
+
+  REQUIRE(key_code_count > 0);
+  REQUIRE(copied_events == queued_events);
+}
+
+TEST_CASE("manipulate") {
+  std::ifstream ifs("../manipulator/json/manipulator_manager/tests.json");
+  REQUIRE(ifs);
+  for (const auto& test : nlohmann::json::parse(ifs)) {
+    krbn::manipulator::manipulator_managers_connector connector;
+    std::vector<std::unique_ptr<krbn::manipulator::manipulator_manager>> manipulator_managers;
+    std::vector<std::shared_ptr<krbn::event_queue>> event_queues;
+
+    krbn::core_configuration::profile::complex_modifications::parameters parameters;
+    for (const auto& rule : test["rules"]) {
+      manipulator_managers.push_back(std::make_unique<krbn::manipulator::manipulator_manager>());
+
+      std::ifstream f("../manipulator/" + rule.get<std::string>());
+      REQUIRE(f);
+      for (const auto& j : nlohmann::json::parse(f)) {
+        manipulator_managers.back()->push_back_manipulator(krbn::manipulator::manipulator_factory::make_manipulator(j, parameters));
+      }
+
+      if (event_queues.empty()) {
+        event_queues.push_back(std::make_shared<krbn::event_queue>());
+        event_queues.push_back(std::make_shared<krbn::event_queue>());
+        connector.emplace_back_connection(*(manipulator_managers.back()),
+                                          event_queues[0],
+                                          event_queues[1]);
+      } else {
+        event_queues.push_back(std::make_shared<krbn::event_queue>());
+        connector.emplace_back_connection(*(manipulator_managers.back()),
+                                          event_queues.back());
+      }
+    }
+
+    std::vector<boost::optional<krbn::event_queue::queued_event>> input_events;
+    {
+      std::ifstream f("../manipulator/" + test["input_event_queue"].get<std::string>());
+      REQUIRE(f);
+      for (const auto& j : nlohmann::json::parse(f)) {
+        if (krbn::json_utility::find_optional<std::string>(j, "action")) {
+          // invalidate_manipulators
+          input_events.push_back(boost::none);
+        } else {
+          input_events.push_back(krbn::event_queue::queued_event(j));
+        }
+      }
+    }
+
+    auto manipulate = [&] {
+      for (const auto& e : input_events) {
+        if (e) {
+          event_queues.front()->push_back_event(*e);
+          connector.manipulate();
+        } else {
+          connector.invalidate_manipulators();
+        }
+      }
+    };
+
+    // The first pass grows the event queues and the manipulator states.
+
+    manipulate();
+
+    {
+      std::ifstream f("../manipulator/" + test["expected_event_queue"].get<std::string>());
+      REQUIRE(f);
+      REQUIRE(nlohmann::json(event_queues.back()->get_events()).dump() == nlohmann::json::parse(f).dump());
+    }
+
+    // Events must not allocate in the later passes.
+    // (std::deque still allocates a block per several events and it is the only allocation in the steady state.)
+
+    event_queues.back()->clear_events();
+
+    {
+      allocation_counter counter;
+
+      size_t pass_count = 100;
+      for (size_t i = 0; i < pass_count; ++i) {
+        manipulate();
+        event_queues.back()->clear_events();
+      }
+
+      REQUIRE(counter.get_count() < input_events.size() * pass_count);
+    }
+  }
+}
+
+TEST_CASE("payload events") {
+  std::vector<krbn::event_queue::queued_event::event> events;
+  events.push_back(krbn::event_queue::queued_event::event::make_shell_command_event("open -a Safari"));
+  events.push_back(krbn::event_queue::queued_event::event::make_set_variable_event(std::make_pair("variable1", 1)));
+  events.push_back(krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.apple.Terminal",
+                                                                                                   "/Applications/Utilities/Terminal.app"));
+  events.push_back(krbn::event_queue::queued_event::event::make_keyboard_type_changed_event("iso"));
+
+  std::vector<krbn::event_queue::queued_event::event> copied_events;
+  copied_events.reserve(events.size());
+
+  {
+    allocation_counter counter;
+
+    for (const auto& e : events) {
+      copied_events.push_back(e);
+    }
+
+    REQUIRE(counter.get_count() == 0);
+  }
+
+  REQUIRE(copied_events == events);
+
+  // Same payloads share the same entry.
+  REQUIRE(krbn::event_queue::queued_event::event::make_shell_command_event("open -a Safari") == events[0]);
+  REQUIRE(!(krbn::event_queue::queued_event::event::make_shell_command_event("open -a Mail") == events[0]));
+
+  REQUIRE(copied_events[0].get_shell_command() == std::string("open -a Safari"));
+  {
+    auto v = copied_events[1].get_set_variable();
+    REQUIRE(static_cast<bool>(v));
+    REQUIRE(krbn::variable_name_table::get_instance().get_name(v->first) == "variable1");
+    REQUIRE(v->second == 1);
+  }
+  REQUIRE(copied_events[2].get_frontmost_application()->get_bundle_identifier() == "com.apple.Terminal");
+  REQUIRE(copied_events[3].get_keyboard_type() == std::string("iso"));
+  REQUIRE(copied_events[3].get_shell_command() == boost::none);
+}
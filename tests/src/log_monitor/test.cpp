@@ -0,0 +1,216 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "log_monitor.hpp"
+#include "thread_utility.hpp"
+#include <condition_variable>
+#include <iomanip>
+
+namespace {
+std::string make_line(int second, const std::string& message) {
+  std::stringstream ss;
+  ss << "[2017-01-01 00:" << std::setw(2) << std::setfill('0') << second / 60
+     << ":" << std::setw(2) << std::setfill('0') << second % 60
+     << ".000] [info] [test] " << message;
+  return ss.str();
+}
+
+void append(const std::string& file_path, const std::string& text) {
+  std::ofstream stream(file_path, std::ios::app);
+  stream << text;
+}
+
+// A watcher which is triggered manually.
+class manual_watcher final : public krbn::file_modification_watcher {
+public:
+  manual_watcher(const krbn::file_modification_watcher::callback& callback) {
+    get_callback() = callback;
+  }
+
+  virtual ~manual_watcher(void) {
+    get_callback() = nullptr;
+  }
+
+  static krbn::file_modification_watcher::callback& get_callback(void) {
+    static krbn::file_modification_watcher::callback callback;
+    return callback;
+  }
+
+  static std::unique_ptr<krbn::file_modification_watcher> make(const std::vector<std::string>& files,
+                                                               const krbn::file_modification_watcher::callback& callback) {
+    return std::make_unique<manual_watcher>(callback);
+  }
+};
+
+void prepare(void) {
+  system("rm -rf tmp");
+  system("mkdir -p tmp");
+}
+} // namespace
+
+TEST_CASE("initialize") {
+  krbn::thread_utility::register_main_thread();
+}
+
+TEST_CASE("initial_lines") {
+  prepare();
+
+  // a.log.1: 0, 2, 4, ...,  398
+  // a.log:   400, 402, ..., 598
+  // b.log:   1, 3, 5, ...,  599
+  for (int i = 0; i < 600; i += 2) {
+    append(i < 400 ? "tmp/a.log.1" : "tmp/a.log", make_line(i, "a") + "\n");
+    append("tmp/b.log", make_line(i + 1, "b") + "\n");
+  }
+  append("tmp/b.log", "invalid line\n");
+  // The last line is not terminated.
+  append("tmp/b.log", make_line(600, "b"));
+
+  krbn::log_monitor log_monitor({"tmp/a.log", "tmp/b.log"},
+                                nullptr,
+                                manual_watcher::make);
+
+  auto& initial_lines = log_monitor.get_initial_lines();
+  REQUIRE(initial_lines.size() == krbn::log_monitor::get_max_initial_lines());
+  for (size_t i = 0; i < initial_lines.size(); ++i) {
+    int second = 600 - static_cast<int>(krbn::log_monitor::get_max_initial_lines()) + static_cast<int>(i);
+    REQUIRE(initial_lines[i].second == make_line(second, second % 2 == 0 ? "a" : "b"));
+  }
+
+  // Lines which have the same sort key are ordered by targets.
+  {
+    prepare();
+
+    append("tmp/a.log", make_line(1, "a1") + "\n");
+    append("tmp/b.log", make_line(0, "b0") + "\n" + make_line(1, "b1") + "\n");
+    append("tmp/a.log.1", make_line(1, "a.1") + "\n");
+
+    krbn::log_monitor log_monitor({"tmp/a.log", "tmp/b.log"},
+                                  nullptr,
+                                  manual_watcher::make);
+
+    std::vector<std::string> expected{
+        make_line(0, "b0"),
+        make_line(1, "a.1"),
+        make_line(1, "a1"),
+        make_line(1, "b1"),
+    };
+    std::vector<std::string> actual;
+    for (const auto& l : log_monitor.get_initial_lines()) {
+      actual.push_back(l.second);
+    }
+    REQUIRE(actual == expected);
+  }
+}
+
+TEST_CASE("start") {
+  prepare();
+
+  append("tmp/a.log", make_line(0, "initial") + "\n");
+  append("tmp/b.log", make_line(1, "partial"));
+
+  std::vector<std::string> lines;
+  krbn::log_monitor log_monitor({"tmp/a.log", "tmp/b.log"},
+                                [&](const std::string& line) {
+                                  lines.push_back(line);
+                                },
+                                manual_watcher::make);
+
+  REQUIRE(log_monitor.get_initial_lines().size() == 1);
+
+  // Lines which are appended before `start` are reported at `start`.
+  append("tmp/a.log", make_line(2, "a") + "\n");
+  append("tmp/b.log", " line\n");
+
+  log_monitor.start();
+  REQUIRE(lines == std::vector<std::string>({
+                       make_line(1, "partial line"),
+                       make_line(2, "a"),
+                   }));
+
+  // Merge appended lines.
+  lines.clear();
+  append("tmp/a.log", make_line(3, "a") + "\n" + make_line(5, "a") + "\n" + make_line(7, "a"));
+  append("tmp/b.log", make_line(4, "b") + "\n" + make_line(6, "b") + "\n");
+  manual_watcher::get_callback()();
+  REQUIRE(lines == std::vector<std::string>({
+                       make_line(3, "a"),
+                       make_line(4, "b"),
+                       make_line(5, "a"),
+                       make_line(6, "b"),
+                   }));
+
+  // No change
+  lines.clear();
+  manual_watcher::get_callback()();
+  REQUIRE(lines.empty());
+
+  // Log rotation
+  lines.clear();
+  append("tmp/a.log", "\n");
+  system("mv tmp/b.log tmp/b.log.1");
+  append("tmp/b.log", make_line(8, "b") + "\n");
+  manual_watcher::get_callback()();
+  REQUIRE(lines == std::vector<std::string>({
+                       make_line(7, "a"),
+                       make_line(8, "b"),
+                   }));
+
+  // Truncation
+  lines.clear();
+  truncate("tmp/a.log", 0);
+  append("tmp/a.log", make_line(9, "a") + "\n");
+  manual_watcher::get_callback()();
+  REQUIRE(lines == std::vector<std::string>({
+                       make_line(9, "a"),
+                   }));
+}
+
+TEST_CASE("file_modification_watcher") {
+  prepare();
+
+  append("tmp/a.log", make_line(0, "initial") + "\n");
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::string> lines;
+
+  krbn::log_monitor log_monitor({"tmp/a.log", "tmp/b.log"},
+                                [&](const std::string& line) {
+                                  {
+                                    std::lock_guard<std::mutex> lock(mutex);
+                                    lines.push_back(line);
+                                  }
+                                  cv.notify_one();
+                                });
+  log_monitor.start();
+
+  auto wait = [&](size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_for(lock,
+                       std::chrono::seconds(5),
+                       [&] {
+                         return lines.size() >= count;
+                       });
+  };
+
+  // Append
+  append("tmp/a.log", make_line(1, "a") + "\n");
+  REQUIRE(wait(1));
+
+  // Create
+  append("tmp/b.log", make_line(2, "b") + "\n");
+  REQUIRE(wait(2));
+
+  // Log rotation
+  system("mv tmp/a.log tmp/a.log.1");
+  append("tmp/a.log", make_line(3, "a") + "\n");
+  REQUIRE(wait(3));
+
+  std::lock_guard<std::mutex> lock(mutex);
+  REQUIRE(lines == std::vector<std::string>({
+                       make_line(1, "a"),
+                       make_line(2, "b"),
+                       make_line(3, "a"),
+                   }));
+}
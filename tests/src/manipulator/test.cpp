@@ -2,7 +2,10 @@
 #include "../../vendor/catch/catch.hpp"
 
 #include "../share/manipulator_helper.hpp"
+#include "manipulator/compiled_rule_set.hpp"
 #include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "manipulator/details/simple_modifications.hpp"
+#include "manipulator/manipulate_batcher.hpp"
 #include "thread_utility.hpp"
 #include <boost/optional/optional_io.hpp>
 
@@ -88,12 +91,12 @@ TEST_CASE("manipulator_timer") {
   REQUIRE(krbn::manipulator::manipulator_timer::get_instance().get_entries().empty());
 
   std::vector<krbn::manipulator::manipulator_timer::timer_id> timer_ids;
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345));
-  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234, [] {}));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(1234, [] {}));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678, [] {}));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(5678, [] {}));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345, [] {}));
+  timer_ids.push_back(krbn::manipulator::manipulator_timer::get_instance().add_entry(2345, [] {}));
 
   REQUIRE(krbn::manipulator::manipulator_timer::get_instance().get_entries().size() == 6);
   REQUIRE(krbn::manipulator::manipulator_timer::get_instance().get_entries()[0].get_when() == 1234);
@@ -110,6 +113,67 @@ TEST_CASE("manipulator_timer") {
   REQUIRE(krbn::manipulator::manipulator_timer::get_instance().get_entries()[5].get_timer_id() == timer_ids[3]);
 }
 
+TEST_CASE("compiled_rule_set") {
+  auto make_rule = [](const std::string& from, const std::string& to) {
+    return nlohmann::json({
+        {"description", from + " -> " + to},
+        {"manipulators", {
+                             {
+                                 {"type", "basic"},
+                                 {"from", {{"key_code", from}}},
+                                 {"to", {{{"key_code", to}}}},
+                                 {"conditions", {
+                                                    {
+                                                        {"type", "frontmost_application_if"},
+                                                        {"bundle_identifiers", {"^com\\.apple\\.Terminal$"}},
+                                                    },
+                                                }},
+                             },
+                         }},
+    });
+  };
+
+  krbn::manipulator::compiled_rule_set compiled_rule_set;
+
+  {
+    krbn::core_configuration::profile::complex_modifications complex_modifications(nlohmann::json({
+        {"rules", {
+                      make_rule("a", "b"),
+                      make_rule("c", "d"),
+                  }},
+    }));
+    compiled_rule_set.update(complex_modifications);
+
+    REQUIRE(compiled_rule_set.get_manipulators_size() == 2);
+    REQUIRE(compiled_rule_set.get_manipulator_cache_size() == 2);
+    REQUIRE(compiled_rule_set.get_condition_cache_size() == 1);
+
+    krbn::manipulator::manipulator_manager manipulator_manager;
+    compiled_rule_set.push_back_manipulators(manipulator_manager);
+    compiled_rule_set.push_back_manipulators(manipulator_manager);
+    REQUIRE(manipulator_manager.get_manipulators_size() == 4);
+  }
+
+  {
+    // Update with a changed rule and different parameters.
+
+    krbn::core_configuration::profile::complex_modifications complex_modifications(nlohmann::json({
+        {"rules", {
+                      make_rule("a", "b"),
+                      make_rule("e", "f"),
+                  }},
+        {"parameters", {
+                           {"basic.to_if_alone_timeout_milliseconds", 500},
+                       }},
+    }));
+    compiled_rule_set.update(complex_modifications);
+
+    REQUIRE(compiled_rule_set.get_manipulators_size() == 2);
+    REQUIRE(compiled_rule_set.get_manipulator_cache_size() == 4);
+    REQUIRE(compiled_rule_set.get_condition_cache_size() == 1);
+  }
+}
+
 TEST_CASE("needs_virtual_hid_pointing") {
   for (const auto& file_name : {
            std::string("json/needs_virtual_hid_pointing_test1.json"),
@@ -138,3 +202,404 @@ TEST_CASE("needs_virtual_hid_pointing") {
     }
   }
 }
+
+namespace {
+class simple_modifications_pair final {
+public:
+  simple_modifications_pair(const from_event_definition& from,
+                            const to_event_definition& to,
+                            const std::shared_ptr<krbn::manipulator::details::conditions::device>& device_condition) : from(from),
+                                                                                                                       to(to),
+                                                                                                                       device_condition(device_condition) {
+  }
+
+  from_event_definition from;
+  to_event_definition to;
+  std::shared_ptr<krbn::manipulator::details::conditions::device> device_condition;
+};
+} // namespace
+
+TEST_CASE("simple_modifications") {
+  auto device_id_1000_2000 = krbn::types::make_new_device_id(std::make_shared<krbn::device_detail>(nlohmann::json({
+      {"vendor_id", 1000},
+      {"product_id", 2000},
+      {"is_keyboard", true},
+      {"is_pointing_device", false},
+  })));
+  auto device_id_1001_2001 = krbn::types::make_new_device_id(std::make_shared<krbn::device_detail>(nlohmann::json({
+      {"vendor_id", 1001},
+      {"product_id", 2001},
+      {"is_keyboard", true},
+      {"is_pointing_device", false},
+  })));
+  auto unknown_device_id = krbn::device_id(99999);
+
+  auto device_condition = std::make_shared<krbn::manipulator::details::conditions::device>(nlohmann::json({
+      {"type", "device_if"},
+      {"identifiers", {
+                          {
+                              {"vendor_id", 1000},
+                              {"product_id", 2000},
+                          },
+                      }},
+  }));
+
+  // The same pairs as device_grabber::update_fn_function_keys_manipulators.
+
+  std::vector<simple_modifications_pair> pairs;
+  pairs.emplace_back(from_event_definition(krbn::key_code::f1, {event_definition::modifier::fn}, {event_definition::modifier::any}),
+                     to_event_definition(krbn::key_code::f1, {event_definition::modifier::fn}),
+                     nullptr);
+  pairs.emplace_back(from_event_definition(krbn::key_code::a, {}, {event_definition::modifier::any}),
+                     to_event_definition(krbn::key_code::b, {}),
+                     device_condition);
+  pairs.emplace_back(from_event_definition(krbn::key_code::f1, {}, {event_definition::modifier::any}),
+                     to_event_definition(krbn::key_code::display_brightness_decrement, {}),
+                     device_condition);
+  pairs.emplace_back(from_event_definition(krbn::key_code::a, {}, {event_definition::modifier::any}),
+                     to_event_definition(krbn::key_code::c, {}),
+                     nullptr);
+  pairs.emplace_back(from_event_definition(krbn::key_code::f1, {}, {event_definition::modifier::any}),
+                     to_event_definition(krbn::key_code::mute, {}),
+                     nullptr);
+  pairs.emplace_back(from_event_definition(nlohmann::json({{"key_code", "caps_lock"}, {"modifiers", {{"optional", {"any"}}}}})),
+                     to_event_definition(nlohmann::json({{"key_code", "left_control"}})),
+                     nullptr);
+  pairs.emplace_back(from_event_definition(nlohmann::json({{"pointing_button", "button1"}, {"modifiers", {{"optional", {"any"}}}}})),
+                     to_event_definition(nlohmann::json({{"pointing_button", "button2"}})),
+                     nullptr);
+  pairs.emplace_back(from_event_definition(nlohmann::json({{"consumer_key_code", "mute"}, {"modifiers", {{"optional", {"any"}}}}})),
+                     to_event_definition(nlohmann::json({{"key_code", "escape"}})),
+                     nullptr);
+  pairs.emplace_back(from_event_definition(krbn::key_code::return_or_enter, {event_definition::modifier::fn}, {event_definition::modifier::any}),
+                     to_event_definition(krbn::key_code::keypad_enter, {event_definition::modifier::fn}),
+                     nullptr);
+
+  // Expected: one basic manipulator for each pair.
+
+  krbn::manipulator::manipulator_manager basic_manipulator_manager;
+  for (const auto& p : pairs) {
+    auto m = std::make_shared<krbn::manipulator::details::basic>(p.from, p.to);
+    if (p.device_condition) {
+      m->push_back_condition(p.device_condition);
+    }
+    basic_manipulator_manager.push_back_manipulator(m);
+  }
+
+  // Actual
+
+  krbn::manipulator::manipulator_manager simple_modifications_manipulator_manager;
+  {
+    auto m = std::make_shared<krbn::manipulator::details::simple_modifications>();
+    for (const auto& p : pairs) {
+      m->push_back_pair(p.from, p.to, p.device_condition);
+    }
+    REQUIRE(m->get_pairs_size() == pairs.size());
+    simple_modifications_manipulator_manager.push_back_manipulator(m->clone());
+  }
+
+  // Events
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  uint64_t time_stamp = 0;
+  for (const auto& device_id : {device_id_1000_2000, device_id_1001_2001, unknown_device_id}) {
+    auto push = [&](const krbn::event_queue::queued_event::event& e, krbn::event_type event_type) {
+      input_event_queue->emplace_back_event(device_id, time_stamp += 100, e, event_type, e);
+    };
+    krbn::event_queue::queued_event::event a(krbn::key_code::a);
+    krbn::event_queue::queued_event::event f1(krbn::key_code::f1);
+    krbn::event_queue::queued_event::event fn(krbn::key_code::fn);
+    krbn::event_queue::queued_event::event return_or_enter(krbn::key_code::return_or_enter);
+    krbn::event_queue::queued_event::event caps_lock(krbn::key_code::caps_lock);
+    krbn::event_queue::queued_event::event spacebar(krbn::key_code::spacebar);
+    krbn::event_queue::queued_event::event button1(krbn::pointing_button::button1);
+    krbn::event_queue::queued_event::event mute(krbn::consumer_key_code::mute);
+
+    push(a, krbn::event_type::key_down);
+    push(a, krbn::event_type::key_up);
+    push(f1, krbn::event_type::key_down);
+    push(f1, krbn::event_type::key_up);
+
+    // fn+f1
+    push(fn, krbn::event_type::key_down);
+    push(f1, krbn::event_type::key_down);
+    push(f1, krbn::event_type::key_up);
+    push(fn, krbn::event_type::key_up);
+
+    // fn is released before return_or_enter.
+    push(fn, krbn::event_type::key_down);
+    push(return_or_enter, krbn::event_type::key_down);
+    push(fn, krbn::event_type::key_up);
+    push(return_or_enter, krbn::event_type::key_up);
+
+    // Overlapped keys
+    push(caps_lock, krbn::event_type::key_down);
+    push(a, krbn::event_type::key_down);
+    push(spacebar, krbn::event_type::key_down);
+    push(caps_lock, krbn::event_type::key_up);
+    push(spacebar, krbn::event_type::key_up);
+    push(a, krbn::event_type::key_up);
+
+    push(button1, krbn::event_type::key_down);
+    push(mute, krbn::event_type::key_down);
+    push(button1, krbn::event_type::key_up);
+    push(mute, krbn::event_type::key_up);
+  }
+
+  auto expected_input_event_queue = std::make_shared<krbn::event_queue>();
+  for (const auto& e : input_event_queue->get_events()) {
+    expected_input_event_queue->push_back_event(e);
+  }
+
+  auto expected_output_event_queue = std::make_shared<krbn::event_queue>();
+  basic_manipulator_manager.manipulate(expected_input_event_queue, expected_output_event_queue);
+
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+  simple_modifications_manipulator_manager.manipulate(input_event_queue, output_event_queue);
+
+  REQUIRE(output_event_queue->get_events().size() > 66);
+  REQUIRE(output_event_queue->get_events() == expected_output_event_queue->get_events());
+
+  // key_up is sent by the pair which manipulated key_down even if manipulators are invalidated.
+  {
+    auto device_id = device_id_1000_2000;
+    krbn::event_queue::queued_event::event a(krbn::key_code::a);
+
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, a, krbn::event_type::key_down, a);
+    simple_modifications_manipulator_manager.manipulate(input_event_queue, output_event_queue);
+
+    simple_modifications_manipulator_manager.invalidate_manipulators();
+    REQUIRE(simple_modifications_manipulator_manager.get_manipulators_size() == 1);
+
+    output_event_queue->clear_events();
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, a, krbn::event_type::key_up, a);
+    simple_modifications_manipulator_manager.manipulate(input_event_queue, output_event_queue);
+
+    REQUIRE(output_event_queue->get_events().size() == 1);
+    REQUIRE(output_event_queue->get_events()[0].get_event() == krbn::event_queue::queued_event::event(krbn::key_code::b));
+    REQUIRE(output_event_queue->get_events()[0].get_event_type() == krbn::event_type::key_up);
+    REQUIRE(simple_modifications_manipulator_manager.get_manipulators_size() == 0);
+  }
+}
+
+TEST_CASE("manipulator_managers_connector") {
+  auto device_id = krbn::types::make_new_device_id(std::make_shared<krbn::device_detail>(nlohmann::json({
+      {"vendor_id", 1000},
+      {"product_id", 2000},
+      {"is_keyboard", true},
+      {"is_pointing_device", false},
+  })));
+
+  krbn::manipulator::manipulator_manager manager1;
+  manager1.push_back_manipulator(std::make_shared<krbn::manipulator::details::basic>(
+      from_event_definition(krbn::key_code::a, {}, {event_definition::modifier::any}),
+      to_event_definition(krbn::key_code::b, {})));
+
+  // An empty stage
+  krbn::manipulator::manipulator_manager manager2;
+
+  // The last stage is never bypassed even if it is empty.
+  krbn::manipulator::manipulator_manager manager3;
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto event_queue1 = std::make_shared<krbn::event_queue>();
+  auto event_queue2 = std::make_shared<krbn::event_queue>();
+  auto output_event_queue = std::make_shared<krbn::event_queue>();
+
+  krbn::manipulator::manipulator_managers_connector connector;
+  connector.emplace_back_connection(manager1, input_event_queue, event_queue1);
+  connector.emplace_back_connection(manager2, event_queue2);
+  connector.emplace_back_connection(manager3, output_event_queue);
+
+  uint64_t time_stamp = 0;
+  krbn::event_queue::queued_event::event a(krbn::key_code::a);
+  krbn::event_queue::queued_event::event b(krbn::key_code::b);
+  krbn::event_queue::queued_event::event c(krbn::key_code::c);
+  krbn::event_queue::queued_event::event left_shift(krbn::key_code::left_shift);
+  auto frontmost_application_changed = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.apple.Terminal",
+                                                                                                                          "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal");
+
+  // Events pass through the empty stage.
+  {
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, frontmost_application_changed, krbn::event_type::single, frontmost_application_changed);
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, left_shift, krbn::event_type::key_down, left_shift);
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, a, krbn::event_type::key_down, a);
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, a, krbn::event_type::key_up, a);
+    connector.manipulate();
+
+    REQUIRE(input_event_queue->empty());
+    REQUIRE(event_queue1->empty());
+    REQUIRE(event_queue2->empty());
+
+    auto expected = std::make_shared<krbn::event_queue>();
+    expected->emplace_back_event(device_id, 100, frontmost_application_changed, krbn::event_type::single, frontmost_application_changed);
+    expected->emplace_back_event(device_id, 200, left_shift, krbn::event_type::key_down, left_shift);
+    expected->emplace_back_event(device_id, 300, b, krbn::event_type::key_down, a);
+    expected->emplace_back_event(device_id, 400, b, krbn::event_type::key_up, a);
+    REQUIRE(output_event_queue->get_events() == expected->get_events());
+
+    // The state of the bypassed queue is kept.
+    REQUIRE(event_queue2->get_modifier_flag_manager().is_pressed(krbn::modifier_flag::left_shift));
+    REQUIRE(event_queue2->get_manipulator_environment().get_frontmost_application().get_bundle_identifier() == "com.apple.Terminal");
+
+    output_event_queue->clear_events();
+  }
+
+  // The stage uses the kept state after manipulators are added.
+  {
+    manager2.push_back_manipulator(std::make_shared<krbn::manipulator::details::basic>(
+        from_event_definition(krbn::key_code::b, {event_definition::modifier::left_shift}, {}),
+        to_event_definition(krbn::key_code::c, {})));
+
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, a, krbn::event_type::key_down, a);
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, a, krbn::event_type::key_up, a);
+    connector.manipulate();
+
+    REQUIRE(std::any_of(std::begin(output_event_queue->get_events()),
+                        std::end(output_event_queue->get_events()),
+                        [&](const auto& e) {
+                          return e.get_event() == c && e.get_event_type() == krbn::event_type::key_down;
+                        }));
+    REQUIRE(std::none_of(std::begin(output_event_queue->get_events()),
+                         std::end(output_event_queue->get_events()),
+                         [&](const auto& e) {
+                           return e.get_event() == b;
+                         }));
+
+    output_event_queue->clear_events();
+  }
+
+  // device_ungrabbed resets the state of the bypassed queue.
+  {
+    manager2.invalidate_manipulators();
+    REQUIRE(manager2.get_manipulators_size() == 0);
+
+    auto device_ungrabbed = krbn::event_queue::queued_event::event::make_device_ungrabbed_event();
+    input_event_queue->emplace_back_event(device_id, time_stamp += 100, device_ungrabbed, krbn::event_type::single, device_ungrabbed);
+    connector.manipulate();
+
+    REQUIRE(event_queue2->empty());
+    REQUIRE(!event_queue2->get_modifier_flag_manager().is_pressed(krbn::modifier_flag::left_shift));
+  }
+}
+
+TEST_CASE("manipulate_batcher") {
+  auto scheduler = std::make_shared<krbn::virtual_scheduler>(1000000000);
+  krbn::scheduler::set_instance(scheduler);
+
+  auto device_id = krbn::device_id(1);
+  auto ms = krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC);
+
+  krbn::manipulator::manipulator_manager manipulator_manager;
+  auto post_event_to_virtual_devices = std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>();
+  manipulator_manager.push_back_manipulator(post_event_to_virtual_devices);
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto posted_event_queue = std::make_shared<krbn::event_queue>();
+
+  krbn::manipulator::manipulator_managers_connector connector;
+  connector.emplace_back_connection(manipulator_manager, input_event_queue, posted_event_queue);
+
+  size_t manipulate_count = 0;
+  krbn::manipulator::manipulate_batcher batcher(input_event_queue, [&] {
+    connector.manipulate();
+    posted_event_queue->clear_events();
+    ++manipulate_count;
+  });
+
+  auto push_back_event = [&](const krbn::event_queue::queued_event::event& e, krbn::event_type event_type) {
+    input_event_queue->emplace_back_event(device_id, scheduler->now(), e, event_type, e);
+    batcher.request();
+  };
+
+  auto count_keyboard_events = [&](uint32_t value) {
+    return std::count_if(std::begin(post_event_to_virtual_devices->get_queue().get_events()),
+                         std::end(post_event_to_virtual_devices->get_queue().get_events()),
+                         [&](const auto& e) {
+                           auto keyboard_event = e.get_keyboard_event();
+                           return keyboard_event && keyboard_event->value == value;
+                         });
+  };
+
+  krbn::event_queue::queued_event::event a(krbn::key_code::a);
+  krbn::event_queue::queued_event::event b(krbn::key_code::b);
+
+  // An isolated event is processed immediately.
+  {
+    push_back_event(a, krbn::event_type::key_down);
+
+    REQUIRE(manipulate_count == 1);
+    REQUIRE(!batcher.pending());
+    REQUIRE(input_event_queue->empty());
+    REQUIRE(count_keyboard_events(1) == 1);
+  }
+
+  // Events in a burst are deferred.
+  {
+    scheduler->advance(ms / 2);
+    push_back_event(b, krbn::event_type::key_down);
+
+    REQUIRE(manipulate_count == 1);
+    REQUIRE(batcher.pending());
+    REQUIRE(input_event_queue->get_events().size() == 1);
+  }
+
+  // `flush` processes pending events at once. (device_grabber calls `flush` after device_ungrabbed.)
+  // Held keys are released without waiting for the main queue.
+  {
+    auto device_ungrabbed = krbn::event_queue::queued_event::event::make_device_ungrabbed_event();
+    input_event_queue->emplace_back_event(device_id, scheduler->now(), device_ungrabbed, krbn::event_type::single, device_ungrabbed);
+    batcher.flush();
+
+    REQUIRE(manipulate_count == 2);
+    REQUIRE(!batcher.pending());
+    REQUIRE(input_event_queue->empty());
+    REQUIRE(count_keyboard_events(1) == 2);
+    REQUIRE(count_keyboard_events(0) == 2);
+
+    // The canceled timer does not call `manipulate`.
+    scheduler->run_until_idle();
+    REQUIRE(manipulate_count == 2);
+
+    // `flush` does nothing without pending events.
+    batcher.flush();
+    REQUIRE(manipulate_count == 2);
+
+    post_event_to_virtual_devices->clear_queue();
+  }
+
+  // Deferred events are processed at the next turn.
+  {
+    scheduler->advance(100 * ms);
+    push_back_event(a, krbn::event_type::key_down);
+    REQUIRE(manipulate_count == 3);
+
+    scheduler->advance(ms / 2);
+    push_back_event(a, krbn::event_type::key_up);
+    REQUIRE(manipulate_count == 3);
+
+    scheduler->run_until_idle();
+    REQUIRE(manipulate_count == 4);
+    REQUIRE(input_event_queue->empty());
+    REQUIRE(count_keyboard_events(0) == 1);
+
+    post_event_to_virtual_devices->clear_queue();
+  }
+
+  // A large batch is processed immediately.
+  {
+    scheduler->advance(100 * ms);
+    push_back_event(a, krbn::event_type::key_down);
+    REQUIRE(manipulate_count == 5);
+
+    for (size_t i = 0; i < krbn::manipulator::manipulate_batcher::get_max_batch_size(); ++i) {
+      krbn::event_queue::queued_event::event e(krbn::event_queue::queued_event::event::type::pointing_x, 1);
+      push_back_event(e, krbn::event_type::single);
+    }
+    REQUIRE(manipulate_count == 6);
+    REQUIRE(input_event_queue->empty());
+  }
+
+  scheduler->run_until_idle();
+  krbn::scheduler::set_instance(nullptr);
+}
@@ -154,6 +154,27 @@ TEST_CASE("manipulator_environment.save_to_file") {
   manipulator_environment.set_variable("value1", 100);
   manipulator_environment.set_variable("value2", 200);
   manipulator_environment.set_keyboard_type("iso");
+  manipulator_environment.flush_json_output();
+
+  {
+    std::ifstream ifs("tmp/manipulator_environment.json");
+    REQUIRE(ifs);
+    REQUIRE(nlohmann::json::parse(ifs) == manipulator_environment.to_json());
+  }
+
+  // The file is not updated after `disable_json_output`.
+
+  auto expected = manipulator_environment.to_json();
+
+  manipulator_environment.disable_json_output();
+  manipulator_environment.set_variable("value1", 300);
+  manipulator_environment.flush_json_output();
+
+  {
+    std::ifstream ifs("tmp/manipulator_environment.json");
+    REQUIRE(ifs);
+    REQUIRE(nlohmann::json::parse(ifs) == expected);
+  }
 }
 
 TEST_CASE("conditions.frontmost_application") {
@@ -311,6 +332,16 @@ TEST_CASE("conditions.device") {
                                                         manipulator_environment) == true);
     REQUIRE(helper.get_condition_manager().is_fulfilled(QUEUED_EVENT(device_id_1099_9999),
                                                         manipulator_environment) == true);
+
+    // Cached results
+    REQUIRE(helper.get_condition_manager().is_fulfilled(QUEUED_EVENT(device_id_8888_9999),
+                                                        manipulator_environment) == false);
+    REQUIRE(helper.get_condition_manager().is_fulfilled(QUEUED_EVENT(device_id_1000_2000),
+                                                        manipulator_environment) == true);
+
+    // Unknown device
+    REQUIRE(helper.get_condition_manager().is_fulfilled(QUEUED_EVENT(krbn::device_id(100000)),
+                                                        manipulator_environment) == false);
   }
   {
     actual_examples_helper helper("device_unless.json");
@@ -435,3 +466,146 @@ TEST_CASE("conditions.keyboard_type") {
                                                         manipulator_environment) == true);
   }
 }
+
+TEST_CASE("conditions.variable") {
+  krbn::manipulator_environment manipulator_environment;
+  krbn::event_queue::queued_event queued_event(krbn::device_id(1),
+                                               0,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a),
+                                               krbn::event_type::key_down,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a));
+
+  krbn::manipulator::details::conditions::variable variable_if(nlohmann::json({
+      {"type", "variable_if"},
+      {"name", "conditions.variable"},
+      {"value", 1},
+  }));
+  krbn::manipulator::details::conditions::variable variable_unless(nlohmann::json({
+      {"type", "variable_unless"},
+      {"name", "conditions.variable"},
+      {"value", 1},
+  }));
+
+  REQUIRE(variable_if.is_fulfilled(queued_event, manipulator_environment) == false);
+  REQUIRE(variable_unless.is_fulfilled(queued_event, manipulator_environment) == true);
+
+  // Names and ids are interchangeable.
+  auto id = krbn::variable_name_table::get_instance().intern("conditions.variable");
+  REQUIRE(krbn::variable_name_table::get_instance().intern("conditions.variable") == id);
+  REQUIRE(krbn::variable_name_table::get_instance().get_name(id) == "conditions.variable");
+  REQUIRE(*(krbn::variable_name_table::get_instance().find("conditions.variable")) == id);
+
+  {
+    auto size = krbn::variable_name_table::get_instance().size();
+    REQUIRE(!krbn::variable_name_table::get_instance().find("conditions.unknown_variable"));
+    REQUIRE(krbn::manipulator_environment().get_variable("conditions.unknown_variable") == 0);
+    REQUIRE(krbn::variable_name_table::get_instance().size() == size);
+  }
+
+  manipulator_environment.set_variable(id, 1);
+  REQUIRE(manipulator_environment.get_variable("conditions.variable") == 1);
+  REQUIRE(variable_if.is_fulfilled(queued_event, manipulator_environment) == true);
+  REQUIRE(variable_unless.is_fulfilled(queued_event, manipulator_environment) == false);
+
+  manipulator_environment.set_variable("conditions.variable", 2);
+  REQUIRE(manipulator_environment.get_variable(id) == 2);
+  REQUIRE(variable_if.is_fulfilled(queued_event, manipulator_environment) == false);
+  REQUIRE(variable_unless.is_fulfilled(queued_event, manipulator_environment) == true);
+
+  REQUIRE(manipulator_environment.to_json()["variables"] == nlohmann::json({{"conditions.variable", 2}}));
+}
+
+TEST_CASE("manipulator_environment.generation") {
+  krbn::manipulator_environment manipulator_environment1;
+  krbn::manipulator_environment manipulator_environment2;
+
+  // Generations are unique among instances.
+  REQUIRE(manipulator_environment1.get_frontmost_application_generation() != manipulator_environment2.get_frontmost_application_generation());
+  REQUIRE(manipulator_environment1.get_variables_generation() != manipulator_environment2.get_variables_generation());
+
+  {
+    auto generation = manipulator_environment1.get_keyboard_type_generation();
+
+    manipulator_environment1.set_keyboard_type("iso");
+    REQUIRE(manipulator_environment1.get_keyboard_type_generation() != generation);
+    generation = manipulator_environment1.get_keyboard_type_generation();
+
+    // The generation is not changed if the value is not changed.
+    manipulator_environment1.set_keyboard_type("iso");
+    REQUIRE(manipulator_environment1.get_keyboard_type_generation() == generation);
+  }
+  {
+    auto generation = manipulator_environment1.get_variables_generation();
+
+    manipulator_environment1.set_variable("generation.variable", 1);
+    REQUIRE(manipulator_environment1.get_variables_generation() != generation);
+    generation = manipulator_environment1.get_variables_generation();
+
+    manipulator_environment1.set_variable("generation.variable", 1);
+    REQUIRE(manipulator_environment1.get_variables_generation() == generation);
+  }
+}
+
+TEST_CASE("condition_manager") {
+  krbn::event_queue::queued_event queued_event(krbn::device_id(1),
+                                               0,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a),
+                                               krbn::event_type::key_down,
+                                               krbn::event_queue::queued_event::event(krbn::key_code::a));
+
+  auto keyboard_type_condition = krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+      {"type", "keyboard_type_if"},
+      {"keyboard_types", {"iso"}},
+  }));
+  auto variable_condition = krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+      {"type", "variable_if"},
+      {"name", "condition_manager.variable"},
+      {"value", 1},
+  }));
+  auto frontmost_application_condition = krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+      {"type", "frontmost_application_if"},
+      {"bundle_identifiers", {"^com\\.apple\\.Terminal$"}},
+  }));
+
+  // Conditions are sorted by the estimated cost.
+
+  krbn::manipulator::condition_manager condition_manager;
+  condition_manager.push_back_condition(frontmost_application_condition);
+  condition_manager.push_back_condition(keyboard_type_condition);
+  condition_manager.push_back_condition(variable_condition);
+
+  REQUIRE(condition_manager.get_conditions().size() == 3);
+  REQUIRE(condition_manager.get_conditions()[0] == variable_condition);
+  REQUIRE(condition_manager.get_conditions()[1] == keyboard_type_condition);
+  REQUIRE(condition_manager.get_conditions()[2] == frontmost_application_condition);
+
+  // Results are updated when the environment is changed.
+
+  krbn::manipulator_environment manipulator_environment;
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+
+  manipulator_environment.set_variable("condition_manager.variable", 1);
+  manipulator_environment.set_keyboard_type("iso");
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+
+  manipulator_environment.set_frontmost_application({"com.apple.Terminal", ""});
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == true);
+
+  manipulator_environment.set_keyboard_type("ansi");
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+
+  manipulator_environment.set_keyboard_type("iso");
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == true);
+
+  manipulator_environment.set_frontmost_application({"com.googlecode.iterm2", ""});
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+
+  // Cached results are not shared among environments.
+
+  krbn::manipulator_environment manipulator_environment2;
+  manipulator_environment2.set_variable("condition_manager.variable", 1);
+  manipulator_environment2.set_keyboard_type("iso");
+  manipulator_environment2.set_frontmost_application({"com.apple.Terminal", ""});
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment2) == true);
+  REQUIRE(condition_manager.is_fulfilled(queued_event, manipulator_environment) == false);
+}
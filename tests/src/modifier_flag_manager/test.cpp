@@ -140,4 +140,26 @@ TEST_CASE("manipulator.modifier_flag_manager") {
     modifier_flag_manager.push_back_active_modifier_flag(decrease_lock_left_shift_1);
     REQUIRE(modifier_flag_manager.is_pressed(krbn::modifier_flag::left_shift) == false);
   }
+
+  // ----------------------------------------
+  // get_pressed_modifier_flags
+  {
+    krbn::modifier_flag_manager modifier_flag_manager;
+
+    REQUIRE(modifier_flag_manager.get_pressed_modifier_flags().empty());
+
+    modifier_flag_manager.push_back_active_modifier_flag(left_shift_1);
+    modifier_flag_manager.push_back_active_modifier_flag(krbn::modifier_flag_manager::active_modifier_flag(krbn::modifier_flag_manager::active_modifier_flag::type::increase,
+                                                                                                           krbn::modifier_flag::right_command,
+                                                                                                           krbn::device_id(2)));
+    REQUIRE(modifier_flag_manager.get_pressed_modifier_flags() == krbn::modifier_flag_mask({krbn::modifier_flag::left_shift,
+                                                                                            krbn::modifier_flag::right_command}));
+
+    modifier_flag_manager.erase_all_active_modifier_flags(krbn::device_id(2));
+    REQUIRE(modifier_flag_manager.get_pressed_modifier_flags() == krbn::modifier_flag_mask({krbn::modifier_flag::left_shift}));
+
+    modifier_flag_manager.reset();
+    REQUIRE(modifier_flag_manager.get_pressed_modifier_flags().empty());
+    REQUIRE(modifier_flag_manager.get_active_modifier_flags().size() == 0);
+  }
 }
@@ -0,0 +1,311 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "krbn_notification_center.hpp"
+#include "manipulator/details/post_event_to_virtual_devices.hpp"
+#include "manipulator/manipulator_managers_connector.hpp"
+#include "manipulator/manipulator_timer.hpp"
+#include "scheduler.hpp"
+#include "thread_utility.hpp"
+#include "time_utility.hpp"
+#include "types.hpp"
+#include <atomic>
+#include <dlfcn.h>
+#include <pthread.h>
+
+// Count pthread_mutex_lock calls in order to confirm the event hot path does not acquire locks.
+
+namespace {
+std::atomic<bool> counting(false);
+std::atomic<uint64_t> lock_count(0);
+
+void count_lock(void) {
+  if (counting) {
+    ++lock_count;
+  }
+}
+} // namespace
+
+#ifdef __APPLE__
+
+namespace {
+int counting_pthread_mutex_lock(pthread_mutex_t* mutex) {
+  count_lock();
+  return pthread_mutex_lock(mutex);
+}
+
+struct interpose final {
+  const void* replacement;
+  const void* replacee;
+};
+
+__attribute__((used)) const interpose interpose_pthread_mutex_lock
+    __attribute__((section("__DATA,__interpose"))) = {
+        reinterpret_cast<const void*>(&counting_pthread_mutex_lock),
+        reinterpret_cast<const void*>(&pthread_mutex_lock),
+};
+} // namespace
+
+#else
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) {
+  using function_t = int (*)(pthread_mutex_t*);
+  static function_t original = reinterpret_cast<function_t>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+
+  count_lock();
+  return original(mutex);
+}
+
+#endif
+
+namespace {
+class counter final {
+public:
+  counter(void) {
+    lock_count = 0;
+    counting = true;
+  }
+
+  ~counter(void) {
+    counting = false;
+  }
+
+  uint64_t get(void) const {
+    return lock_count;
+  }
+};
+} // namespace
+
+TEST_CASE("initialize") {
+  krbn::thread_utility::register_main_thread();
+}
+
+TEST_CASE("counter") {
+  std::mutex mutex;
+
+  counter c;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+  }
+  REQUIRE(c.get() == 1);
+}
+
+TEST_CASE("singletons") {
+  // Initialize singletons.
+  krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC);
+  krbn::time_utility::absolute_to_nano(1000);
+  krbn::krbn_notification_center::get_instance();
+  krbn::manipulator::manipulator_timer::get_instance();
+  krbn::scheduler::get_instance();
+  krbn::types::make_key_code("spacebar");
+  krbn::types::make_consumer_key_code("mute");
+  krbn::types::make_pointing_button("button1");
+
+  counter c;
+
+  for (int i = 0; i < 1000; ++i) {
+    krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC);
+    krbn::time_utility::absolute_to_nano(1000);
+    krbn::krbn_notification_center::get_instance();
+    krbn::manipulator::manipulator_timer::get_instance();
+    krbn::scheduler::get_instance();
+    krbn::types::make_key_code("spacebar");
+    krbn::types::make_consumer_key_code("mute");
+    krbn::types::make_pointing_button("button1");
+    krbn::thread_utility::get_main_thread_id();
+  }
+
+  REQUIRE(c.get() == 0);
+}
+
+TEST_CASE("replay") {
+  // Replay keystrokes through `simple_modifications -> complex_modifications -> post_event_to_virtual_devices`
+  // with virtual time, and count locks per event.
+
+  auto scheduler = std::make_shared<krbn::virtual_scheduler>();
+  krbn::scheduler::set_instance(scheduler);
+
+  krbn::core_configuration::profile::complex_modifications::parameters parameters;
+
+  krbn::manipulator::manipulator_managers_connector connector;
+
+  krbn::manipulator::manipulator_manager simple_modifications_manipulator_manager;
+  simple_modifications_manipulator_manager.push_back_manipulator(nlohmann::json({
+                                                                     {"type", "basic"},
+                                                                     {"from", {{"key_code", "caps_lock"}, {"modifiers", {{"optional", {"any"}}}}}},
+                                                                     {"to", {{{"key_code", "left_control"}}}},
+                                                                 }),
+                                                                 parameters);
+
+  krbn::manipulator::manipulator_manager complex_modifications_manipulator_manager;
+  complex_modifications_manipulator_manager.push_back_manipulator(nlohmann::json({
+                                                                      {"type", "basic"},
+                                                                      {"from", {{"key_code", "h"}, {"modifiers", {{"mandatory", {"control"}}, {"optional", {"any"}}}}}},
+                                                                      {"to", {{{"key_code", "delete_or_backspace"}}}},
+                                                                  }),
+                                                                  parameters);
+  complex_modifications_manipulator_manager.push_back_manipulator(nlohmann::json({
+                                                                      {"type", "basic"},
+                                                                      {"from", {{"key_code", "j"}}},
+                                                                      {"to", {{{"set_variable", {{"name", "replay.j"}, {"value", 1}}}}}},
+                                                                      {"to_after_key_up", {{{"set_variable", {{"name", "replay.j"}, {"value", 0}}}}}},
+                                                                  }),
+                                                                  parameters);
+  {
+    auto m = krbn::manipulator::manipulator_factory::make_manipulator(nlohmann::json({
+                                                                          {"type", "basic"},
+                                                                          {"from", {{"key_code", "k"}}},
+                                                                          {"to", {{{"key_code", "up_arrow"}}}},
+                                                                      }),
+                                                                      parameters);
+    m->push_back_condition(krbn::manipulator::manipulator_factory::make_condition(nlohmann::json({
+        {"type", "frontmost_application_if"},
+        {"bundle_identifiers", {"^com\\.apple\\.Terminal$", "^com\\.googlecode\\.iterm2$"}},
+    })));
+    complex_modifications_manipulator_manager.push_back_manipulator(m);
+  }
+  complex_modifications_manipulator_manager.push_back_manipulator(nlohmann::json({
+                                                                      {"type", "basic"},
+                                                                      {"from", {{"key_code", "m"}}},
+                                                                      {"to", {{{"mouse_key", {{"y", 1536}}}}}},
+                                                                  }),
+                                                                  parameters);
+  complex_modifications_manipulator_manager.push_back_manipulator(nlohmann::json({
+                                                                      {"type", "basic"},
+                                                                      {"from", {{"key_code", "left_shift"}}},
+                                                                      {"to", {{{"key_code", "left_shift"}}}},
+                                                                      {"to_if_alone", {{{"key_code", "escape"}}}},
+                                                                  }),
+                                                                  parameters);
+
+  krbn::manipulator::manipulator_manager post_event_to_virtual_devices_manipulator_manager;
+  auto post_event_to_virtual_devices_manipulator = std::make_shared<krbn::manipulator::details::post_event_to_virtual_devices>();
+  post_event_to_virtual_devices_manipulator_manager.push_back_manipulator(post_event_to_virtual_devices_manipulator);
+
+  auto input_event_queue = std::make_shared<krbn::event_queue>();
+  auto simple_modifications_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto complex_modifications_applied_event_queue = std::make_shared<krbn::event_queue>();
+  auto posted_event_queue = std::make_shared<krbn::event_queue>();
+  connector.emplace_back_connection(simple_modifications_manipulator_manager,
+                                    input_event_queue,
+                                    simple_modifications_applied_event_queue);
+  connector.emplace_back_connection(complex_modifications_manipulator_manager,
+                                    complex_modifications_applied_event_queue);
+  connector.emplace_back_connection(post_event_to_virtual_devices_manipulator_manager,
+                                    posted_event_queue);
+
+  // frontmost_application_changed events are made in device_grabber when the frontmost application is changed.
+  // (Their payloads are interned outside the key path.)
+  auto terminal = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.apple.Terminal",
+                                                                                                   "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal");
+  auto safari = krbn::event_queue::queued_event::event::make_frontmost_application_changed_event("com.apple.Safari",
+                                                                                                 "/Applications/Safari.app/Contents/MacOS/Safari");
+
+  auto ms = krbn::time_utility::nano_to_absolute(NSEC_PER_MSEC);
+  uint64_t time_stamp = ms;
+  uint64_t event_count = 0;
+
+  auto post = [&](const krbn::event_queue::queued_event::event& e,
+                  krbn::event_type event_type) {
+    input_event_queue->emplace_back_event(krbn::device_id(1), time_stamp, e, event_type, e);
+    connector.manipulate();
+
+    scheduler->advance_to(time_stamp);
+    posted_event_queue->clear_events();
+    post_event_to_virtual_devices_manipulator->clear_queue();
+
+    time_stamp += 10 * ms;
+    ++event_count;
+  };
+
+  auto press = [&](krbn::key_code key_code) {
+    krbn::event_queue::queued_event::event e(key_code);
+    post(e, krbn::event_type::key_down);
+    post(e, krbn::event_type::key_up);
+  };
+
+  auto press_keys = [&] {
+    for (const auto& key_code : {krbn::key_code::a,
+                                 krbn::key_code::caps_lock,
+                                 krbn::key_code::h,
+                                 krbn::key_code::spacebar}) {
+      press(key_code);
+    }
+  };
+
+  bool terminal_is_frontmost = false;
+  auto change_frontmost_application = [&] {
+    terminal_is_frontmost = !terminal_is_frontmost;
+    post(terminal_is_frontmost ? terminal : safari, krbn::event_type::single);
+    press(krbn::key_code::k);
+  };
+
+  // Returns the lock count per `function` call.
+  auto count_locks = [&](const std::function<void(void)>& function) {
+    counter c;
+
+    for (int i = 0; i < 1000; ++i) {
+      function();
+    }
+
+    return static_cast<double>(c.get()) / 1000;
+  };
+
+  // Warm up (initialize singletons and reserve buffers).
+  for (int i = 0; i < 100; ++i) {
+    press_keys();
+    press(krbn::key_code::j);
+    press(krbn::key_code::left_shift);
+    press(krbn::key_code::m);
+    change_frontmost_application();
+  }
+
+  // Key events and events which are handled without payloads do not acquire locks.
+
+  {
+    event_count = 0;
+
+    REQUIRE(count_locks(press_keys) == 0);
+    REQUIRE(count_locks([&] { press(krbn::key_code::j); }) == 0);          // set_variable
+    REQUIRE(count_locks([&] { press(krbn::key_code::left_shift); }) == 0); // to_if_alone
+    REQUIRE(count_locks([&] { press(krbn::key_code::k); }) == 0);          // frontmost_application_if (cached)
+
+    REQUIRE(event_count == 4 * 2 * 1000 + 3 * 2 * 1000);
+  }
+
+  // mouse_key:
+  //   - payload_table::get in post_event_to_virtual_devices (key_down and key_up)
+  //   - manipulator_timer::add_entry (key_down) and manipulator_timer::cancel (key_up) in mouse_key_handler
+
+  REQUIRE(count_locks([&] { press(krbn::key_code::m); }) == 4);
+
+  // frontmost_application_changed:
+  //   - payload_table::get in event_queue::update_state for each event queue (4 queues)
+  //   - regex_set::match_any at the first condition evaluation after the change
+  //     (bundle_identifiers, and file_paths if bundle_identifiers do not match)
+  //
+  // Terminal: 4 + 1, Safari: 4 + 2
+
+  REQUIRE(count_locks([&] {
+            change_frontmost_application();
+            change_frontmost_application();
+          }) == 11);
+
+  // set_variable with json output (as device_grabber does for complex_modifications_applied_event_queue):
+  //   - manipulator_environment::mutex_ for each set_variable event (key_down and to_after_key_up)
+  //   - async_json_file_writer::mutex_ in mark_dirty at most once per write
+
+  {
+    complex_modifications_applied_event_queue->enable_manipulator_environment_json_output("tmp/manipulator_environment.json");
+    press(krbn::key_code::j);
+
+    counter c;
+    press(krbn::key_code::j);
+    REQUIRE(c.get() >= 2);
+    REQUIRE(c.get() <= 3);
+
+    complex_modifications_applied_event_queue->disable_manipulator_environment_json_output();
+  }
+
+  krbn::scheduler::set_instance(nullptr);
+}
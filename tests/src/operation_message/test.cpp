@@ -0,0 +1,308 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "async_local_datagram_server.hpp"
+#include "filesystem.hpp"
+#include "local_datagram_client.hpp"
+#include "operation_message.hpp"
+#include "thread_utility.hpp"
+#include <boost/optional/optional_io.hpp>
+#include <condition_variable>
+#include <random>
+
+namespace {
+class message final {
+public:
+  krbn::operation_type operation_type;
+  std::vector<std::string> strings;
+
+  bool operator==(const message& other) const {
+    return operation_type == other.operation_type &&
+           strings == other.strings;
+  }
+};
+
+std::vector<uint8_t> make_datagram(const std::vector<message>& messages) {
+  krbn::operation_message::writer writer;
+  for (const auto& m : messages) {
+    writer.begin_message(m.operation_type);
+    for (const auto& s : m.strings) {
+      writer.write_string(s);
+    }
+    REQUIRE(writer.end_message());
+  }
+  return writer.get_buffer();
+}
+
+// Read strings until the payload is exhausted.
+boost::optional<size_t> parse(const std::vector<uint8_t>& datagram, std::vector<message>& messages) {
+  return krbn::operation_message::parse(&(datagram[0]),
+                                        datagram.size(),
+                                        [&](krbn::operation_type operation_type, krbn::operation_message::reader& reader) {
+                                          message m;
+                                          m.operation_type = operation_type;
+                                          while (auto s = reader.read_string()) {
+                                            m.strings.push_back(*s);
+                                          }
+                                          messages.push_back(m);
+                                        });
+}
+
+const std::vector<message> messages{
+    {krbn::operation_type::frontmost_application_changed, {"com.apple.Terminal", "/Applications/Utilities/Terminal.app/Contents/MacOS/Terminal"}},
+    {krbn::operation_type::input_source_changed, {"en", "com.apple.keylayout.US", ""}},
+    {krbn::operation_type::connect, {}},
+};
+} // namespace
+
+TEST_CASE("initialize") {
+  krbn::thread_utility::register_main_thread();
+}
+
+TEST_CASE("writer") {
+  krbn::operation_message::writer writer;
+  REQUIRE(writer.get_buffer() == std::vector<uint8_t>({'k', 'r', krbn::operation_message::get_version(), 0, 0}));
+
+  writer.begin_message(krbn::operation_type::connect);
+  writer.write_uint32(0x12345678);
+  writer.write_string("ab");
+  REQUIRE(writer.end_message());
+  REQUIRE(writer.get_message_count() == 1);
+  REQUIRE(writer.get_buffer() == std::vector<uint8_t>({
+                                     'k', 'r', krbn::operation_message::get_version(), 1, 0,
+                                     static_cast<uint8_t>(krbn::operation_type::connect), 8, 0,
+                                     0x78, 0x56, 0x34, 0x12,
+                                     2, 0, 'a', 'b',
+                                 }));
+
+  // Too long payload
+  {
+    krbn::operation_message::writer w;
+    w.begin_message(krbn::operation_type::connect);
+    w.write_string(std::string(0xffff, 'a'));
+    REQUIRE(!w.end_message());
+    REQUIRE(w.get_message_count() == 0);
+    REQUIRE(w.get_buffer().size() == krbn::operation_message::get_header_size());
+  }
+
+  writer.clear();
+  REQUIRE(writer.get_message_count() == 0);
+  REQUIRE(writer.get_buffer().size() == krbn::operation_message::get_header_size());
+}
+
+TEST_CASE("reader") {
+  krbn::operation_message::writer writer;
+  writer.begin_message(krbn::operation_type::connect);
+  writer.write_uint8(1);
+  writer.write_uint32(1234);
+  writer.write_uint64(0x123456789abcdef0);
+  writer.write_string("");
+  writer.write_string("example");
+  REQUIRE(writer.end_message());
+
+  size_t count = 0;
+  auto& buffer = writer.get_buffer();
+  auto result = krbn::operation_message::parse(&(buffer[0]),
+                                               buffer.size(),
+                                               [&](krbn::operation_type operation_type, krbn::operation_message::reader& reader) {
+                                                 ++count;
+                                                 REQUIRE(operation_type == krbn::operation_type::connect);
+                                                 REQUIRE(reader.read_uint8() == uint8_t(1));
+                                                 REQUIRE(reader.read_uint32() == uint32_t(1234));
+                                                 REQUIRE(reader.read_uint64() == uint64_t(0x123456789abcdef0));
+                                                 REQUIRE(reader.read_string() == std::string(""));
+                                                 REQUIRE(reader.read_string() == std::string("example"));
+                                                 // The payload is exhausted.
+                                                 REQUIRE(reader.read_uint8() == boost::none);
+                                                 REQUIRE(reader.read_uint32() == boost::none);
+                                                 REQUIRE(reader.read_uint64() == boost::none);
+                                                 REQUIRE(reader.read_string() == boost::none);
+                                               });
+  REQUIRE(result == size_t(1));
+  REQUIRE(count == 1);
+}
+
+TEST_CASE("parse") {
+  // Multiple messages
+  {
+    std::vector<message> actual;
+    REQUIRE(parse(make_datagram(messages), actual) == messages.size());
+    REQUIRE(actual == messages);
+  }
+
+  // No message
+  {
+    std::vector<message> actual;
+    REQUIRE(parse(make_datagram({}), actual) == size_t(0));
+    REQUIRE(actual.empty());
+  }
+
+  // Unknown operation_type is passed to the callback and the following messages are parsed.
+  {
+    std::vector<message> expected{
+        {krbn::operation_type(200), {"unknown"}},
+        {krbn::operation_type::frontmost_application_changed, {"com.apple.Terminal", ""}},
+    };
+    std::vector<message> actual;
+    REQUIRE(parse(make_datagram(expected), actual) == size_t(2));
+    REQUIRE(actual == expected);
+  }
+
+  // Invalid magic
+  {
+    auto datagram = make_datagram(messages);
+    datagram[0] = 'x';
+    std::vector<message> actual;
+    REQUIRE(parse(datagram, actual) == boost::none);
+    REQUIRE(actual.empty());
+  }
+
+  // Version mismatch
+  {
+    auto datagram = make_datagram(messages);
+    datagram[2] = krbn::operation_message::get_version() + 1;
+    std::vector<message> actual;
+    REQUIRE(parse(datagram, actual) == boost::none);
+    REQUIRE(actual.empty());
+  }
+
+  // The callback is not called for truncated datagrams.
+  {
+    auto datagram = make_datagram(messages);
+    for (size_t length = 0; length < datagram.size(); ++length) {
+      std::vector<uint8_t> truncated(std::begin(datagram), std::begin(datagram) + length);
+      if (truncated.empty()) {
+        truncated.push_back(0);
+      }
+
+      std::vector<message> actual;
+      auto result = krbn::operation_message::parse(&(truncated[0]),
+                                                   length,
+                                                   [&](krbn::operation_type, krbn::operation_message::reader&) {
+                                                     actual.push_back(message());
+                                                   });
+      REQUIRE(result == boost::none);
+      REQUIRE(actual.empty());
+    }
+  }
+}
+
+TEST_CASE("fuzz") {
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+
+  auto original = make_datagram(messages);
+
+  for (int i = 0; i < 100000; ++i) {
+    std::vector<uint8_t> datagram;
+
+    switch (i % 3) {
+      case 0: {
+        // Random bytes with a valid header
+        std::uniform_int_distribution<size_t> length_distribution(0, 64);
+        std::uniform_int_distribution<int> count_distribution(0, 3);
+        datagram = make_datagram({});
+        datagram[3] = count_distribution(engine);
+        auto length = length_distribution(engine);
+        for (size_t j = 0; j < length; ++j) {
+          datagram.push_back(byte_distribution(engine));
+        }
+        break;
+      }
+
+      case 1: {
+        // Mutate a valid datagram
+        std::uniform_int_distribution<size_t> offset_distribution(krbn::operation_message::get_header_size(), original.size() - 1);
+        datagram = original;
+        for (int j = 0; j < 4; ++j) {
+          datagram[offset_distribution(engine)] = byte_distribution(engine);
+        }
+        break;
+      }
+
+      case 2: {
+        // Mutate and truncate a valid datagram
+        std::uniform_int_distribution<size_t> offset_distribution(krbn::operation_message::get_header_size(), original.size() - 1);
+        datagram = original;
+        datagram[offset_distribution(engine)] = byte_distribution(engine);
+        datagram.resize(offset_distribution(engine));
+        break;
+      }
+    }
+
+    // Copy into an exactly sized buffer so that out-of-bounds reads are detectable by sanitizers.
+    std::unique_ptr<uint8_t[]> p(new uint8_t[datagram.size()]);
+    memcpy(p.get(), &(datagram[0]), datagram.size());
+
+    size_t total_payload_length = 0;
+    auto result = krbn::operation_message::parse(p.get(),
+                                                 datagram.size(),
+                                                 [&](krbn::operation_type, krbn::operation_message::reader& reader) {
+                                                   while (auto s = reader.read_string()) {
+                                                     total_payload_length += 2 + s->length();
+                                                   }
+                                                   while (reader.read_uint8()) {
+                                                     ++total_payload_length;
+                                                   }
+                                                 });
+    if (result) {
+      REQUIRE(total_payload_length + *result * 3 + krbn::operation_message::get_header_size() == datagram.size());
+    } else {
+      REQUIRE(total_payload_length == 0);
+    }
+  }
+}
+
+TEST_CASE("async_local_datagram_server") {
+  const std::string socket_file_path("tmp/server");
+  krbn::filesystem::create_directory_with_intermediate_directories(krbn::filesystem::dirname(socket_file_path), 0700);
+  unlink(socket_file_path.c_str());
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<message> actual;
+  size_t invalid_datagram_count = 0;
+
+  {
+    krbn::async_local_datagram_server server(socket_file_path.c_str(),
+                                             32 * 1024,
+                                             [&](const uint8_t* p, size_t length) {
+                                               std::vector<uint8_t> datagram(p, p + length);
+                                               std::vector<message> v;
+                                               auto result = parse(datagram, v);
+
+                                               {
+                                                 std::lock_guard<std::mutex> lock(mutex);
+                                                 if (result) {
+                                                   actual.insert(std::end(actual), std::begin(v), std::end(v));
+                                                 } else {
+                                                   ++invalid_datagram_count;
+                                                 }
+                                               }
+                                               cv.notify_one();
+                                             });
+
+    {
+      krbn::local_datagram_client client(socket_file_path.c_str());
+      client.send_to(make_datagram(messages));
+      client.send_to(std::vector<uint8_t>({'x', 'y', 'z'}));
+      client.send_to(make_datagram({messages[0]}));
+
+      std::unique_lock<std::mutex> lock(mutex);
+      REQUIRE(cv.wait_for(lock,
+                          std::chrono::seconds(5),
+                          [&] {
+                            return actual.size() == messages.size() + 1 &&
+                                   invalid_datagram_count == 1;
+                          }));
+    }
+
+    // The server is stopped without datagrams. (The destructor must not wait for a timeout.)
+  }
+
+  auto expected = messages;
+  expected.push_back(messages[0]);
+  REQUIRE(actual == expected);
+
+  unlink(socket_file_path.c_str());
+}
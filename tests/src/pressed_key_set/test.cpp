@@ -0,0 +1,89 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "pressed_key_set.hpp"
+#include "thread_utility.hpp"
+
+namespace {
+const auto keyboard = krbn::hid_usage_page::keyboard_or_keypad;
+const auto consumer = krbn::hid_usage_page::consumer;
+
+krbn::hid_usage usage(krbn::key_code key_code) {
+  return *(krbn::types::make_hid_usage(key_code));
+}
+
+krbn::hid_usage usage(krbn::consumer_key_code consumer_key_code) {
+  return *(krbn::types::make_hid_usage(consumer_key_code));
+}
+} // namespace
+
+TEST_CASE("initialize") {
+  krbn::thread_utility::register_main_thread();
+}
+
+TEST_CASE("pressed_key_set") {
+  krbn::pressed_key_set pressed_key_set;
+  REQUIRE(pressed_key_set.empty());
+
+  REQUIRE(pressed_key_set.insert(krbn::device_id(1), keyboard, usage(krbn::key_code::a)));
+  REQUIRE(pressed_key_set.insert(krbn::device_id(2), keyboard, usage(krbn::key_code::b)));
+  REQUIRE(pressed_key_set.insert(krbn::device_id(1), consumer, usage(krbn::consumer_key_code::mute)));
+  REQUIRE(pressed_key_set.insert(krbn::device_id(2), keyboard, usage(krbn::key_code::spacebar)));
+  REQUIRE(pressed_key_set.size() == 4);
+
+  // Already pressed (by any device)
+  REQUIRE(!pressed_key_set.insert(krbn::device_id(1), keyboard, usage(krbn::key_code::a)));
+  REQUIRE(!pressed_key_set.insert(krbn::device_id(2), keyboard, usage(krbn::key_code::a)));
+  REQUIRE(!pressed_key_set.insert(krbn::device_id(2), consumer, usage(krbn::consumer_key_code::mute)));
+  REQUIRE(pressed_key_set.size() == 4);
+
+  REQUIRE(pressed_key_set.contains(keyboard, usage(krbn::key_code::a)));
+  REQUIRE(pressed_key_set.contains(consumer, usage(krbn::consumer_key_code::mute)));
+  REQUIRE(!pressed_key_set.contains(keyboard, usage(krbn::key_code::c)));
+  REQUIRE(!pressed_key_set.contains(consumer, usage(krbn::consumer_key_code::volume_increment)));
+
+  {
+    std::vector<std::pair<krbn::device_id, std::pair<krbn::hid_usage_page, krbn::hid_usage>>> expected({
+        {krbn::device_id(1), {keyboard, usage(krbn::key_code::a)}},
+        {krbn::device_id(2), {keyboard, usage(krbn::key_code::b)}},
+        {krbn::device_id(1), {consumer, usage(krbn::consumer_key_code::mute)}},
+        {krbn::device_id(2), {keyboard, usage(krbn::key_code::spacebar)}},
+    });
+    REQUIRE(pressed_key_set.get_keys() == expected);
+  }
+
+  // erase
+
+  REQUIRE(pressed_key_set.erase(keyboard, usage(krbn::key_code::b)));
+  REQUIRE(!pressed_key_set.erase(keyboard, usage(krbn::key_code::b)));
+  REQUIRE(!pressed_key_set.erase(consumer, usage(krbn::consumer_key_code::volume_increment)));
+  REQUIRE(pressed_key_set.size() == 3);
+
+  // The key can be pressed by another device after it is released.
+  REQUIRE(pressed_key_set.insert(krbn::device_id(1), keyboard, usage(krbn::key_code::b)));
+
+  // erase_by_device_id
+
+  {
+    // Keys are returned in the pressed order.
+    std::vector<std::pair<krbn::hid_usage_page, krbn::hid_usage>> expected({
+        {keyboard, usage(krbn::key_code::a)},
+        {consumer, usage(krbn::consumer_key_code::mute)},
+        {keyboard, usage(krbn::key_code::b)},
+    });
+    REQUIRE(pressed_key_set.erase_by_device_id(krbn::device_id(1)) == expected);
+  }
+  REQUIRE(pressed_key_set.size() == 1);
+  REQUIRE(!pressed_key_set.contains(keyboard, usage(krbn::key_code::a)));
+  REQUIRE(pressed_key_set.contains(keyboard, usage(krbn::key_code::spacebar)));
+
+  REQUIRE(pressed_key_set.erase_by_device_id(krbn::device_id(1)).empty());
+  REQUIRE(pressed_key_set.erase_by_device_id(krbn::device_id(3)).empty());
+
+  // clear
+
+  pressed_key_set.clear();
+  REQUIRE(pressed_key_set.empty());
+  REQUIRE(!pressed_key_set.contains(keyboard, usage(krbn::key_code::spacebar)));
+  REQUIRE(pressed_key_set.erase_by_device_id(krbn::device_id(2)).empty());
+}
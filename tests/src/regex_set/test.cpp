@@ -0,0 +1,112 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "regex_set.hpp"
+
+namespace {
+// Compare results with std::regex.
+void check_patterns(const std::vector<std::string>& patterns,
+                    const std::vector<std::string>& inputs) {
+  krbn::regex_set regex_set;
+  std::vector<size_t> indices;
+  for (const auto& p : patterns) {
+    indices.push_back(regex_set.insert(p));
+  }
+
+  for (const auto& input : inputs) {
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      std::regex r(patterns[i]);
+      INFO("pattern: " << patterns[i] << " input: " << input);
+      REQUIRE(regex_set.match(input, indices[i]) == regex_search(input, r));
+    }
+  }
+}
+} // namespace
+
+TEST_CASE("regex_set.match") {
+  check_patterns(
+      {
+          "^com\\.apple\\.Terminal$",
+          "^com\\.apple\\.",
+          "Terminal$",
+          "apple",
+          "",
+          "^$",
+          "^com\\.apple\\.(Terminal|Safari)$",
+          "^com\\.apple\\.T?erminal$",
+          "^com\\.apple\\.x*Terminal$",
+          "^com\\.apple\\.x{0,1}Terminal$",
+          "^com\\.google|Terminal",
+          "^com\\.[a|b]pple",
+          "^com\\.\\w+\\.Terminal$",
+          "com.apple",
+          "^com\\.apple\\.Terminal",
+          "\\.",
+          "^\\^\\$\\.\\*$",
+      },
+      {
+          "com.apple.Terminal",
+          "com.apple.Terminal2",
+          "com.apple.Safari",
+          "com.apple.erminal",
+          "com.apple.xxTerminal",
+          "com.google.Chrome",
+          "org.example.Terminal",
+          "comXappleXTerminal",
+          "^$.*",
+          "",
+      });
+}
+
+TEST_CASE("regex_set.match_any") {
+  krbn::regex_set regex_set;
+  std::vector<size_t> indices1({
+      regex_set.insert("^com\\.apple\\.Terminal$"),
+      regex_set.insert("^com\\.googlecode\\.iterm2$"),
+  });
+  std::vector<size_t> indices2({
+      regex_set.insert("^com\\.googlecode\\.iterm2$"),
+      regex_set.insert("^com\\.microsoft\\.(Word|Excel)$"),
+  });
+  std::vector<size_t> empty;
+
+  // Identical patterns share one entry.
+  REQUIRE(regex_set.size() == 3);
+  REQUIRE(regex_set.get_regex_pattern_count() == 1);
+  REQUIRE(indices1[1] == indices2[0]);
+
+  REQUIRE(regex_set.match_any("com.apple.Terminal", indices1) == true);
+  REQUIRE(regex_set.match_any("com.apple.Terminal", indices2) == false);
+  REQUIRE(regex_set.match_any("com.googlecode.iterm2", indices1) == true);
+  REQUIRE(regex_set.match_any("com.googlecode.iterm2", indices2) == true);
+  REQUIRE(regex_set.match_any("com.microsoft.Excel", indices1) == false);
+  REQUIRE(regex_set.match_any("com.microsoft.Excel", indices2) == true);
+  REQUIRE(regex_set.match_any("com.microsoft.Excel", empty) == false);
+}
+
+TEST_CASE("regex_set.erase") {
+  krbn::regex_set regex_set;
+  auto i1 = regex_set.insert("^com\\.apple\\.Terminal$");
+  auto i2 = regex_set.insert("^com\\.apple\\.Terminal$");
+  REQUIRE(i1 == i2);
+  REQUIRE(regex_set.size() == 1);
+
+  // Patterns are kept until all references are erased.
+  regex_set.erase(i1);
+  REQUIRE(regex_set.size() == 1);
+  REQUIRE(regex_set.match("com.apple.Terminal", i2) == true);
+
+  regex_set.erase(i2);
+  REQUIRE(regex_set.size() == 0);
+  REQUIRE(regex_set.match("com.apple.Terminal", i2) == false);
+
+  // Erased indices are reused.
+  auto i3 = regex_set.insert("^com\\.apple\\.(Terminal|Safari)$");
+  REQUIRE(i3 == i1);
+  REQUIRE(regex_set.match("com.apple.Terminal", i3) == true);
+  REQUIRE(regex_set.match("com.apple.Safari", i3) == true);
+
+  // Invalid regex
+  REQUIRE_THROWS(regex_set.insert("invalid(regex"));
+  REQUIRE(regex_set.size() == 1);
+}
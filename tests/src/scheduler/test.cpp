@@ -0,0 +1,157 @@
+#define CATCH_CONFIG_MAIN
+#include "../../vendor/catch/catch.hpp"
+
+#include "manipulator/manipulator_timer.hpp"
+#include "scheduler.hpp"
+#include "thread_utility.hpp"
+
+TEST_CASE("initialize") {
+  krbn::thread_utility::register_main_thread();
+}
+
+TEST_CASE("virtual_scheduler") {
+  krbn::virtual_scheduler scheduler(1000);
+
+  REQUIRE(scheduler.now() == 1000);
+
+  std::vector<std::pair<int, uint64_t>> invoked;
+
+  auto timer1 = scheduler.make_timer(3000, [&] {
+    invoked.emplace_back(1, scheduler.now());
+  });
+  auto timer2 = scheduler.make_timer(2000, [&] {
+    invoked.emplace_back(2, scheduler.now());
+  });
+  auto timer3 = scheduler.make_timer(2000, [&] {
+    invoked.emplace_back(3, scheduler.now());
+  });
+  auto timer4 = scheduler.make_timer(2500, [&] {
+    invoked.emplace_back(4, scheduler.now());
+  });
+
+  REQUIRE(scheduler.get_active_timer_count() == 4);
+
+  // Cancel timer4
+  timer4 = nullptr;
+  REQUIRE(scheduler.get_active_timer_count() == 3);
+
+  scheduler.advance_to(1999);
+  REQUIRE(scheduler.now() == 1999);
+  REQUIRE(invoked.empty());
+  REQUIRE(!timer2->fired());
+
+  scheduler.advance(500);
+  REQUIRE(scheduler.now() == 2499);
+  REQUIRE(invoked == std::vector<std::pair<int, uint64_t>>({
+                         {2, 2000},
+                         {3, 2000},
+                     }));
+  REQUIRE(timer2->fired());
+  REQUIRE(timer3->fired());
+  REQUIRE(!timer1->fired());
+
+  // Timers which are added in callbacks are also invoked.
+
+  std::unique_ptr<krbn::scheduler::timer> timer5;
+  auto timer6 = scheduler.make_timer(2600, [&] {
+    invoked.emplace_back(6, scheduler.now());
+    timer5 = scheduler.make_timer(2700, [&] {
+      invoked.emplace_back(5, scheduler.now());
+    });
+  });
+
+  invoked.clear();
+  scheduler.run_until_idle();
+  REQUIRE(scheduler.now() == 3000);
+  REQUIRE(invoked == std::vector<std::pair<int, uint64_t>>({
+                         {6, 2600},
+                         {5, 2700},
+                         {1, 3000},
+                     }));
+  REQUIRE(scheduler.get_active_timer_count() == 0);
+}
+
+TEST_CASE("manipulator_timer") {
+  auto scheduler = std::make_shared<krbn::virtual_scheduler>();
+  krbn::scheduler::set_instance(scheduler);
+
+  auto& manipulator_timer = krbn::manipulator::manipulator_timer::get_instance();
+  manipulator_timer.enable();
+
+  std::vector<int> invoked;
+  auto add_entry = [&](uint64_t when, int value) {
+    return manipulator_timer.add_entry(when,
+                                       [&invoked, value] {
+                                         invoked.push_back(value);
+                                       });
+  };
+
+  add_entry(300, 1);
+  add_entry(100, 2);
+  add_entry(200, 3);
+  auto id4 = add_entry(50, 4);
+  auto id5 = add_entry(250, 5);
+
+  REQUIRE(manipulator_timer.get_entries().size() == 5);
+
+  // Canceled timers are not invoked.
+  manipulator_timer.cancel(id4);
+  manipulator_timer.cancel(id5);
+  REQUIRE(manipulator_timer.get_entries().size() == 3);
+
+  scheduler->advance_to(150);
+  REQUIRE(invoked == std::vector<int>({2}));
+
+  // Simulate 1 hour in virtual time.
+  scheduler->advance(3600ULL * 1000 * 1000 * 1000);
+  REQUIRE(invoked == std::vector<int>({2, 3, 1}));
+  REQUIRE(manipulator_timer.get_entries().empty());
+  REQUIRE(scheduler->get_active_timer_count() == 0);
+
+  manipulator_timer.disable();
+  krbn::scheduler::set_instance(nullptr);
+}
+
+TEST_CASE("manipulator_timer::client") {
+  auto scheduler = std::make_shared<krbn::virtual_scheduler>();
+  krbn::scheduler::set_instance(scheduler);
+
+  auto& manipulator_timer = krbn::manipulator::manipulator_timer::get_instance();
+  manipulator_timer.enable();
+
+  std::vector<int> invoked;
+
+  {
+    krbn::manipulator::manipulator_timer::client client;
+    REQUIRE(!client.active());
+
+    client.set_entry(100, [&] {
+      invoked.push_back(1);
+    });
+    REQUIRE(client.active());
+
+    // set_entry replaces the current entry.
+    client.set_entry(200, [&] {
+      invoked.push_back(2);
+    });
+    REQUIRE(manipulator_timer.get_entries().size() == 1);
+
+    scheduler->advance_to(1000);
+    REQUIRE(invoked == std::vector<int>({2}));
+    REQUIRE(!client.active());
+
+    client.set_entry(2000, [&] {
+      invoked.push_back(3);
+    });
+    REQUIRE(manipulator_timer.get_entries().size() == 1);
+  }
+
+  // The entry is canceled when the client is destroyed.
+  REQUIRE(manipulator_timer.get_entries().empty());
+
+  scheduler->run_until_idle();
+  REQUIRE(invoked == std::vector<int>({2}));
+
+  manipulator_timer.disable();
+  krbn::scheduler::set_instance(nullptr);
+}
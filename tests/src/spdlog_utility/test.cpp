@@ -7,6 +7,7 @@
 #include "thread_utility.hpp"
 #include <boost/lexical_cast.hpp>
 #include <boost/optional/optional_io.hpp>
+#include <fstream>
 #include <ostream>
 
 TEST_CASE("initialize") {
@@ -16,7 +17,7 @@ TEST_CASE("initialize") {
 TEST_CASE("get_timestamp_number") {
   {
     auto actual = krbn::spdlog_utility::get_sort_key("[2016-10-15 00:09:47.283] [info] [grabber] version 0.90.50");
-    REQUIRE(actual == 20161015000947283ULL);
+    REQUIRE(actual == uint64_t(20161015000947283ULL));
   }
   {
     auto actual = krbn::spdlog_utility::get_sort_key("[]");
@@ -26,6 +27,76 @@ TEST_CASE("get_timestamp_number") {
     auto actual = krbn::spdlog_utility::get_sort_key("[yyyy-mm-dd hh:mm:ss.mmm]");
     REQUIRE(actual == boost::none);
   }
+
+  // Separators are validated.
+  {
+    std::string line("[2016-10-15 00:09:47.283]");
+    REQUIRE(krbn::spdlog_utility::get_sort_key(line) != boost::none);
+
+    for (auto position : {0, 5, 8, 11, 14, 17, 20, 24}) {
+      auto l = line;
+      l[position] = '0';
+      REQUIRE(krbn::spdlog_utility::get_sort_key(l) == boost::none);
+    }
+  }
+
+  // Digits are validated.
+  {
+    for (auto c : {'/', ':', 'a', '\xff'}) {
+      std::string line("[2016-10-15 00:09:47.283]");
+      line[23] = c;
+      REQUIRE(krbn::spdlog_utility::get_sort_key(line) == boost::none);
+    }
+  }
+
+  // Not null-terminated
+  {
+    std::string line("[2016-10-15 00:09:47.283] [info] [grabber] version 0.90.50");
+    REQUIRE(krbn::spdlog_utility::get_sort_key(line.c_str(), 25) == uint64_t(20161015000947283ULL));
+    REQUIRE(krbn::spdlog_utility::get_sort_key(line.c_str(), 24) == boost::none);
+  }
+}
+
+TEST_CASE("scan_sort_keys") {
+  std::string text("[2016-10-15 00:09:47.283] [info] [grabber] line1\n"
+                   "\n"
+                   "invalid line\n"
+                   "[2016-10-15 00:09:47.284] [info] [grabber] line2\n"
+                   "[2016-10-15 00:09:47.285] [info] [grabber] unterminated");
+
+  std::vector<std::pair<std::string, uint64_t>> actual;
+  auto scanned = krbn::spdlog_utility::scan_sort_keys(text.c_str(),
+                                                      text.size(),
+                                                      [&](size_t offset, size_t length, uint64_t sort_key) {
+                                                        actual.push_back(std::make_pair(text.substr(offset, length), sort_key));
+                                                      });
+
+  std::vector<std::pair<std::string, uint64_t>> expected{
+      {"[2016-10-15 00:09:47.283] [info] [grabber] line1", 20161015000947283ULL},
+      {"[2016-10-15 00:09:47.284] [info] [grabber] line2", 20161015000947284ULL},
+  };
+  REQUIRE(actual == expected);
+  REQUIRE(scanned == text.find("[2016-10-15 00:09:47.285]"));
+
+  // mapped_file
+  {
+    system("rm -rf tmp && mkdir -p tmp");
+    {
+      std::ofstream stream("tmp/scan_sort_keys.log");
+      stream << text;
+    }
+
+    actual.clear();
+    auto scanned = krbn::spdlog_utility::scan_sort_keys("tmp/scan_sort_keys.log",
+                                                        [&](const char* data, size_t offset, size_t length, uint64_t sort_key) {
+                                                          actual.push_back(std::make_pair(std::string(data + offset, length), sort_key));
+                                                        });
+    REQUIRE(actual == expected);
+    REQUIRE(scanned == text.find("[2016-10-15 00:09:47.285]"));
+
+    REQUIRE(krbn::spdlog_utility::scan_sort_keys("tmp/not_found.log",
+                                                 [&](const char* data, size_t offset, size_t length, uint64_t sort_key) {}) == boost::none);
+  }
 }
 
 TEST_CASE("get_level") {
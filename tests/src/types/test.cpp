@@ -178,6 +178,40 @@ TEST_CASE("input_source_selector") {
   }
 }
 
+TEST_CASE("modifier_flag_mask") {
+  krbn::modifier_flag_mask mask;
+  REQUIRE(mask.empty());
+  REQUIRE(mask.size() == 0);
+  REQUIRE(std::begin(mask) == std::end(mask));
+
+  mask.insert(krbn::modifier_flag::right_shift);
+  mask.insert(krbn::modifier_flag::left_control);
+  mask.insert(krbn::modifier_flag::left_control);
+  REQUIRE(!mask.empty());
+  REQUIRE(mask.size() == 2);
+  REQUIRE(mask.contains(krbn::modifier_flag::left_control));
+  REQUIRE(!mask.contains(krbn::modifier_flag::left_shift));
+  REQUIRE(mask == krbn::modifier_flag_mask({krbn::modifier_flag::left_control,
+                                            krbn::modifier_flag::right_shift}));
+
+  {
+    std::vector<krbn::modifier_flag> actual;
+    for (const auto& f : mask) {
+      actual.push_back(f);
+    }
+    std::vector<krbn::modifier_flag> expected({krbn::modifier_flag::left_control,
+                                               krbn::modifier_flag::right_shift});
+    REQUIRE(actual == expected);
+  }
+
+  mask.erase(krbn::modifier_flag::left_control);
+  REQUIRE(mask == krbn::modifier_flag_mask({krbn::modifier_flag::right_shift}));
+
+  REQUIRE((krbn::modifier_flag_mask::all() & mask) == mask);
+  REQUIRE(!krbn::modifier_flag_mask::all().contains(krbn::modifier_flag::zero));
+  REQUIRE(krbn::modifier_flag_mask::all().size() == static_cast<size_t>(krbn::modifier_flag::end_) - 1);
+}
+
 TEST_CASE("mouse_key") {
   {
     krbn::mouse_key mouse_key(10, 20, 30, 40, 1.0);